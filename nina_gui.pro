@@ -31,17 +31,41 @@ HEADERS += src/timer.h
 HEADERS += src/wt_file.h
 HEADERS += src/scope_data_source.h
 HEADERS += src/scope.h
+HEADERS += src/scope_kernel.h
+HEADERS += src/scope_envelope.h
+HEADERS += src/triple_buffer.h
 HEADERS += src/common.h
+HEADERS += src/gui_msg_codec.h
+HEADERS += src/gui_msg_ring.h
+HEADERS += src/scope_sample_ring.h
+HEADERS += src/gui_msg_sender.h
+HEADERS += src/gui_msg_coalescer.h
+HEADERS += src/gui_msg_pool.h
+HEADERS += src/gui_msg_latency.h
+HEADERS += src/gui_handler_profiler.h
+HEADERS += src/list_row_cache.h
+HEADERS += src/gui_string_table.h
+HEADERS += src/ipc_recorder.h
+HEADERS += src/ipc_queue_health.h
 HEADERS += include/version.h
 SOURCES += src/main.cpp
 SOURCES += src/main_window.cpp
 SOURCES += src/gui_msg_thread.cpp
+SOURCES += src/gui_msg_coalescer.cpp
+SOURCES += src/gui_msg_pool.cpp
+SOURCES += src/gui_msg_latency.cpp
+SOURCES += src/gui_handler_profiler.cpp
+SOURCES += src/list_row_cache.cpp
+SOURCES += src/gui_string_table.cpp
+SOURCES += src/ipc_queue_health.cpp
 SOURCES += src/scope_msg_thread.cpp
 SOURCES += src/spi_monitor_thread.cpp
 SOURCES += src/background.cpp
 SOURCES += src/timer.cpp
 SOURCES += src/wt_file.cpp
 SOURCES += src/scope_data_source.cpp
+SOURCES += src/scope_kernel.cpp
+SOURCES += src/scope_envelope.cpp
 SOURCES += src/scope.cpp
 LIBS += -lrt
 RESOURCES = nina_gui.qrc
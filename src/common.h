@@ -9,9 +9,18 @@
 #ifndef _COMMON_H
 #define _COMMON_H
 
+#include <climits>
+#include <cstdint>
 #include <cstring>
+#include <chrono>
 #include <iostream>
+#include <type_traits>
+#ifndef NINA_GUI_NO_QT
 #include <QMetaType>
+#else
+// Allow the common definitions to be used by the (non-QT) tools
+#define Q_DECLARE_METATYPE(TYPE)
+#endif
 
 //--------------
 // Build options
@@ -20,6 +29,19 @@
 // Define to monitor the SPI for errors
 //#define SPI_STATUS_MONITOR  1
 
+// Define to receive GUI messages via the shared memory ring rather than the
+// GUI message queue (the message queue is used if the ring cannot be created)
+//#define GUI_MSG_RING_TRANSPORT  1
+
+// Define to read the scope samples from the shared memory sample ring (the
+// continuous audio-rate stream) rather than the samples message queue (the
+// message queue is used if the ring cannot be created)
+//#define SCOPE_SAMPLE_RING_TRANSPORT  1
+
+// Define to profile the cost of each MainWindow handler (the stats are shown
+// on SIGUSR1)
+//#define GUI_HANDLER_PROFILING  1
+
 // Constants
 constexpr uint LCD_HEIGHT                   = 480;
 constexpr uint LCD_WIDTH                    = 854;
@@ -34,10 +56,25 @@ constexpr char DSEG7_CLASSIC_FONT_RES[]     = ":res/DSEG7Classic-BoldItalic.ttf"
 constexpr uint STD_STR_LEN                  = 40;
 constexpr uint EDIT_NAME_STR_LEN            = 20;
 constexpr uint LIST_MAX_ITEMS               = 128;
+constexpr uint LIST_WINDOW_MAX_ITEMS        = 16;
 constexpr char DEFAULT_SYSTEM_COLOUR[]      = "FF0000";
 constexpr uint SCOPE_NUM_SAMPLES            = 128;
 constexpr uint SCOPE_SAMPLES_MSG_SIZE       = (SCOPE_NUM_SAMPLES * 2);
+constexpr uint SCOPE_MAX_TIMEBASE_FRAMES    = (192 * 1024);
+constexpr uint SCOPE_ENVELOPE_MAX_COLUMNS   = LCD_WIDTH;
 constexpr uint WT_CHART_REFRESH_RATE        = std::chrono::milliseconds(34).count();
+constexpr char GUI_MSG_QUEUE_NAME[]         = "/nina_msg_queue";
+constexpr uint GUI_MSG_QUEUE_SIZE           = 50;
+constexpr char GUI_MSG_RING_NAME[]          = "/nina_gui_msg_ring";
+constexpr char GUI_MSG_URGENT_RING_NAME[]   = "/nina_gui_msg_ring_urgent";
+constexpr char GUI_EVENT_MSG_QUEUE_NAME[]   = "/nina_gui_event_msg_queue";
+constexpr uint GUI_EVENT_MSG_QUEUE_SIZE     = 10;
+constexpr char SCOPE_SAMPLES_MSG_QUEUE_NAME[] = "/nina_samples_msg_queue";
+constexpr uint SCOPE_SAMPLES_MSG_QUEUE_SIZE = 1;
+constexpr uint SCOPE_SAMPLES_MSG_LEN        = (sizeof(float) * SCOPE_SAMPLES_MSG_SIZE);
+constexpr char SCOPE_SAMPLE_RING_NAME[]     = "/nina_scope_sample_ring";
+constexpr char GUI_MSG_INTERN_REF_CHAR      = '\x1f';
+constexpr uint GUI_MSG_MAX_INTERNED_STRINGS = 4096;
 
 // MACRO to show a string on the console
 #define MSG(str) do { std::cout << str << std::endl; } while( false )
@@ -49,29 +86,116 @@ constexpr uint WT_CHART_REFRESH_RATE        = std::chrono::milliseconds(34).coun
 #define DEBUG_MSG(str) do { } while ( false )
 #endif
 
+// GUI message coalescing policy
+// Last-writer-wins messages can be coalesced with a later message of the same
+// type, any other message is a barrier (see gui_msg_coalescer.h)
+enum GuiMsgPolicy : int
+{
+    BARRIER = 0,
+    LAST_WRITER_WINS
+};
+
+// GUI message lane
+// Urgent messages are sent in their own lane, which the GUI always drains
+// first. On the message queue the lane is the message priority, and on the
+// ring transport the urgent lane is a separate ring (so a full normal ring
+// does not hold up urgent messages)
+// Urgent messages are ordering barriers - each carries the number of normal
+// lane messages sent before it (GUI_MSG_FRAME_FLAG_ORDER), and is only applied
+// once the GUI has received them. It never overtakes an earlier normal message
+// (e.g. a warning screen is not hidden by a home screen sent before it), unless
+// the normal lane is empty and the earlier messages were lost
+enum GuiMsgLane : int
+{
+    LANE_NORMAL = 0,
+    LANE_URGENT
+};
+constexpr uint NUM_GUI_MSG_LANES = 2;
+
+// GUI message registry
+// Every GUI message type, with its payload struct, GuiMsg union member,
+// MainWindow handler, coalescing policy and lane. The message type enum and
+// the decoding, size validation, dispatch, coalescing and lane of each message
+// are all generated from this registry
+// Note: The type value is its position in the registry, so new message types
+// must only be added to the end. A new message type also needs its payload
+// struct, GuiMsg union member (checked against the registry below) and
+// MainWindow handler definition (the declaration is generated)
+//                   Type                       Payload              Member                  Handler                          Policy            Lane
+#define GUI_MSG_REGISTRY(X) \
+    X(SET_LEFT_STATUS,           LeftStatus,          left_status,            set_left_status,                 BARRIER,          LANE_NORMAL) \
+    X(SET_LAYER_STATUS,          LayerStatus,         layer_status,           set_layer_status,                BARRIER,          LANE_NORMAL) \
+    X(SET_MIDI_STATUS,           MidiStatus,          midi_status,            set_midi_status,                 LAST_WRITER_WINS, LANE_NORMAL) \
+    X(SET_TEMPO_STATUS,          TempoStatus,         tempo_status,           set_tempo_status,                LAST_WRITER_WINS, LANE_NORMAL) \
+    X(SHOW_HOME_SCREEN,          HomeScreen,          home_screen,            show_home_screen,                BARRIER,          LANE_NORMAL) \
+    X(SHOW_LIST_ITEMS,           ListItems,           list_items,             show_list_items,                 BARRIER,          LANE_NORMAL) \
+    X(LIST_SELECT_ITEM,          ListSelectItem,      list_select_item,       list_select_item,                LAST_WRITER_WINS, LANE_NORMAL) \
+    X(SET_SOFT_BUTTONS,          SoftButtons,         soft_buttons,           set_soft_buttons,                BARRIER,          LANE_NORMAL) \
+    X(SOFT_BUTTONS_STATE,        SoftButtonsState,    soft_buttons_state,     set_soft_buttons_state,          BARRIER,          LANE_NORMAL) \
+    X(PARAM_UPDATE,              ParamUpdate,         param_update,           process_param_update,            BARRIER,          LANE_NORMAL) \
+    X(PARAM_VALUE_UPDATE,        ParamValueUpdate,    param_value_update,     process_param_value_update,      LAST_WRITER_WINS, LANE_NORMAL) \
+    X(ENUM_PARAM_UPDATE,         EnumParamUpdate,     enum_param_update,      process_enum_param_update,       BARRIER,          LANE_NORMAL) \
+    X(ENUM_PARAM_UPDATE_VALUE,   ListSelectItem,      list_select_item,       process_enum_param_value_update, LAST_WRITER_WINS, LANE_NORMAL) \
+    X(EDIT_NAME,                 EditName,            edit_name,              process_edit_name,               BARRIER,          LANE_NORMAL) \
+    X(EDIT_NAME_SELECT_CHAR,     EditNameSelectChar,  edit_name_select_char,  process_edit_name_select_char,   BARRIER,          LANE_NORMAL) \
+    X(EDIT_NAME_CHANGE_CHAR,     EditNameChangeChar,  edit_name_change_char,  process_edit_name_change_char,   BARRIER,          LANE_NORMAL) \
+    X(SHOW_CONFIRMATION_SCREEN,  ConfirmationScreen,  confirmation_screen,    show_confirmation_screen,        BARRIER,          LANE_NORMAL) \
+    X(SHOW_WARNING_SCREEN,       WarningScreen,       warning_screen,         show_warning_screen,             BARRIER,          LANE_URGENT) \
+    X(CLEAR_BOOT_WARNING_SCREEN, ClearBootWarning,    clear_boot_warning,     clear_boot_warning,              BARRIER,          LANE_URGENT) \
+    X(SET_SYSTEM_COLOUR,         SetSystemColour,     set_system_colour,      set_system_colour,               BARRIER,          LANE_URGENT) \
+    X(LIST_ITEMS_DELTA,          ListItemsDelta,      list_items_delta,       process_list_items_delta,        BARRIER,          LANE_NORMAL) \
+    X(LIST_WINDOW,               ListWindow,          list_window,            process_list_window,             BARRIER,          LANE_NORMAL) \
+    X(INTERN_STRING,             InternString,        intern_string,          intern_string,                   BARRIER,          LANE_NORMAL) \
+    X(SET_SCOPE_TIMEBASE,        ScopeTimebase,       scope_timebase,         set_scope_timebase,              LAST_WRITER_WINS, LANE_NORMAL)
+
 // GUI Message Type
+#define GUI_MSG_TYPE_ENUM(type, payload, member, handler, policy, lane) type,
+#define GUI_MSG_TYPE_COUNT(type, payload, member, handler, policy, lane) + 1
 enum GuiMsgType : int
 {
-    SET_LEFT_STATUS = 0,
-    SET_LAYER_STATUS,
-    SET_MIDI_STATUS,
-    SET_TEMPO_STATUS,
-    SHOW_HOME_SCREEN,
-    SHOW_LIST_ITEMS,
-    LIST_SELECT_ITEM,
-    SET_SOFT_BUTTONS,
-    SOFT_BUTTONS_STATE,
-    PARAM_UPDATE,
-    PARAM_VALUE_UPDATE,
-    ENUM_PARAM_UPDATE,
-    ENUM_PARAM_UPDATE_VALUE,
-    EDIT_NAME,
-    EDIT_NAME_SELECT_CHAR,
-    EDIT_NAME_CHANGE_CHAR,
-    SHOW_CONFIRMATION_SCREEN,
-    SHOW_WARNING_SCREEN,
-    CLEAR_BOOT_WARNING_SCREEN,
-    SET_SYSTEM_COLOUR
+    GUI_MSG_REGISTRY(GUI_MSG_TYPE_ENUM)
+};
+constexpr uint NUM_GUI_MSG_TYPES = (0 GUI_MSG_REGISTRY(GUI_MSG_TYPE_COUNT));
+#undef GUI_MSG_TYPE_ENUM
+#undef GUI_MSG_TYPE_COUNT
+
+// Returns the coalescing policy of a GUI message type
+constexpr GuiMsgPolicy gui_msg_policy(GuiMsgType type)
+{
+    switch (type)
+    {
+#define GUI_MSG_TYPE_POLICY(type, payload, member, handler, policy, lane) \
+        case GuiMsgType::type: return GuiMsgPolicy::policy;
+        GUI_MSG_REGISTRY(GUI_MSG_TYPE_POLICY)
+#undef GUI_MSG_TYPE_POLICY
+
+        default:
+            return GuiMsgPolicy::BARRIER;
+    }
+}
+
+// Returns the lane of a GUI message type
+constexpr GuiMsgLane gui_msg_lane(GuiMsgType type)
+{
+    switch (type)
+    {
+#define GUI_MSG_TYPE_LANE(type, payload, member, handler, policy, lane) \
+        case GuiMsgType::type: return GuiMsgLane::lane;
+        GUI_MSG_REGISTRY(GUI_MSG_TYPE_LANE)
+#undef GUI_MSG_TYPE_LANE
+
+        default:
+            return GuiMsgLane::LANE_NORMAL;
+    }
+}
+
+// GUI Event Type
+// Events sent from the GUI to the Nina UI app
+enum GuiEventType : int
+{
+    LIST_WINDOW_REQUEST = 0,
+    GUI_MSGS_APPLIED,
+    LIST_RESYNC_REQUEST
 };
 
 // GUI scope mode
@@ -82,6 +206,25 @@ enum GuiScopeMode : int
     SCOPE_MODE_XY
 };
 
+// GUI list identity
+// The none identity is only used by the GUI when no list is shown (it is never
+// sent)
+enum GuiListId : int
+{
+    LIST_ID_NONE = -1,
+    LIST_ID_MAIN_AREA,
+    LIST_ID_PARAMS
+};
+
+// GUI list delta operation
+enum GuiListOp : int
+{
+    LIST_OP_INSERT,
+    LIST_OP_UPDATE,
+    LIST_OP_REMOVE,
+    LIST_OP_SET_ENABLED
+};
+
 struct LeftStatus
 {
     char status[STD_STR_LEN];
@@ -215,12 +358,79 @@ struct WarningScreen
 };
 Q_DECLARE_METATYPE(WarningScreen);
 
+// Clear boot warning screen
+// Note: This message has no payload
+struct ClearBootWarning
+{
+};
+
 struct SetSystemColour
 {
     char colour[STD_STR_LEN];
 };
 Q_DECLARE_METATYPE(SetSystemColour);
 
+// List items delta
+// Patches a single row of a list sent with SHOW_LIST_ITEMS (main area list) or
+// PARAM_UPDATE (params list). The version is the number of deltas sent for the
+// list since it was last sent in full - a delta is ignored if it is not the next
+// delta for the list currently shown. If the list is shown but the version is
+// not the next expected, the GUI sends a LIST_RESYNC_REQUEST event (once until
+// the list is next sent in full), and the list must be sent in full again. A
+// delta for a list not shown is stale (the full list messages are never
+// dropped), and is just ignored
+struct ListItemsDelta
+{
+    GuiListId list_id;
+    uint version;
+    GuiListOp op;
+    uint index;
+    char item[STD_STR_LEN];
+    bool enabled;
+    bool separator;
+};
+Q_DECLARE_METATYPE(ListItemsDelta);
+
+// List window
+// A window of rows in a windowed (virtual) main area list, which can have any
+// number of items. The list serial identifies the list contents - a new serial
+// shows a new list, otherwise the rows are added to the current list. Further
+// rows are requested by the GUI as the list is scrolled
+struct ListWindow
+{
+    uint list_serial;
+    uint total_items;
+    uint selected_item;
+    uint first_item;
+    uint num_items;
+    char items[LIST_WINDOW_MAX_ITEMS][STD_STR_LEN];
+    bool list_item_enabled[LIST_WINDOW_MAX_ITEMS];
+};
+Q_DECLARE_METATYPE(ListWindow);
+
+// Intern string
+// Registers a string under an ID, so that later messages can reference it in
+// any displayed text field (every string field except the system colour)
+// rather than sending it in full (see gui_msg_set_intern_ref). Interning an
+// existing ID replaces its string
+struct InternString
+{
+    uint id;
+    char str[STD_STR_LEN];
+};
+Q_DECLARE_METATYPE(InternString);
+
+// Scope timebase
+// The number of stereo frames shown across the OSC scope, from SCOPE_NUM_SAMPLES
+// (the default) up to SCOPE_MAX_TIMEBASE_FRAMES. Longer timebases are read from
+// the scope sample ring history and shown as a min/max envelope, so need the
+// scope sample ring transport
+struct ScopeTimebase
+{
+    uint num_frames;
+};
+Q_DECLARE_METATYPE(ScopeTimebase);
+
 // GUI message
 struct GuiMsg
 {
@@ -244,7 +454,12 @@ struct GuiMsg
         EditNameChangeChar edit_name_change_char;
         ConfirmationScreen confirmation_screen;
         WarningScreen warning_screen;
+        ClearBootWarning clear_boot_warning;
         SetSystemColour set_system_colour;
+        ListItemsDelta list_items_delta;
+        ListWindow list_window;
+        InternString intern_string;
+        ScopeTimebase scope_timebase;
     };
 
     // Constructor/destructor
@@ -252,4 +467,137 @@ struct GuiMsg
     ~GuiMsg() {}
 };
 
+// Check each message in the registry has a GuiMsg union member of its payload
+#define GUI_MSG_MEMBER_CHECK(type, payload, member, handler, policy, lane) \
+    static_assert(std::is_same<decltype(GuiMsg::member), payload>::value, "GuiMsg::" #member " must be a " #payload);
+GUI_MSG_REGISTRY(GUI_MSG_MEMBER_CHECK)
+#undef GUI_MSG_MEMBER_CHECK
+
+//----------------------------------------------------------------------------
+// gui_msg_set_intern_ref
+// Sets a string to reference an interned string - the reference char
+// followed by the ID in decimal
+//----------------------------------------------------------------------------
+inline void gui_msg_set_intern_ref(char *str, uint id)
+{
+    char digits[10];
+    uint num_digits = 0;
+    do {
+        digits[num_digits++] = '0' + (id % 10);
+        id /= 10;
+    } while (id);
+    *str++ = GUI_MSG_INTERN_REF_CHAR;
+    while (num_digits)
+        *str++ = digits[--num_digits];
+    *str = '\0';
+}
+
+//----------------------------------------------------------------------------
+// gui_msg_get_intern_ref
+// Returns true if the string references an interned string, and the ID
+//----------------------------------------------------------------------------
+inline bool gui_msg_get_intern_ref(const char *str, uint& id)
+{
+    // The ID is accumulated in 64 bits so that an over-long ID is rejected
+    // rather than wrapping
+    if ((str[0] != GUI_MSG_INTERN_REF_CHAR) || (str[1] == '\0'))
+        return false;
+    uint64_t value = 0;
+    for (uint i=1; str[i] != '\0'; i++) {
+        if ((str[i] < '0') || (str[i] > '9') || (i > 10))
+            return false;
+        value = (value * 10) + (str[i] - '0');
+    }
+    if (value > UINT_MAX)
+        return false;
+    id = value;
+    return true;
+}
+
+// List window request
+// Requests the Nina UI app sends a window of rows for a windowed list
+struct ListWindowRequest
+{
+    GuiListId list_id;
+    uint list_serial;
+    uint first_item;
+    uint num_items;
+};
+
+// List resync request
+// Requests the Nina UI app sends a list in full again, as a delta for it was
+// not the next expected - the expected version is the version of the next
+// delta the GUI expected
+struct ListResyncRequest
+{
+    GuiListId list_id;
+    uint expected_version;
+};
+
+// GUI messages applied
+// Reports the highest trace sequence number of the GUI messages applied in a
+// lane, for messages sent with the trace ack flag - the GUI has applied (or
+// coalesced) every message sent before it in that lane. One event is sent for
+// each lane with messages applied
+struct GuiMsgsApplied
+{
+    GuiMsgLane lane;
+    uint32_t seq;
+};
+
+// GUI event message
+struct GuiEventMsg
+{
+    GuiEventType type;
+    union
+    {
+        ListWindowRequest list_window_request;
+        GuiMsgsApplied gui_msgs_applied;
+        ListResyncRequest list_resync_request;
+    };
+
+    // Constructor/destructor
+    GuiEventMsg() {}
+    ~GuiEventMsg() {}
+};
+
+// GUI message frame
+// Framed messages start with this header, followed by a payload sized to the
+// message (see gui_msg_codec.h). Legacy messages are a full GuiMsg, and are
+// identified by their size and the absence of the frame magic
+// If the trace flag is set, a GuiMsgTrace follows the header (before the
+// payload). If the order flag is set (urgent messages), a uint32_t follows the
+// header and trace - the number of normal lane frames the sender had sent
+// before the message
+constexpr uint32_t GUI_MSG_FRAME_MAGIC      = 0x414E494E;     // "NINA"
+constexpr uint16_t GUI_MSG_FRAME_VERSION    = 1;
+constexpr uint16_t GUI_MSG_FRAME_FLAG_TRACE = 0x0001;
+constexpr uint16_t GUI_MSG_FRAME_FLAG_ORDER = 0x0002;
+constexpr uint GUI_MSG_MAX_SIZE             = sizeof(GuiMsg);
+
+struct GuiMsgFrameHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    GuiMsgType type;
+    uint32_t payload_len;
+};
+
+// GUI message trace
+// Optionally sent with a framed GUI message, or after the samples in a scope
+// samples message, to measure the end-to-end latency of the message
+// The sequence numbers are counted separately in each GUI message lane (and
+// for the scope samples), so that a gap in them means messages were dropped
+// If the ack flag is set, the GUI reports the GUI messages applied back to the
+// producer (GUI_MSGS_APPLIED event) for flow control
+constexpr uint32_t GUI_MSG_TRACE_FLAG_ACK   = 0x00000001;
+struct GuiMsgTrace
+{
+    uint32_t seq;
+    uint32_t flags;
+    uint64_t send_time;     // ns, CLOCK_MONOTONIC
+};
+constexpr uint SCOPE_SAMPLES_MSG_MAX_LEN = (SCOPE_SAMPLES_MSG_LEN + sizeof(GuiMsgTrace));
+
 #endif  // _COMMON_H
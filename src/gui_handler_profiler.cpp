@@ -0,0 +1,133 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  gui_handler_profiler.cpp
+ * @brief GUI Handler Profiler class implementation.
+ *-----------------------------------------------------------------------------
+ */
+#include <iomanip>
+#include <QCoreApplication>
+#include <QChildEvent>
+#include "gui_handler_profiler.h"
+
+//----------------------------------------------------------------------------
+// GuiHandlerProfiler
+//----------------------------------------------------------------------------
+GuiHandlerProfiler::GuiHandlerProfiler(QObject *parent) :
+    QObject(parent)
+{
+    // Initialise class variables
+    for (uint i=0; i<NUM_GUI_HANDLERS; i++) {
+        _stats[i].num_calls = 0;
+        _stats[i].total_us = 0;
+        _stats[i].num_over_budget = 0;
+        _stats[i].num_widgets_created = 0;
+        _stats[i].num_widgets_restyled = 0;
+    }
+    _current_handler = -1;
+
+    // Filter the application events, to count the widgets created and restyled
+    qApp->installEventFilter(this);
+}
+
+//----------------------------------------------------------------------------
+// ~GuiHandlerProfiler
+//----------------------------------------------------------------------------
+GuiHandlerProfiler::~GuiHandlerProfiler()
+{
+    // Stop filtering the application events
+    qApp->removeEventFilter(this);
+}
+
+//----------------------------------------------------------------------------
+// begin
+// Returns the previous handler, which is restored when this handler ends
+//----------------------------------------------------------------------------
+int GuiHandlerProfiler::begin(uint handler)
+{
+    int prev_handler = _current_handler;
+    _current_handler = handler;
+    return prev_handler;
+}
+
+//----------------------------------------------------------------------------
+// end
+//----------------------------------------------------------------------------
+void GuiHandlerProfiler::end(uint handler, uint64_t elapsed_us, int prev_handler)
+{
+    // Update the handler stats, and restore the previous handler
+    auto& stats = _stats[handler];
+    stats.num_calls++;
+    stats.total_us += elapsed_us;
+    if (elapsed_us > GUI_HANDLER_FRAME_BUDGET_US)
+        stats.num_over_budget++;
+    stats.histogram.record(elapsed_us);
+    _current_handler = prev_handler;
+}
+
+//----------------------------------------------------------------------------
+// print_stats
+//----------------------------------------------------------------------------
+void GuiHandlerProfiler::print_stats() const
+{
+    // Show the stats table for each handler called (times in us)
+    MSG("GuiHandlerProfiler: " << std::left << std::setw(32) << "handler" << std::right << std::setw(8) << "calls" <<
+        std::setw(10) << "total ms" << std::setw(8) << "avg" << std::setw(8) << "p99" << std::setw(8) << "max" <<
+        std::setw(8) << ">16ms" << std::setw(9) << "created" << std::setw(9) << "restyled");
+    for (uint i=0; i<NUM_GUI_HANDLERS; i++) {
+        auto& stats = _stats[i];
+        if (stats.num_calls == 0)
+            continue;
+        MSG("GuiHandlerProfiler: " << std::left << std::setw(32) << _handler_name(i) << std::right <<
+            std::setw(8) << stats.num_calls << std::setw(10) << (stats.total_us / 1000) <<
+            std::setw(8) << stats.histogram.mean() << std::setw(8) << stats.histogram.percentile(99.0f) <<
+            std::setw(8) << stats.histogram.max() << std::setw(8) << stats.num_over_budget <<
+            std::setw(9) << stats.num_widgets_created << std::setw(9) << stats.num_widgets_restyled);
+    }
+}
+
+//----------------------------------------------------------------------------
+// eventFilter
+//----------------------------------------------------------------------------
+bool GuiHandlerProfiler::eventFilter(QObject *obj, QEvent *event)
+{
+    // If a handler is running, count the widgets created (added to a parent)
+    // and restyled
+    if (_current_handler != -1) {
+        if (event->type() == QEvent::ChildAdded) {
+            if (static_cast<QChildEvent *>(event)->child()->isWidgetType())
+                _stats[_current_handler].num_widgets_created++;
+        }
+        else if ((event->type() == QEvent::StyleChange) && obj->isWidgetType()) {
+            _stats[_current_handler].num_widgets_restyled++;
+        }
+    }
+
+    // Never filter the event out
+    return false;
+}
+
+//----------------------------------------------------------------------------
+// _handler_name
+//----------------------------------------------------------------------------
+const char *GuiHandlerProfiler::_handler_name(uint handler)
+{
+    // Return the MainWindow handler name
+    switch (handler)
+    {
+#define GUI_MSG_HANDLER_NAME(type, payload, member, handler, policy, lane) \
+        case GuiMsgType::type: return #handler;
+        GUI_MSG_REGISTRY(GUI_MSG_HANDLER_NAME)
+#undef GUI_MSG_HANDLER_NAME
+
+        case GUI_HANDLER_PROCESS_GUI_MSGS:
+            return "process_gui_msgs (batch)";
+
+        case GUI_HANDLER_UPDATE_WT_CHART:
+            return "_update_wt_chart";
+
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,100 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  gui_handler_profiler.h
+ * @brief GUI Handler Profiler class definitions.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef GUI_HANDLER_PROFILER_H
+#define GUI_HANDLER_PROFILER_H
+
+#include <QObject>
+#include <QEvent>
+#include "common.h"
+#include "gui_msg_latency.h"
+
+// Constants
+constexpr uint GUI_HANDLER_FRAME_BUDGET_US   = 16000;
+constexpr uint GUI_HANDLER_PROCESS_GUI_MSGS  = NUM_GUI_MSG_TYPES;
+constexpr uint GUI_HANDLER_UPDATE_WT_CHART   = (NUM_GUI_MSG_TYPES + 1);
+constexpr uint NUM_GUI_HANDLERS              = (NUM_GUI_MSG_TYPES + 2);
+
+// GUI handler stats
+struct GuiHandlerStats
+{
+    uint64_t num_calls;
+    uint64_t total_us;
+    uint64_t num_over_budget;
+    uint64_t num_widgets_created;
+    uint64_t num_widgets_restyled;
+    LatencyHistogram histogram;
+};
+
+// GUI Handler Profiler class
+// Collects the cost of each MainWindow handler - the message handlers are
+// identified by their GuiMsgType. The widgets created and restyled are
+// counted with an application event filter, and are attributed to the
+// innermost handler running
+// Note: Only accessed from the GUI thread
+class GuiHandlerProfiler : public QObject
+{
+    Q_OBJECT
+public:
+    // Constructor/destructor
+    GuiHandlerProfiler(QObject *parent=nullptr);
+    ~GuiHandlerProfiler();
+
+    // Public functions
+    int begin(uint handler);
+    void end(uint handler, uint64_t elapsed_us, int prev_handler);
+    void print_stats() const;
+
+protected:
+    // Protected functions
+    bool eventFilter(QObject *obj, QEvent *event) override;
+
+private:
+    // Private data
+    GuiHandlerStats _stats[NUM_GUI_HANDLERS];
+    int _current_handler;
+
+    // Private functions
+    static const char *_handler_name(uint handler);
+};
+
+// GUI Handler Profile class
+// Scoped instrumentation of a handler, the handler is profiled from
+// construction until the end of the scope
+class GuiHandlerProfile
+{
+public:
+    // Constructor/destructor
+    GuiHandlerProfile(GuiHandlerProfiler& profiler, uint handler) :
+        _profiler(profiler),
+        _handler(handler)
+    {
+        _prev_handler = _profiler.begin(handler);
+        _start = GuiMsgLatency::now();
+    }
+    ~GuiHandlerProfile()
+    {
+        _profiler.end(_handler, ((GuiMsgLatency::now() - _start) / 1000), _prev_handler);
+    }
+
+private:
+    // Private data
+    GuiHandlerProfiler& _profiler;
+    uint _handler;
+    int _prev_handler;
+    uint64_t _start;
+};
+
+// MACRO to profile a handler (if enabled)
+#ifdef GUI_HANDLER_PROFILING
+#define GUI_HANDLER_PROFILE(profiler, handler) GuiHandlerProfile _handler_profile(profiler, handler)
+#else
+#define GUI_HANDLER_PROFILE(profiler, handler) do { } while (false)
+#endif
+
+#endif  // GUI_HANDLER_PROFILER_H
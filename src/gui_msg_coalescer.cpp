@@ -0,0 +1,186 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  gui_msg_coalescer.cpp
+ * @brief GUI Message Coalescer class implementation.
+ *-----------------------------------------------------------------------------
+ */
+#include "gui_msg_coalescer.h"
+
+//----------------------------------------------------------------------------
+// GuiMsgCoalescer
+//----------------------------------------------------------------------------
+GuiMsgCoalescer::GuiMsgCoalescer(GuiMsgPool& pool) :
+    _pool(pool)
+{
+    // Initialise class variables
+    for (uint i=0; i<NUM_GUI_MSG_TYPES; i++) {
+        _num_msgs[i] = 0;
+        _num_coalesced[i] = 0;
+    }
+    clear();
+}
+
+//----------------------------------------------------------------------------
+// next_msg
+//----------------------------------------------------------------------------
+GuiMsg *GuiMsgCoalescer::next_msg()
+{
+    // Return the next free message in the batch, acquiring it from the pool if
+    // needed - this must not be called if the batch is full
+    // Note: Returns nullptr if the pool has been cancelled
+    if (!_msgs[_count].is_valid())
+        _msgs[_count] = _pool.acquire();
+    return _msgs[_count].get();
+}
+
+//----------------------------------------------------------------------------
+// next_timing
+//----------------------------------------------------------------------------
+GuiMsgTiming *GuiMsgCoalescer::next_timing()
+{
+    // Return the timing of the next free message - next_msg must be called first
+    return _msgs[_count].timing();
+}
+
+//----------------------------------------------------------------------------
+// commit
+//----------------------------------------------------------------------------
+void GuiMsgCoalescer::commit()
+{
+    auto type = _msgs[_count]->type;
+    _num_msgs[type].fetch_add(1, std::memory_order_relaxed);
+
+    // Is this a last-writer-wins message?
+    if (last_writer_wins(type)) {
+        // If there is an earlier message of this type in the current segment,
+        // then it has been superseded by this message
+        if (_last_index[type] != -1) {
+            _msgs[_last_index[type]].release();
+            _num_coalesced[type].fetch_add(1, std::memory_order_relaxed);
+        }
+        _last_index[type] = _count;
+    }
+    else {
+        // This message is a barrier, start a new segment
+        _start_segment();
+    }
+    _count++;
+}
+
+//----------------------------------------------------------------------------
+// full
+//----------------------------------------------------------------------------
+bool GuiMsgCoalescer::full() const
+{
+    return _count == GUI_MSG_BATCH_SIZE;
+}
+
+//----------------------------------------------------------------------------
+// count
+//----------------------------------------------------------------------------
+uint GuiMsgCoalescer::count() const
+{
+    return _count;
+}
+
+//----------------------------------------------------------------------------
+// msg
+//----------------------------------------------------------------------------
+const GuiMsgHandle& GuiMsgCoalescer::msg(uint index) const
+{
+    // Return the message - the handle is not valid if it has been superseded
+    return _msgs[index];
+}
+
+//----------------------------------------------------------------------------
+// clear
+//----------------------------------------------------------------------------
+void GuiMsgCoalescer::clear()
+{
+    // Empty the batch, releasing the messages
+    // Note: The next free message is kept for the next batch
+    for (uint i=0; i<_count; i++) {
+        _msgs[i].release();
+    }
+    if (_count) {
+        _msgs[0] = std::move(_msgs[_count]);
+    }
+    _count = 0;
+    _start_segment();
+}
+
+//----------------------------------------------------------------------------
+// num_msgs
+//----------------------------------------------------------------------------
+uint64_t GuiMsgCoalescer::num_msgs(GuiMsgType type) const
+{
+    return _num_msgs[type].load(std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// num_coalesced
+//----------------------------------------------------------------------------
+uint64_t GuiMsgCoalescer::num_coalesced(GuiMsgType type) const
+{
+    return _num_coalesced[type].load(std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// print_stats
+//----------------------------------------------------------------------------
+void GuiMsgCoalescer::print_stats() const
+{
+    uint64_t total_msgs = 0;
+    uint64_t total_coalesced = 0;
+
+    // Show the number of messages coalesced for each last-writer-wins type
+    for (uint i=0; i<NUM_GUI_MSG_TYPES; i++) {
+        auto type = static_cast<GuiMsgType>(i);
+        total_msgs += num_msgs(type);
+        total_coalesced += num_coalesced(type);
+        if (last_writer_wins(type)) {
+            MSG("GuiMsgCoalescer: " << type_name(type) << ": " << num_coalesced(type) << "/" << num_msgs(type) << " coalesced");
+        }
+    }
+    MSG("GuiMsgCoalescer: TOTAL: " << total_coalesced << "/" << total_msgs << " coalesced");
+}
+
+//----------------------------------------------------------------------------
+// last_writer_wins
+//----------------------------------------------------------------------------
+bool GuiMsgCoalescer::last_writer_wins(GuiMsgType type)
+{
+    // These messages fully replace the state set by an earlier message of the
+    // same type, and are independent of each other (see the GUI message registry)
+    return gui_msg_policy(type) == GuiMsgPolicy::LAST_WRITER_WINS;
+}
+
+//----------------------------------------------------------------------------
+// type_name
+//----------------------------------------------------------------------------
+const char *GuiMsgCoalescer::type_name(GuiMsgType type)
+{
+    switch (type)
+    {
+#define GUI_MSG_TYPE_NAME(type, payload, member, handler, policy, lane) \
+        case GuiMsgType::type: return #type;
+        GUI_MSG_REGISTRY(GUI_MSG_TYPE_NAME)
+#undef GUI_MSG_TYPE_NAME
+
+        default:
+            return "UNKNOWN";
+    }
+}
+
+//----------------------------------------------------------------------------
+// _start_segment
+//----------------------------------------------------------------------------
+void GuiMsgCoalescer::_start_segment()
+{
+    // No messages can be coalesced with those before the segment
+    for (uint i=0; i<NUM_GUI_MSG_TYPES; i++) {
+        _last_index[i] = -1;
+    }
+}
@@ -0,0 +1,61 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  gui_msg_coalescer.h
+ * @brief GUI Message Coalescer class definitions.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef GUI_MSG_COALESCER_H
+#define GUI_MSG_COALESCER_H
+
+#include <atomic>
+#include "common.h"
+#include "gui_msg_pool.h"
+
+// Constants
+constexpr uint GUI_MSG_BATCH_SIZE = 64;
+
+// GUI Message Coalescer class
+// Collects a batch of GUI messages, and drops any "last-writer-wins" message
+// that is superseded by a later message of the same type. Any other message
+// type is a barrier - messages are never coalesced across a barrier, so the
+// order of the batch is preserved relative to screen changes
+// The messages are held in the GUI message pool, and superseded messages are
+// returned to the pool immediately
+class GuiMsgCoalescer
+{
+public:
+    // Constructor
+    GuiMsgCoalescer(GuiMsgPool& pool);
+
+    // Public functions
+    GuiMsg *next_msg();
+    GuiMsgTiming *next_timing();
+    void commit();
+    bool full() const;
+    uint count() const;
+    const GuiMsgHandle& msg(uint index) const;
+    void clear();
+    uint64_t num_msgs(GuiMsgType type) const;
+    uint64_t num_coalesced(GuiMsgType type) const;
+    void print_stats() const;
+
+    // Helper functions
+    static bool last_writer_wins(GuiMsgType type);
+    static const char *type_name(GuiMsgType type);
+
+private:
+    // Private data
+    GuiMsgPool& _pool;
+    GuiMsgHandle _msgs[GUI_MSG_BATCH_SIZE + 1];
+    int _last_index[NUM_GUI_MSG_TYPES];
+    uint _count;
+    std::atomic<uint64_t> _num_msgs[NUM_GUI_MSG_TYPES];
+    std::atomic<uint64_t> _num_coalesced[NUM_GUI_MSG_TYPES];
+
+    // Private functions
+    void _start_segment();
+};
+
+#endif
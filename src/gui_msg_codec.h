@@ -0,0 +1,423 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  gui_msg_codec.h
+ * @brief GUI Message Codec class definitions and implementation.
+ *
+ * The codec converts between a GuiMsg and its framed wire format - a
+ * GuiMsgFrameHeader followed by a payload sized to the message. Small
+ * messages are sent as their raw payload struct, while list messages only
+ * carry the strings and flags actually used.
+ * Note: The codec is shared with the Nina UI app (the message producer), and
+ * is therefore implemented in this header.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef GUI_MSG_CODEC_H
+#define GUI_MSG_CODEC_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "common.h"
+
+// Constants
+constexpr uint GUI_MSG_LIST_FLAGS_SIZE = ((LIST_MAX_ITEMS + 7) / 8);
+constexpr uint GUI_MSG_MAX_PAYLOAD_LEN = ((4 * STD_STR_LEN) + (2 * sizeof(uint32_t)) + 1 +
+                                          (LIST_MAX_ITEMS * STD_STR_LEN) + (2 * GUI_MSG_LIST_FLAGS_SIZE));
+constexpr uint GUI_MSG_MAX_FRAME_SIZE  = (sizeof(GuiMsgFrameHeader) + sizeof(GuiMsgTrace) + sizeof(uint32_t) +
+                                          GUI_MSG_MAX_PAYLOAD_LEN);
+static_assert(GUI_MSG_MAX_FRAME_SIZE <= GUI_MSG_MAX_SIZE, "A GUI message frame must fit in the GUI message queue");
+
+// GUI Message Codec class
+class GuiMsgCodec
+{
+public:
+    //----------------------------------------------------------------------------
+    // is_frame
+    //----------------------------------------------------------------------------
+    static bool is_frame(const uint8_t *buf, uint len)
+    {
+        uint32_t magic;
+
+        // A frame always starts with the frame magic
+        if (len < sizeof(GuiMsgFrameHeader))
+            return false;
+        std::memcpy(&magic, buf, sizeof(magic));
+        return magic == GUI_MSG_FRAME_MAGIC;
+    }
+
+    //----------------------------------------------------------------------------
+    // get_order
+    // Returns true if the frame has a normal lane order, and the order
+    //----------------------------------------------------------------------------
+    static bool get_order(const uint8_t *buf, uint len, uint32_t& order)
+    {
+        // The order follows the header and trace (if any)
+        if (!is_frame(buf, len))
+            return false;
+        GuiMsgFrameHeader header;
+        std::memcpy(&header, buf, sizeof(header));
+        uint offset = sizeof(header) + ((header.flags & GUI_MSG_FRAME_FLAG_TRACE) ? sizeof(GuiMsgTrace) : 0);
+        if (!(header.flags & GUI_MSG_FRAME_FLAG_ORDER) || (len < (offset + sizeof(order))))
+            return false;
+        std::memcpy(&order, buf + offset, sizeof(order));
+        return true;
+    }
+
+    //----------------------------------------------------------------------------
+    // encode
+    // If a trace is specified it is sent with the message, and likewise the
+    // normal lane order (urgent messages only)
+    //----------------------------------------------------------------------------
+    static uint encode(const GuiMsg& msg, uint8_t *buf, uint buf_size, const GuiMsgTrace *trace=nullptr,
+                       const uint32_t *order=nullptr)
+    {
+        // Make sure there is room for the header, trace and order (if any)
+        uint header_len = sizeof(GuiMsgFrameHeader) + (trace ? sizeof(GuiMsgTrace) : 0) + (order ? sizeof(uint32_t) : 0);
+        if (buf_size < header_len)
+            return 0;
+
+        // Encode the payload after the header and trace
+        _Writer writer(buf + header_len, buf_size - header_len);
+        switch (msg.type)
+        {
+#define GUI_MSG_ENCODE(type, payload, member, handler, policy, lane) \
+            case GuiMsgType::type: _encode_payload(msg.member, writer); break;
+            GUI_MSG_REGISTRY(GUI_MSG_ENCODE)
+#undef GUI_MSG_ENCODE
+
+            default:
+                // Unknown message type
+                return 0;
+        }
+        if (writer.overflow())
+            return 0;
+
+        // Now fill in the header
+        GuiMsgFrameHeader header;
+        header.magic = GUI_MSG_FRAME_MAGIC;
+        header.version = GUI_MSG_FRAME_VERSION;
+        header.flags = (trace ? GUI_MSG_FRAME_FLAG_TRACE : 0) | (order ? GUI_MSG_FRAME_FLAG_ORDER : 0);
+        header.type = msg.type;
+        header.payload_len = writer.len();
+        std::memcpy(buf, &header, sizeof(header));
+        if (trace)
+            std::memcpy(buf + sizeof(header), trace, sizeof(GuiMsgTrace));
+        if (order)
+            std::memcpy(buf + header_len - sizeof(uint32_t), order, sizeof(uint32_t));
+        return header_len + writer.len();
+    }
+
+    //----------------------------------------------------------------------------
+    // decode
+    // If traced is specified it indicates if a trace was sent with the message,
+    // and if so the trace is returned
+    //----------------------------------------------------------------------------
+    static bool decode(const uint8_t *buf, uint len, GuiMsg& msg, bool *traced=nullptr, GuiMsgTrace *trace=nullptr)
+    {
+        if (traced)
+            *traced = false;
+
+        // Is this a legacy message? These are always a full GuiMsg
+        if (!is_frame(buf, len))
+        {
+            if (len != sizeof(GuiMsg))
+                return false;
+            std::memcpy((void *)&msg, buf, sizeof(GuiMsg));
+            return (msg.type >= 0) && ((uint)msg.type < NUM_GUI_MSG_TYPES);
+        }
+
+        // Get and check the frame header
+        GuiMsgFrameHeader header;
+        std::memcpy(&header, buf, sizeof(header));
+        uint header_len = sizeof(header) + ((header.flags & GUI_MSG_FRAME_FLAG_TRACE) ? sizeof(GuiMsgTrace) : 0) +
+                          ((header.flags & GUI_MSG_FRAME_FLAG_ORDER) ? sizeof(uint32_t) : 0);
+        if ((header.version != GUI_MSG_FRAME_VERSION) || (len < header_len) ||
+            (header.payload_len != (len - header_len)))
+            return false;
+
+        // Get the trace, if any
+        if ((header.flags & GUI_MSG_FRAME_FLAG_TRACE) && trace)
+        {
+            std::memcpy(trace, buf + sizeof(header), sizeof(GuiMsgTrace));
+            if (traced)
+                *traced = true;
+        }
+
+        // Decode the payload
+        _Reader reader(buf + header_len, header.payload_len);
+        msg.type = header.type;
+        switch (msg.type)
+        {
+#define GUI_MSG_DECODE(type, payload, member, handler, policy, lane) \
+            case GuiMsgType::type: _decode_payload(reader, msg.member); break;
+            GUI_MSG_REGISTRY(GUI_MSG_DECODE)
+#undef GUI_MSG_DECODE
+
+            default:
+                // Unknown message type
+                return false;
+        }
+        return !reader.underflow() && (reader.remaining() == 0);
+    }
+
+private:
+    // Payload writer
+    class _Writer
+    {
+    public:
+        _Writer(uint8_t *buf, uint size) : _buf(buf), _size(size), _len(0), _overflow(false) {}
+        uint len() const { return _len; }
+        bool overflow() const { return _overflow; }
+        void put_bytes(const void *data, uint size)
+        {
+            if ((_len + size) > _size) {
+                _overflow = true;
+                return;
+            }
+            std::memcpy(_buf + _len, data, size);
+            _len += size;
+        }
+        void put_uint(uint32_t value) { put_bytes(&value, sizeof(value)); }
+        void put_bool(bool value) { uint8_t b = value; put_bytes(&b, sizeof(b)); }
+        void put_str(const char *str)
+        {
+            // Strings are sent as a length followed by the characters (no terminator)
+            uint8_t str_len = ::strnlen(str, (STD_STR_LEN - 1));
+            put_bytes(&str_len, sizeof(str_len));
+            put_bytes(str, str_len);
+        }
+        void put_flags(const bool *flags, uint num_flags)
+        {
+            // Flags are packed into bits
+            uint8_t bits[GUI_MSG_LIST_FLAGS_SIZE] = {};
+            for (uint i=0; i<num_flags; i++) {
+                if (flags[i])
+                    bits[i / 8] |= (1 << (i % 8));
+            }
+            put_bytes(bits, (num_flags + 7) / 8);
+        }
+
+    private:
+        uint8_t *_buf;
+        uint _size;
+        uint _len;
+        bool _overflow;
+    };
+
+    // Payload reader
+    class _Reader
+    {
+    public:
+        _Reader(const uint8_t *buf, uint len) : _buf(buf), _len(len), _pos(0), _underflow(false) {}
+        uint remaining() const { return _len - _pos; }
+        bool underflow() const { return _underflow; }
+        void get_bytes(void *data, uint size)
+        {
+            if (size > remaining()) {
+                _underflow = true;
+                _pos = _len;
+                std::memset(data, 0, size);
+                return;
+            }
+            std::memcpy(data, _buf + _pos, size);
+            _pos += size;
+        }
+        uint32_t get_uint() { uint32_t value; get_bytes(&value, sizeof(value)); return value; }
+        bool get_bool() { uint8_t b; get_bytes(&b, sizeof(b)); return b != 0; }
+        void get_str(char *str)
+        {
+            // Read the string and always NULL terminate it
+            uint8_t str_len;
+            get_bytes(&str_len, sizeof(str_len));
+            if (str_len > (STD_STR_LEN - 1)) {
+                _underflow = true;
+                str_len = 0;
+            }
+            get_bytes(str, str_len);
+            str[str_len] = 0;
+        }
+        void get_flags(bool *flags, uint num_flags)
+        {
+            uint8_t bits[GUI_MSG_LIST_FLAGS_SIZE];
+            get_bytes(bits, (num_flags + 7) / 8);
+            for (uint i=0; i<num_flags; i++) {
+                flags[i] = (bits[i / 8] & (1 << (i % 8))) != 0;
+            }
+        }
+        uint get_num_items()
+        {
+            // Get the number of list items and check it is valid
+            uint num_items = get_uint();
+            if (num_items > LIST_MAX_ITEMS) {
+                _underflow = true;
+                num_items = 0;
+            }
+            return num_items;
+        }
+
+    private:
+        const uint8_t *_buf;
+        uint _len;
+        uint _pos;
+        bool _underflow;
+    };
+
+    //----------------------------------------------------------------------------
+    // _payload_size
+    //----------------------------------------------------------------------------
+    template<typename T>
+    static constexpr uint _payload_size()
+    {
+        // A message with no payload has an empty payload struct
+        return std::is_empty<T>::value ? 0 : sizeof(T);
+    }
+
+    //----------------------------------------------------------------------------
+    // _encode_payload
+    //----------------------------------------------------------------------------
+    template<typename T>
+    static void _encode_payload(const T& payload, _Writer& writer)
+    {
+        // Fixed size message, send the payload struct as is
+        writer.put_bytes(&payload, _payload_size<T>());
+    }
+
+    //----------------------------------------------------------------------------
+    // _decode_payload
+    //----------------------------------------------------------------------------
+    template<typename T>
+    static void _decode_payload(_Reader& reader, T& payload)
+    {
+        // Fixed size message, the payload must be the exact struct size (this is
+        // checked once the payload is decoded)
+        reader.get_bytes(&payload, _payload_size<T>());
+    }
+
+    //----------------------------------------------------------------------------
+    // _encode_payload (list items)
+    //----------------------------------------------------------------------------
+    static void _encode_payload(const ListItems& list_items, _Writer& writer)
+    {
+        uint num_items = (list_items.num_items < LIST_MAX_ITEMS) ? list_items.num_items : LIST_MAX_ITEMS;
+
+        // Encode the list and only the items used
+        writer.put_uint(num_items);
+        writer.put_uint(list_items.selected_item);
+        writer.put_bool(list_items.process_enabled_state);
+        for (uint i=0; i<num_items; i++) {
+            writer.put_str(list_items.items[i]);
+        }
+        writer.put_flags(list_items.list_item_enabled, num_items);
+    }
+
+    //----------------------------------------------------------------------------
+    // _decode_payload (list items)
+    //----------------------------------------------------------------------------
+    static void _decode_payload(_Reader& reader, ListItems& list_items)
+    {
+        // Decode the list
+        list_items.num_items = reader.get_num_items();
+        list_items.selected_item = reader.get_uint();
+        list_items.process_enabled_state = reader.get_bool();
+        for (uint i=0; i<list_items.num_items; i++) {
+            reader.get_str(list_items.items[i]);
+        }
+        reader.get_flags(list_items.list_item_enabled, list_items.num_items);
+    }
+
+    //----------------------------------------------------------------------------
+    // _encode_payload (param update)
+    //----------------------------------------------------------------------------
+    static void _encode_payload(const ParamUpdate& param_update, _Writer& writer)
+    {
+        uint num_items = (param_update.num_items < LIST_MAX_ITEMS) ? param_update.num_items : LIST_MAX_ITEMS;
+
+        // Encode the param and only the list items used
+        writer.put_str(param_update.name);
+        writer.put_str(param_update.value_string);
+        writer.put_str(param_update.display_string);
+        writer.put_str(param_update.value_tag);
+        writer.put_uint(num_items);
+        writer.put_uint(param_update.selected_item);
+        writer.put_bool(param_update.show_scope);
+        for (uint i=0; i<num_items; i++) {
+            writer.put_str(param_update.list_items[i]);
+        }
+        writer.put_flags(param_update.list_item_enabled, num_items);
+        writer.put_flags(param_update.list_item_separator, num_items);
+    }
+
+    //----------------------------------------------------------------------------
+    // _decode_payload (param update)
+    //----------------------------------------------------------------------------
+    static void _decode_payload(_Reader& reader, ParamUpdate& param_update)
+    {
+        // Decode the param
+        reader.get_str(param_update.name);
+        reader.get_str(param_update.value_string);
+        reader.get_str(param_update.display_string);
+        reader.get_str(param_update.value_tag);
+        param_update.num_items = reader.get_num_items();
+        param_update.selected_item = reader.get_uint();
+        param_update.show_scope = reader.get_bool();
+        for (uint i=0; i<param_update.num_items; i++) {
+            reader.get_str(param_update.list_items[i]);
+        }
+        reader.get_flags(param_update.list_item_enabled, param_update.num_items);
+        reader.get_flags(param_update.list_item_separator, param_update.num_items);
+    }
+
+    //----------------------------------------------------------------------------
+    // _encode_payload (enum param update)
+    //----------------------------------------------------------------------------
+    static void _encode_payload(const EnumParamUpdate& enum_param_update, _Writer& writer)
+    {
+        uint num_items = (enum_param_update.num_items < LIST_MAX_ITEMS) ? enum_param_update.num_items : LIST_MAX_ITEMS;
+
+        // Encode the enum param and only the list items used
+        writer.put_str(enum_param_update.name);
+        writer.put_uint(num_items);
+        writer.put_uint(enum_param_update.selected_item);
+        writer.put_bool(enum_param_update.wt_list);
+        for (uint i=0; i<num_items; i++) {
+            writer.put_str(enum_param_update.list_items[i]);
+        }
+    }
+
+    //----------------------------------------------------------------------------
+    // _decode_payload (enum param update)
+    //----------------------------------------------------------------------------
+    static void _decode_payload(_Reader& reader, EnumParamUpdate& enum_param_update)
+    {
+        // Decode the enum param
+        reader.get_str(enum_param_update.name);
+        enum_param_update.num_items = reader.get_num_items();
+        enum_param_update.selected_item = reader.get_uint();
+        enum_param_update.wt_list = reader.get_bool();
+        for (uint i=0; i<enum_param_update.num_items; i++) {
+            reader.get_str(enum_param_update.list_items[i]);
+        }
+    }
+
+    //----------------------------------------------------------------------------
+    // _encode_payload (intern string)
+    //----------------------------------------------------------------------------
+    static void _encode_payload(const InternString& intern_string, _Writer& writer)
+    {
+        writer.put_uint(intern_string.id);
+        writer.put_str(intern_string.str);
+    }
+
+    //----------------------------------------------------------------------------
+    // _decode_payload (intern string)
+    //----------------------------------------------------------------------------
+    static void _decode_payload(_Reader& reader, InternString& intern_string)
+    {
+        intern_string.id = reader.get_uint();
+        reader.get_str(intern_string.str);
+    }
+};
+
+#endif  // GUI_MSG_CODEC_H
@@ -0,0 +1,268 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  gui_msg_latency.cpp
+ * @brief GUI Message Latency class implementation.
+ *-----------------------------------------------------------------------------
+ */
+#include <ctime>
+#include <iomanip>
+#include "gui_msg_latency.h"
+#include "gui_msg_coalescer.h"
+
+//----------------------------------------------------------------------------
+// LatencyHistogram
+//----------------------------------------------------------------------------
+LatencyHistogram::LatencyHistogram()
+{
+    // Initialise class variables
+    std::memset(_buckets, 0, sizeof(_buckets));
+    _count = 0;
+    _sum = 0;
+    _max = 0;
+}
+
+//----------------------------------------------------------------------------
+// record
+//----------------------------------------------------------------------------
+void LatencyHistogram::record(uint64_t value_us)
+{
+    _buckets[_bucket_index(value_us)]++;
+    _count++;
+    _sum += value_us;
+    if (value_us > _max)
+        _max = value_us;
+}
+
+//----------------------------------------------------------------------------
+// count
+//----------------------------------------------------------------------------
+uint64_t LatencyHistogram::count() const
+{
+    return _count;
+}
+
+//----------------------------------------------------------------------------
+// max
+//----------------------------------------------------------------------------
+uint64_t LatencyHistogram::max() const
+{
+    return _max;
+}
+
+//----------------------------------------------------------------------------
+// mean
+//----------------------------------------------------------------------------
+uint64_t LatencyHistogram::mean() const
+{
+    return _count ? (_sum / _count) : 0;
+}
+
+//----------------------------------------------------------------------------
+// percentile
+//----------------------------------------------------------------------------
+uint64_t LatencyHistogram::percentile(float percentile) const
+{
+    // Find the bucket containing the percentile, and return the highest value
+    // in that bucket (limited to the max recorded value, which is also used for
+    // the overflow bucket)
+    uint64_t target = (uint64_t)((percentile / 100.0f) * _count + 0.5f);
+    if (target == 0)
+        target = 1;
+    uint64_t total = 0;
+    for (uint i=0; i<LATENCY_HISTOGRAM_NUM_BUCKETS; i++) {
+        total += _buckets[i];
+        if (total >= target) {
+            uint64_t value = _bucket_value(i);
+            return ((value < _max) && (i < (LATENCY_HISTOGRAM_NUM_BUCKETS - 1))) ? value : _max;
+        }
+    }
+    return _max;
+}
+
+//----------------------------------------------------------------------------
+// _bucket_index
+//----------------------------------------------------------------------------
+uint LatencyHistogram::_bucket_index(uint64_t value_us)
+{
+    // Values below the number of sub-buckets have a bucket each
+    if (value_us < LATENCY_HISTOGRAM_SUB_BUCKETS)
+        return value_us;
+
+    // Otherwise the bucket is found from the power of 2 range (shift) and the
+    // top bits of the value within that range
+    uint shift = (63 - __builtin_clzll(value_us)) - 3;
+    if (shift > LATENCY_HISTOGRAM_MAX_SHIFT)
+        return LATENCY_HISTOGRAM_NUM_BUCKETS - 1;
+    uint top = value_us >> shift;
+    return LATENCY_HISTOGRAM_SUB_BUCKETS + ((shift - 1) * (LATENCY_HISTOGRAM_SUB_BUCKETS / 2)) +
+           (top - (LATENCY_HISTOGRAM_SUB_BUCKETS / 2));
+}
+
+//----------------------------------------------------------------------------
+// _bucket_value
+//----------------------------------------------------------------------------
+uint64_t LatencyHistogram::_bucket_value(uint index)
+{
+    // Return the highest value in the bucket
+    if (index < LATENCY_HISTOGRAM_SUB_BUCKETS)
+        return index;
+    index -= LATENCY_HISTOGRAM_SUB_BUCKETS;
+    uint shift = (index / (LATENCY_HISTOGRAM_SUB_BUCKETS / 2)) + 1;
+    uint64_t top = (index % (LATENCY_HISTOGRAM_SUB_BUCKETS / 2)) + (LATENCY_HISTOGRAM_SUB_BUCKETS / 2);
+    return ((top + 1) << shift) - 1;
+}
+
+//----------------------------------------------------------------------------
+// GuiMsgLatency
+//----------------------------------------------------------------------------
+GuiMsgLatency::GuiMsgLatency()
+{
+    // Initialise class variables
+    _pending.reserve(GUI_MSG_LATENCY_MAX_PENDING);
+    std::memset(_max_seq, 0, sizeof(_max_seq));
+    _num_dropped = 0;
+    _num_not_presented = 0;
+}
+
+//----------------------------------------------------------------------------
+// applied
+// Called when a traced message has been applied to the GUI objects
+//----------------------------------------------------------------------------
+void GuiMsgLatency::applied(const GuiMsgTiming& timing)
+{
+    // Hold the message until it is presented - if too many messages are
+    // pending (the GUI is not being presented) the message is dropped
+    // Any messages that have been pending too long are not presented
+    _expire_pending(timing.applied);
+    if (_pending.size() < GUI_MSG_LATENCY_MAX_PENDING)
+        _pending.push_back(timing);
+    else
+        _num_dropped++;
+}
+
+//----------------------------------------------------------------------------
+// presented
+// Called after each frame swap
+//----------------------------------------------------------------------------
+void GuiMsgLatency::presented()
+{
+    // Any pending messages have now been presented (unless they have been
+    // pending too long), so record the latency of each stage
+    if (_pending.empty())
+        return;
+    uint64_t presented = now();
+    _expire_pending(presented);
+    for (const GuiMsgTiming& timing : _pending)
+        _record(timing, presented);
+    _pending.clear();
+}
+
+//----------------------------------------------------------------------------
+// print_stats
+//----------------------------------------------------------------------------
+void GuiMsgLatency::print_stats() const
+{
+    // Show the latency of each stage for each traced message source (us)
+    // Note: The apply stage is recorded for every traced message, presented or not
+    for (uint i=0; i<GUI_MSG_LATENCY_NUM_SOURCES; i++) {
+        auto histograms = _histograms[i];
+        if (histograms[GuiMsgLatencyStage::STAGE_APPLY].count() == 0)
+            continue;
+        MSG("GuiMsgLatency: " << _source_name(i) << ": " << histograms[GuiMsgLatencyStage::STAGE_APPLY].count() <<
+            " traced, " << histograms[GuiMsgLatencyStage::STAGE_TOTAL].count() << " presented, max seq: " << _max_seq[i]);
+        for (uint j=0; j<NUM_LATENCY_STAGES; j++) {
+            auto& h = histograms[j];
+            MSG("GuiMsgLatency:   " << std::left << std::setw(8) << _stage_name(j) << std::right <<
+                " mean: " << std::setw(7) << h.mean() << " p50: " << std::setw(7) << h.percentile(50.0f) <<
+                " p90: " << std::setw(7) << h.percentile(90.0f) << " p99: " << std::setw(7) << h.percentile(99.0f) <<
+                " max: " << std::setw(7) << h.max() << " us");
+        }
+    }
+    if (_num_dropped)
+        MSG("GuiMsgLatency: dropped (not presented): " << _num_dropped);
+    if (_num_not_presented)
+        MSG("GuiMsgLatency: not presented (no repaint): " << _num_not_presented);
+}
+
+//----------------------------------------------------------------------------
+// now
+//----------------------------------------------------------------------------
+uint64_t GuiMsgLatency::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+//----------------------------------------------------------------------------
+// _expire_pending
+// Records the pending messages that have been pending too long as not
+// presented - they caused no repaint, so the wait for an unrelated repaint is
+// not charged to the present stage
+//----------------------------------------------------------------------------
+void GuiMsgLatency::_expire_pending(uint64_t now)
+{
+    // The messages are pending in the order applied, so the expired messages
+    // are at the front
+    uint num_expired = 0;
+    while ((num_expired < _pending.size()) &&
+           (((now - _pending[num_expired].applied) / 1000) > GUI_MSG_LATENCY_PRESENT_TIMEOUT_US)) {
+        _record(_pending[num_expired], 0);
+        num_expired++;
+    }
+    if (num_expired) {
+        _pending.erase(_pending.begin(), (_pending.begin() + num_expired));
+        _num_not_presented += num_expired;
+    }
+}
+
+//----------------------------------------------------------------------------
+// _record
+// Records the latency of each stage of a message, the present stage (and
+// total) only if presented (non-zero)
+//----------------------------------------------------------------------------
+void GuiMsgLatency::_record(const GuiMsgTiming& timing, uint64_t presented)
+{
+    auto histograms = _histograms[timing.source];
+    histograms[GuiMsgLatencyStage::STAGE_QUEUE].record((timing.received - timing.sent) / 1000);
+    histograms[GuiMsgLatencyStage::STAGE_DISPATCH].record((timing.dispatched - timing.received) / 1000);
+    histograms[GuiMsgLatencyStage::STAGE_DELIVER].record((timing.started - timing.dispatched) / 1000);
+    histograms[GuiMsgLatencyStage::STAGE_APPLY].record((timing.applied - timing.started) / 1000);
+    if (presented) {
+        auto& total = histograms[GuiMsgLatencyStage::STAGE_TOTAL];
+        uint64_t total_us = (presented - timing.sent) / 1000;
+        if (total_us >= total.max())
+            _max_seq[timing.source] = timing.seq;
+        histograms[GuiMsgLatencyStage::STAGE_PRESENT].record((presented - timing.applied) / 1000);
+        total.record(total_us);
+    }
+}
+
+//----------------------------------------------------------------------------
+// _source_name
+//----------------------------------------------------------------------------
+const char *GuiMsgLatency::_source_name(uint source)
+{
+    if (source == GUI_MSG_LATENCY_SCOPE_SAMPLES)
+        return "SCOPE_SAMPLES";
+    return GuiMsgCoalescer::type_name(static_cast<GuiMsgType>(source));
+}
+
+//----------------------------------------------------------------------------
+// _stage_name
+//----------------------------------------------------------------------------
+const char *GuiMsgLatency::_stage_name(uint stage)
+{
+    switch (stage)
+    {
+        case GuiMsgLatencyStage::STAGE_QUEUE:       return "queue";
+        case GuiMsgLatencyStage::STAGE_DISPATCH:    return "dispatch";
+        case GuiMsgLatencyStage::STAGE_DELIVER:     return "deliver";
+        case GuiMsgLatencyStage::STAGE_APPLY:       return "apply";
+        case GuiMsgLatencyStage::STAGE_PRESENT:     return "present";
+        case GuiMsgLatencyStage::STAGE_TOTAL:       return "total";
+        default:                                    return "unknown";
+    }
+}
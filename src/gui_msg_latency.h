@@ -0,0 +1,118 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  gui_msg_latency.h
+ * @brief GUI Message Latency class definitions.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef GUI_MSG_LATENCY_H
+#define GUI_MSG_LATENCY_H
+
+#include <vector>
+#include "common.h"
+
+// Constants
+constexpr uint LATENCY_HISTOGRAM_SUB_BUCKETS = 16;
+constexpr uint LATENCY_HISTOGRAM_MAX_SHIFT   = 22;      // Max ~67 s
+constexpr uint LATENCY_HISTOGRAM_NUM_BUCKETS = (LATENCY_HISTOGRAM_SUB_BUCKETS +
+                                                (LATENCY_HISTOGRAM_MAX_SHIFT * (LATENCY_HISTOGRAM_SUB_BUCKETS / 2)));
+constexpr uint GUI_MSG_LATENCY_SCOPE_SAMPLES = NUM_GUI_MSG_TYPES;
+constexpr uint GUI_MSG_LATENCY_NUM_SOURCES   = (NUM_GUI_MSG_TYPES + 1);
+constexpr uint GUI_MSG_LATENCY_MAX_PENDING   = 256;
+constexpr uint GUI_MSG_LATENCY_PRESENT_TIMEOUT_US = 100000;
+
+// GUI message latency stage
+enum GuiMsgLatencyStage : int
+{
+    STAGE_QUEUE = 0,        // Sent -> received by the message thread
+    STAGE_DISPATCH,         // Received -> dispatched to the GUI thread
+    STAGE_DELIVER,          // Dispatched -> started in the GUI thread
+    STAGE_APPLY,            // Started -> applied to the GUI objects
+    STAGE_PRESENT,          // Applied -> presented (after the frame swap)
+    STAGE_TOTAL             // Sent -> presented
+};
+constexpr uint NUM_LATENCY_STAGES = (GuiMsgLatencyStage::STAGE_TOTAL + 1);
+
+// GUI message timing
+// The time (ns, CLOCK_MONOTONIC) of each stage of a traced message
+struct GuiMsgTiming
+{
+    bool traced;
+    bool ack;
+    GuiMsgLane lane;
+    uint source;
+    uint32_t seq;
+    uint64_t sent;
+    uint64_t received;
+    uint64_t dispatched;
+    uint64_t started;
+    uint64_t applied;
+};
+
+// Latency Histogram class
+// Log-linear (HDR-style) histogram of latencies in microseconds - each power
+// of 2 range is split into 8 linear sub-buckets, so any latency is recorded to
+// within 12.5%
+class LatencyHistogram
+{
+public:
+    // Constructor
+    LatencyHistogram();
+
+    // Public functions
+    void record(uint64_t value_us);
+    uint64_t count() const;
+    uint64_t max() const;
+    uint64_t mean() const;
+    uint64_t percentile(float percentile) const;
+
+private:
+    // Private data
+    uint32_t _buckets[LATENCY_HISTOGRAM_NUM_BUCKETS];
+    uint64_t _count;
+    uint64_t _sum;
+    uint64_t _max;
+
+    // Private functions
+    static uint _bucket_index(uint64_t value_us);
+    static uint64_t _bucket_value(uint index);
+};
+
+// GUI Message Latency class
+// Collects the latency of each stage of the traced GUI and scope messages.
+// Messages are held as pending once applied, until the next frame swap. If a
+// message caused no repaint, it is not presented until some later repaint - so
+// messages pending for longer than the present timeout are instead counted as
+// not presented, and their present (and total) latency is not recorded
+// Note: Only accessed from the GUI thread
+class GuiMsgLatency
+{
+public:
+    // Constructor
+    GuiMsgLatency();
+
+    // Public functions
+    void applied(const GuiMsgTiming& timing);
+    void presented();
+    void print_stats() const;
+
+    // Helper functions
+    static uint64_t now();
+
+private:
+    // Private data
+    LatencyHistogram _histograms[GUI_MSG_LATENCY_NUM_SOURCES][NUM_LATENCY_STAGES];
+    std::vector<GuiMsgTiming> _pending;
+    uint32_t _max_seq[GUI_MSG_LATENCY_NUM_SOURCES];
+    uint64_t _num_dropped;
+    uint64_t _num_not_presented;
+
+    // Private functions
+    void _expire_pending(uint64_t now);
+    void _record(const GuiMsgTiming& timing, uint64_t presented);
+    static const char *_source_name(uint source);
+    static const char *_stage_name(uint stage);
+};
+
+#endif  // GUI_MSG_LATENCY_H
@@ -0,0 +1,222 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  gui_msg_pool.cpp
+ * @brief GUI Message Pool class implementation.
+ *-----------------------------------------------------------------------------
+ */
+#include "gui_msg_pool.h"
+
+//----------------------------------------------------------------------------
+// GuiMsgHandle
+//----------------------------------------------------------------------------
+GuiMsgHandle::GuiMsgHandle() :
+    _pool(nullptr),
+    _index(0)
+{
+}
+
+//----------------------------------------------------------------------------
+// GuiMsgHandle
+//----------------------------------------------------------------------------
+GuiMsgHandle::GuiMsgHandle(GuiMsgPool *pool, uint index) :
+    _pool(pool),
+    _index(index)
+{
+    // Note: The pool sets the initial reference count
+}
+
+//----------------------------------------------------------------------------
+// GuiMsgHandle
+//----------------------------------------------------------------------------
+GuiMsgHandle::GuiMsgHandle(const GuiMsgHandle& handle) :
+    _pool(handle._pool),
+    _index(handle._index)
+{
+    // Add a reference to the message
+    if (_pool)
+        _pool->_add_ref(_index);
+}
+
+//----------------------------------------------------------------------------
+// GuiMsgHandle
+//----------------------------------------------------------------------------
+GuiMsgHandle::GuiMsgHandle(GuiMsgHandle&& handle) :
+    _pool(handle._pool),
+    _index(handle._index)
+{
+    // Take the reference from the other handle
+    handle._pool = nullptr;
+}
+
+//----------------------------------------------------------------------------
+// ~GuiMsgHandle
+//----------------------------------------------------------------------------
+GuiMsgHandle::~GuiMsgHandle()
+{
+    // Release the reference to the message
+    release();
+}
+
+//----------------------------------------------------------------------------
+// operator=
+//----------------------------------------------------------------------------
+GuiMsgHandle& GuiMsgHandle::operator=(const GuiMsgHandle& handle)
+{
+    // Add the new reference before releasing the current one, in case they
+    // are the same message
+    if (handle._pool)
+        handle._pool->_add_ref(handle._index);
+    release();
+    _pool = handle._pool;
+    _index = handle._index;
+    return *this;
+}
+
+//----------------------------------------------------------------------------
+// operator=
+//----------------------------------------------------------------------------
+GuiMsgHandle& GuiMsgHandle::operator=(GuiMsgHandle&& handle)
+{
+    // Release the current reference and take the reference from the other handle
+    if (this != &handle) {
+        release();
+        _pool = handle._pool;
+        _index = handle._index;
+        handle._pool = nullptr;
+    }
+    return *this;
+}
+
+//----------------------------------------------------------------------------
+// is_valid
+//----------------------------------------------------------------------------
+bool GuiMsgHandle::is_valid() const
+{
+    return _pool != nullptr;
+}
+
+//----------------------------------------------------------------------------
+// release
+//----------------------------------------------------------------------------
+void GuiMsgHandle::release()
+{
+    // Release the reference to the message, if any
+    if (_pool) {
+        _pool->_release(_index);
+        _pool = nullptr;
+    }
+}
+
+//----------------------------------------------------------------------------
+// get
+//----------------------------------------------------------------------------
+GuiMsg *GuiMsgHandle::get() const
+{
+    return _pool ? &_pool->_msgs[_index] : nullptr;
+}
+
+//----------------------------------------------------------------------------
+// timing
+//----------------------------------------------------------------------------
+GuiMsgTiming *GuiMsgHandle::timing() const
+{
+    return _pool ? &_pool->_timings[_index] : nullptr;
+}
+
+//----------------------------------------------------------------------------
+// GuiMsgPool
+//----------------------------------------------------------------------------
+GuiMsgPool::GuiMsgPool(uint num_msgs) :
+    _msgs(num_msgs),
+    _timings(num_msgs),
+    _ref_counts(new std::atomic<uint>[num_msgs])
+{
+    // Initialise class variables
+    _free_list.reserve(num_msgs);
+    for (uint i=0; i<num_msgs; i++) {
+        _ref_counts[i] = 0;
+        _free_list.push_back((num_msgs - 1) - i);
+    }
+    _cancelled = false;
+    _min_free = num_msgs;
+    _num_waits = 0;
+}
+
+//----------------------------------------------------------------------------
+// acquire
+//----------------------------------------------------------------------------
+GuiMsgHandle GuiMsgPool::acquire()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // If the pool is empty, wait for a message to be released - this only
+    // happens if the GUI thread falls well behind
+    if (_free_list.empty() && !_cancelled) {
+        _num_waits++;
+        _cv.wait(lock, [this]() { return !_free_list.empty() || _cancelled; });
+    }
+    if (_cancelled)
+        return GuiMsgHandle();
+
+    // Get the next free message
+    uint index = _free_list.back();
+    _free_list.pop_back();
+    if (_free_list.size() < _min_free)
+        _min_free = _free_list.size();
+    _ref_counts[index].store(1, std::memory_order_relaxed);
+    _timings[index].traced = false;
+    return GuiMsgHandle(this, index);
+}
+
+//----------------------------------------------------------------------------
+// cancel
+//----------------------------------------------------------------------------
+void GuiMsgPool::cancel()
+{
+    // Cancel any current or future acquire - this is called when stopping
+    // the thread that acquires messages
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cancelled = true;
+    _cv.notify_all();
+}
+
+//----------------------------------------------------------------------------
+// num_free
+//----------------------------------------------------------------------------
+uint GuiMsgPool::num_free()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _free_list.size();
+}
+
+//----------------------------------------------------------------------------
+// print_stats
+//----------------------------------------------------------------------------
+void GuiMsgPool::print_stats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    MSG("GuiMsgPool: max in use: " << (_msgs.size() - _min_free) << "/" << _msgs.size() << ", waits: " << _num_waits);
+}
+
+//----------------------------------------------------------------------------
+// _add_ref
+//----------------------------------------------------------------------------
+void GuiMsgPool::_add_ref(uint index)
+{
+    _ref_counts[index].fetch_add(1, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// _release
+//----------------------------------------------------------------------------
+void GuiMsgPool::_release(uint index)
+{
+    // If this is the last reference, return the message to the pool
+    if (_ref_counts[index].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free_list.push_back(index);
+        _cv.notify_one();
+    }
+}
@@ -0,0 +1,95 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  gui_msg_pool.h
+ * @brief GUI Message Pool class definitions.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef GUI_MSG_POOL_H
+#define GUI_MSG_POOL_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <vector>
+#include "common.h"
+#include "gui_msg_latency.h"
+
+// Constants
+constexpr uint GUI_MSG_POOL_SIZE = 160;
+
+class GuiMsgPool;
+
+// GUI Message Handle class
+// Reference counted handle to a GUI message in the pool. The message is
+// returned to the pool when the last handle to it is released. Copying a handle
+// only copies the reference, so handles can be passed in queued signals
+// without copying the message
+class GuiMsgHandle
+{
+public:
+    // Constructors/destructor
+    GuiMsgHandle();
+    GuiMsgHandle(const GuiMsgHandle& handle);
+    GuiMsgHandle(GuiMsgHandle&& handle);
+    ~GuiMsgHandle();
+    GuiMsgHandle& operator=(const GuiMsgHandle& handle);
+    GuiMsgHandle& operator=(GuiMsgHandle&& handle);
+
+    // Public functions
+    bool is_valid() const;
+    void release();
+    GuiMsg *get() const;
+    GuiMsgTiming *timing() const;
+    const GuiMsg& operator*() const { return *get(); }
+    const GuiMsg *operator->() const { return get(); }
+
+private:
+    friend class GuiMsgPool;
+
+    // Private data
+    GuiMsgPool *_pool;
+    uint _index;
+
+    // Private functions
+    GuiMsgHandle(GuiMsgPool *pool, uint index);
+};
+Q_DECLARE_METATYPE(GuiMsgHandle);
+
+// GUI Message Pool class
+// Fixed pool of GUI messages, allocated once at startup, so that no messages
+// are allocated in steady state
+class GuiMsgPool
+{
+public:
+    // Constructor
+    GuiMsgPool(uint num_msgs=GUI_MSG_POOL_SIZE);
+
+    // Public functions
+    GuiMsgHandle acquire();
+    void cancel();
+    uint num_free();
+    void print_stats();
+
+private:
+    friend class GuiMsgHandle;
+
+    // Private data
+    std::vector<GuiMsg> _msgs;
+    std::vector<GuiMsgTiming> _timings;
+    std::unique_ptr<std::atomic<uint>[]> _ref_counts;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::vector<uint> _free_list;
+    bool _cancelled;
+    uint _min_free;
+    uint _num_waits;
+
+    // Private functions
+    void _add_ref(uint index);
+    void _release(uint index);
+};
+
+#endif  // GUI_MSG_POOL_H
@@ -0,0 +1,405 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  gui_msg_ring.h
+ * @brief GUI Message Ring class definitions and implementation.
+ *
+ * Lock-free single-producer/single-consumer ring of GUI message frames in a
+ * shared memory segment. The consumer (Nina GUI) creates the segment, and the
+ * producer (Nina UI app) attaches to it. A futex in the segment is used as the
+ * doorbell to wake the consumer, and is only rung when the consumer is
+ * waiting. The consumer PID is set in the segment, so the producer can check
+ * the consumer is still running (e.g. the Nina GUI has not crashed), and the
+ * consumer unlinks the segment when it exits cleanly.
+ * Note: The ring is shared with the Nina UI app (the message producer), and
+ * is therefore implemented in this header.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef GUI_MSG_RING_H
+#define GUI_MSG_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "common.h"
+
+// Constants
+constexpr uint32_t GUI_MSG_RING_MAGIC      = 0x474E4952;    // "RING"
+constexpr uint32_t GUI_MSG_RING_VERSION    = 2;
+constexpr uint32_t GUI_MSG_RING_WRAP       = 0xFFFFFFFF;
+constexpr uint GUI_MSG_RING_RECORD_ALIGN   = 8;
+
+// GUI Message Ring shared memory header
+// The consumer PID is 0 if there is no consumer
+struct GuiMsgRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    std::atomic<int32_t> consumer_pid;
+    alignas(64) std::atomic<uint32_t> write_pos;
+    std::atomic<uint32_t> high_water;
+    alignas(64) std::atomic<uint32_t> read_pos;
+    std::atomic<uint32_t> consumer_waiting;
+    std::atomic<uint32_t> doorbell;
+};
+static_assert(std::atomic<int32_t>::is_always_lock_free, "The ring consumer PID must be lock-free");
+
+// GUI Message Ring class
+class GuiMsgRing
+{
+public:
+    //----------------------------------------------------------------------------
+    // GuiMsgRing
+    //----------------------------------------------------------------------------
+    GuiMsgRing()
+    {
+        // Initialise class variables
+        _header = nullptr;
+        _data = nullptr;
+        _map_size = 0;
+        _front_size = 0;
+    }
+
+    //----------------------------------------------------------------------------
+    // ~GuiMsgRing
+    //----------------------------------------------------------------------------
+    ~GuiMsgRing()
+    {
+        // Make sure the ring is closed
+        close();
+    }
+
+    //----------------------------------------------------------------------------
+    // create
+    // Called by the consumer to create (or re-use) the ring, size must be a
+    // power of 2
+    //----------------------------------------------------------------------------
+    bool create(const char *name, uint32_t size)
+    {
+        // Check the size is a power of 2
+        if ((size == 0) || (size & (size - 1)))
+            return false;
+
+        // Open the shared memory segment (create if it doesn't exist) and map it
+        int fd = ::shm_open(name, (O_CREAT|O_RDWR), (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH));
+        if (fd == -1)
+            return false;
+        _map_size = sizeof(GuiMsgRingHeader) + size;
+        if ((::ftruncate(fd, _map_size) == -1) || !_map(fd)) {
+            ::close(fd);
+            return false;
+        }
+        ::close(fd);
+
+        // If the ring is not valid (new, or a different layout) then initialise it,
+        // otherwise discard anything left from a previous consumer
+        if ((_header->magic != GUI_MSG_RING_MAGIC) || (_header->version != GUI_MSG_RING_VERSION) ||
+            (_header->size != size)) {
+            _header->magic = 0;
+            _header->version = GUI_MSG_RING_VERSION;
+            _header->size = size;
+            _header->write_pos = 0;
+            _header->high_water = 0;
+            _header->read_pos = 0;
+            _header->consumer_waiting = 0;
+            _header->doorbell = 0;
+            std::atomic_thread_fence(std::memory_order_release);
+            _header->magic = GUI_MSG_RING_MAGIC;
+        }
+        else {
+            _header->read_pos.store(_header->write_pos.load());
+        }
+
+        // Set this process as the consumer
+        _header->consumer_pid.store(::getpid(), std::memory_order_release);
+        return true;
+    }
+
+    //----------------------------------------------------------------------------
+    // destroy
+    // Called by the consumer when it exits cleanly - the segment is unlinked,
+    // so an attached producer sees there is no consumer
+    //----------------------------------------------------------------------------
+    void destroy(const char *name)
+    {
+        if (_header) {
+            _header->consumer_pid.store(0, std::memory_order_release);
+            close();
+            ::shm_unlink(name);
+        }
+    }
+
+    //----------------------------------------------------------------------------
+    // open
+    // Called by the producer to attach to an existing ring
+    //----------------------------------------------------------------------------
+    bool open(const char *name)
+    {
+        struct stat st;
+
+        // Open the shared memory segment, it must already exist
+        int fd = ::shm_open(name, O_RDWR, 0);
+        if (fd == -1)
+            return false;
+        if ((::fstat(fd, &st) == -1) || (st.st_size <= (off_t)sizeof(GuiMsgRingHeader))) {
+            ::close(fd);
+            return false;
+        }
+        _map_size = st.st_size;
+        if (!_map(fd)) {
+            ::close(fd);
+            return false;
+        }
+        ::close(fd);
+
+        // Check the ring is valid, and its consumer is running - if not, the
+        // segment was left by a consumer that has crashed
+        if ((_header->magic != GUI_MSG_RING_MAGIC) || (_header->version != GUI_MSG_RING_VERSION) ||
+            ((sizeof(GuiMsgRingHeader) + _header->size) != _map_size) || !consumer_alive()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    //----------------------------------------------------------------------------
+    // consumer_alive
+    // Producer only - returns true if the consumer process is still running
+    //----------------------------------------------------------------------------
+    bool consumer_alive() const
+    {
+        // Check the process exists (it may exist but not be signalable by this
+        // process)
+        pid_t pid = _header->consumer_pid.load(std::memory_order_acquire);
+        return (pid > 0) && ((::kill(pid, 0) == 0) || (errno == EPERM));
+    }
+
+    //----------------------------------------------------------------------------
+    // close
+    //----------------------------------------------------------------------------
+    void close()
+    {
+        // Unmap the ring if mapped
+        if (_header) {
+            ::munmap(_header, _map_size);
+            _header = nullptr;
+            _data = nullptr;
+        }
+    }
+
+    //----------------------------------------------------------------------------
+    // is_open
+    //----------------------------------------------------------------------------
+    bool is_open() const
+    {
+        return _header != nullptr;
+    }
+
+    //----------------------------------------------------------------------------
+    // push
+    // Producer only - returns false if the ring is full. If notify is false the
+    // consumer is not woken, and notify() must be called once the frames
+    // have been pushed
+    //----------------------------------------------------------------------------
+    bool push(const uint8_t *frame, uint32_t len, bool notify=true)
+    {
+        uint32_t size = _header->size;
+        uint32_t record_size = _record_size(len);
+        if (record_size > (size / 2))
+            return false;
+
+        // Check there is room for the record, and any padding needed to wrap it
+        // to the start of the ring
+        uint32_t write_pos = _header->write_pos.load(std::memory_order_relaxed);
+        uint32_t read_pos = _header->read_pos.load(std::memory_order_acquire);
+        uint32_t offset = write_pos & (size - 1);
+        uint32_t contiguous = size - offset;
+        uint32_t needed = (contiguous < record_size) ? (record_size + contiguous) : record_size;
+        if (((write_pos - read_pos) + needed) > size)
+            return false;
+
+        // Wrap to the start of the ring if needed
+        if (contiguous < record_size) {
+            std::memcpy(_data + offset, &GUI_MSG_RING_WRAP, sizeof(uint32_t));
+            write_pos += contiguous;
+            offset = 0;
+        }
+
+        // Write the record and publish it
+        std::memcpy(_data + offset, &len, sizeof(len));
+        std::memcpy(_data + offset + sizeof(len), frame, len);
+        write_pos += record_size;
+        _header->write_pos.store(write_pos, std::memory_order_seq_cst);
+        if ((write_pos - read_pos) > _header->high_water.load(std::memory_order_relaxed))
+            _header->high_water.store((write_pos - read_pos), std::memory_order_relaxed);
+
+        // Ring the doorbell if the consumer is waiting
+        if (notify)
+            this->notify();
+        return true;
+    }
+
+    //----------------------------------------------------------------------------
+    // notify
+    // Producer only - rings the doorbell if the consumer is waiting
+    //----------------------------------------------------------------------------
+    void notify()
+    {
+        if (_header->consumer_waiting.load(std::memory_order_seq_cst))
+            wake();
+    }
+
+    //----------------------------------------------------------------------------
+    // front
+    // Consumer only - gets the oldest frame, which remains valid until popped
+    //----------------------------------------------------------------------------
+    bool front(const uint8_t *&frame, uint32_t& len)
+    {
+        uint32_t size = _header->size;
+        uint32_t read_pos = _header->read_pos.load(std::memory_order_relaxed);
+        uint32_t write_pos = _header->write_pos.load(std::memory_order_acquire);
+        while (read_pos != write_pos) {
+            // Get the record length
+            uint32_t offset = read_pos & (size - 1);
+            std::memcpy(&len, _data + offset, sizeof(len));
+
+            // Skip any wrap padding
+            if (len == GUI_MSG_RING_WRAP) {
+                read_pos += (size - offset);
+                _header->read_pos.store(read_pos, std::memory_order_release);
+                continue;
+            }
+
+            // Check the record is valid - if not discard the ring contents
+            if ((len > size) || (_record_size(len) > (size - offset)) || (_record_size(len) > (write_pos - read_pos))) {
+                _header->read_pos.store(write_pos, std::memory_order_release);
+                return false;
+            }
+            frame = _data + offset + sizeof(len);
+            _front_size = _record_size(len);
+            return true;
+        }
+        return false;
+    }
+
+    //----------------------------------------------------------------------------
+    // pop
+    // Consumer only - releases the frame returned by front
+    //----------------------------------------------------------------------------
+    void pop()
+    {
+        _header->read_pos.fetch_add(_front_size, std::memory_order_release);
+        _front_size = 0;
+    }
+
+    //----------------------------------------------------------------------------
+    // wait
+    // Consumer only - waits for the ring to become non-empty, or the cancel
+    // flag to be set (followed by a call to wake). The timeout is relative and
+    // measured against CLOCK_MONOTONIC (-1 to wait forever)
+    // If another ring is specified (e.g. the urgent lane), the wait also ends
+    // when it becomes non-empty - its producer must notify this ring
+    //----------------------------------------------------------------------------
+    void wait(int timeout_ms, const std::atomic<bool> *cancel=nullptr, const GuiMsgRing *other=nullptr)
+    {
+        // Indicate we are waiting, and re-check the ring(s) and cancel flag before
+        // sleeping on the doorbell - this ensures a wakeup is never missed
+        uint32_t doorbell = _header->doorbell.load(std::memory_order_seq_cst);
+        _header->consumer_waiting.store(1, std::memory_order_seq_cst);
+        if (_empty() && (!other || other->_empty()) &&
+            (!cancel || !cancel->load(std::memory_order_seq_cst))) {
+            timespec timeout;
+            timeout.tv_sec = timeout_ms / 1000;
+            timeout.tv_nsec = (timeout_ms % 1000) * 1000000;
+            ::syscall(SYS_futex, &_header->doorbell, FUTEX_WAIT, doorbell, ((timeout_ms < 0) ? nullptr : &timeout), nullptr, 0);
+        }
+        _header->consumer_waiting.store(0, std::memory_order_relaxed);
+    }
+
+    //----------------------------------------------------------------------------
+    // wake
+    // Rings the doorbell, waking the consumer
+    //----------------------------------------------------------------------------
+    void wake()
+    {
+        _header->doorbell.fetch_add(1, std::memory_order_seq_cst);
+        ::syscall(SYS_futex, &_header->doorbell, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+    }
+
+    //----------------------------------------------------------------------------
+    // fill_level
+    // Returns the current fill level of the ring in bytes
+    //----------------------------------------------------------------------------
+    uint32_t fill_level() const
+    {
+        return _header->write_pos.load(std::memory_order_relaxed) - _header->read_pos.load(std::memory_order_relaxed);
+    }
+
+    //----------------------------------------------------------------------------
+    // high_water_mark
+    // Returns the highest fill level of the ring in bytes
+    //----------------------------------------------------------------------------
+    uint32_t high_water_mark() const
+    {
+        return _header->high_water.load(std::memory_order_relaxed);
+    }
+
+    //----------------------------------------------------------------------------
+    // size
+    //----------------------------------------------------------------------------
+    uint32_t size() const
+    {
+        return _header->size;
+    }
+
+private:
+    // Private data
+    GuiMsgRingHeader *_header;
+    uint8_t *_data;
+    size_t _map_size;
+    uint32_t _front_size;
+
+    //----------------------------------------------------------------------------
+    // _map
+    //----------------------------------------------------------------------------
+    bool _map(int fd)
+    {
+        // Map the shared memory segment
+        void *addr = ::mmap(nullptr, _map_size, (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED)
+            return false;
+        _header = static_cast<GuiMsgRingHeader *>(addr);
+        _data = static_cast<uint8_t *>(addr) + sizeof(GuiMsgRingHeader);
+        return true;
+    }
+
+    //----------------------------------------------------------------------------
+    // _empty
+    //----------------------------------------------------------------------------
+    bool _empty() const
+    {
+        return _header->write_pos.load(std::memory_order_seq_cst) == _header->read_pos.load(std::memory_order_relaxed);
+    }
+
+    //----------------------------------------------------------------------------
+    // _record_size
+    //----------------------------------------------------------------------------
+    static uint32_t _record_size(uint32_t len)
+    {
+        // Each record is the frame length followed by the frame, aligned
+        return (sizeof(uint32_t) + len + (GUI_MSG_RING_RECORD_ALIGN - 1)) & ~(GUI_MSG_RING_RECORD_ALIGN - 1);
+    }
+};
+
+#endif  // GUI_MSG_RING_H
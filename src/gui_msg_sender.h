@@ -0,0 +1,557 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  gui_msg_sender.h
+ * @brief GUI Message Sender class definitions and implementation.
+ *
+ * The sender is the producer side of the GUI message protocol, for use by
+ * the Nina UI app. Messages are built in place in a pending batch, and sent
+ * as sized frames over the shared memory ring if the Nina GUI provides one,
+ * otherwise over the GUI message queue.
+ * Value updates superseded by a later message of the same type within the
+ * batch are coalesced before sending, using the same policy as the Nina GUI
+ * (see the GUI message registry in common.h). Urgent messages are sent
+ * immediately in the urgent lane, even within a batch - the pending messages
+ * are sent first, as an urgent message is an ordering barrier (see
+ * GuiMsgLane in common.h).
+ * If flow control is enabled, the Nina GUI reports the messages it has
+ * applied, and value updates are held (and coalesced) while too many messages
+ * are in flight. The producer must then call service() periodically (see
+ * service_timeout()), so that held messages are sent if the GUI stops
+ * acknowledging.
+ * Note: The sender is shared with the Nina UI app, and is therefore
+ * implemented in this header. It is not thread safe.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef GUI_MSG_SENDER_H
+#define GUI_MSG_SENDER_H
+
+#include <mqueue.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include "common.h"
+#include "gui_msg_codec.h"
+#include "gui_msg_ring.h"
+
+// Constants
+constexpr uint GUI_MSG_SENDER_BATCH_SIZE  = 32;
+constexpr uint GUI_MSG_SENDER_RETRY_US    = 100;
+constexpr uint GUI_MSG_SENDER_ACK_TIMEOUT_MS = 100;
+
+// GUI message sender stats
+struct GuiMsgSenderStats
+{
+    uint64_t num_sent;
+    uint64_t num_coalesced;
+    uint64_t num_queue_full;
+    uint64_t num_dropped;
+    uint64_t num_held;
+};
+
+// GUI Message Sender class
+class GuiMsgSender
+{
+public:
+    //----------------------------------------------------------------------------
+    // GuiMsgSender
+    //----------------------------------------------------------------------------
+    GuiMsgSender() :
+        _msgs(GUI_MSG_SENDER_BATCH_SIZE),
+        _frame(GUI_MSG_MAX_FRAME_SIZE)
+    {
+        // Initialise class variables
+        _desc = (mqd_t)-1;
+        _ring_name = nullptr;
+        _queue_name = nullptr;
+        _urgent_ring_name = nullptr;
+        _blocking = true;
+        _trace = false;
+        std::memset(_trace_seq, 0, sizeof(_trace_seq));
+        _num_normal_sent = 0;
+        _max_in_flight = 0;
+        _applied_seq = 0;
+        _last_ack_time = 0;
+        _num_msgs = 0;
+        _batching = false;
+        _has_barrier = false;
+        std::memset(_coalesced, 0, sizeof(_coalesced));
+        _reset_last_index();
+        std::memset(&_stats, 0, sizeof(_stats));
+    }
+
+    //----------------------------------------------------------------------------
+    // ~GuiMsgSender
+    //----------------------------------------------------------------------------
+    ~GuiMsgSender()
+    {
+        close();
+    }
+
+    //----------------------------------------------------------------------------
+    // open
+    // The ring is used if the Nina GUI has created it, otherwise the queue. If
+    // not blocking, messages are dropped rather than waiting for a full
+    // transport to drain
+    //----------------------------------------------------------------------------
+    bool open(bool blocking=true, const char *ring_name=GUI_MSG_RING_NAME, const char *queue_name=GUI_MSG_QUEUE_NAME,
+              const char *urgent_ring_name=GUI_MSG_URGENT_RING_NAME)
+    {
+        // Make sure the sender is closed
+        close();
+        _blocking = blocking;
+        _ring_name = ring_name;
+        _queue_name = queue_name;
+        _urgent_ring_name = urgent_ring_name;
+        return _open_transport();
+    }
+
+    //----------------------------------------------------------------------------
+    // close
+    // Any pending messages are sent first
+    //----------------------------------------------------------------------------
+    void close()
+    {
+        if (is_open())
+            flush();
+        _ring.close();
+        _urgent_ring.close();
+        if (_desc != (mqd_t)-1) {
+            ::mq_close(_desc);
+            _desc = (mqd_t)-1;
+        }
+        _num_msgs = 0;
+        _batching = false;
+        _has_barrier = false;
+    }
+
+    //----------------------------------------------------------------------------
+    // is_open
+    //----------------------------------------------------------------------------
+    bool is_open() const
+    {
+        return _ring.is_open() || (_desc != (mqd_t)-1);
+    }
+
+    //----------------------------------------------------------------------------
+    // using_ring
+    //----------------------------------------------------------------------------
+    bool using_ring() const
+    {
+        return _ring.is_open();
+    }
+
+    //----------------------------------------------------------------------------
+    // set_trace
+    // If set, each message is sent with a trace to measure its latency
+    //----------------------------------------------------------------------------
+    void set_trace(bool trace)
+    {
+        _trace = trace;
+    }
+
+    //----------------------------------------------------------------------------
+    // set_flow_control
+    // If max_in_flight is non-zero, messages are traced and normal lane
+    // messages are acknowledged by the Nina GUI when applied (see applied()).
+    // While max_in_flight or more normal lane messages are unacknowledged, value
+    // updates are held and coalesced until the GUI catches up - barriers and
+    // urgent messages are always sent. If the GUI does not acknowledge within
+    // GUI_MSG_SENDER_ACK_TIMEOUT_MS, held messages are sent by the next
+    // service() call
+    //----------------------------------------------------------------------------
+    void set_flow_control(uint max_in_flight)
+    {
+        _max_in_flight = max_in_flight;
+        _applied_seq = _trace_seq[GuiMsgLane::LANE_NORMAL];
+        _last_ack_time = _now();
+    }
+
+    //----------------------------------------------------------------------------
+    // applied
+    // Called when the GUI_MSGS_APPLIED event is received from the Nina GUI -
+    // all messages in the lane up to and including seq have been applied
+    //----------------------------------------------------------------------------
+    void applied(GuiMsgLane lane, uint32_t seq)
+    {
+        // Only the normal lane is flow controlled - ignore stale
+        // acknowledgements (and any from before flow control was enabled)
+        uint32_t next_seq = seq + 1;
+        if ((_max_in_flight == 0) || (lane != GuiMsgLane::LANE_NORMAL) ||
+            ((uint32_t)(next_seq - _applied_seq) > in_flight()))
+            return;
+        _applied_seq = next_seq;
+        _last_ack_time = _now();
+
+        // Send any held messages, unless still batching
+        if (!_batching && (_num_msgs > 0))
+            _send_batch();
+    }
+
+    //----------------------------------------------------------------------------
+    // service
+    // Sends any held messages if the GUI has caught up or stopped acknowledging
+    // - the producer must call this while messages are held, at the latest when
+    // service_timeout() expires (e.g. as its poll() timeout)
+    //----------------------------------------------------------------------------
+    bool service()
+    {
+        if (_batching || (_num_msgs == 0))
+            return true;
+        return _send_batch();
+    }
+
+    //----------------------------------------------------------------------------
+    // service_timeout
+    // Returns the time (ms) until service() must be called to send the held
+    // messages, or -1 if there are none
+    //----------------------------------------------------------------------------
+    int service_timeout() const
+    {
+        if (_batching || (_num_msgs == 0))
+            return -1;
+        uint64_t elapsed_ms = (_now() - _last_ack_time) / 1000000;
+        return (elapsed_ms < GUI_MSG_SENDER_ACK_TIMEOUT_MS) ? (int)(GUI_MSG_SENDER_ACK_TIMEOUT_MS - elapsed_ms) : 0;
+    }
+
+    //----------------------------------------------------------------------------
+    // in_flight
+    // Returns the number of normal lane messages sent but not yet applied (flow
+    // control only)
+    //----------------------------------------------------------------------------
+    uint in_flight() const
+    {
+        return (_max_in_flight > 0) ? (uint32_t)(_trace_seq[GuiMsgLane::LANE_NORMAL] - _applied_seq) : 0;
+    }
+
+    //----------------------------------------------------------------------------
+    // begin
+    // Returns the next message in the pending batch to be built in place - only
+    // the message type is set, and the message is not sent until committed
+    //----------------------------------------------------------------------------
+    GuiMsg& begin(GuiMsgType type)
+    {
+        // If the batch is full, send it first (the batch continues) - this
+        // includes held messages
+        if (_num_msgs == GUI_MSG_SENDER_BATCH_SIZE)
+            _send_batch(true);
+        GuiMsg& msg = _msgs[_num_msgs];
+        msg.type = type;
+        return msg;
+    }
+
+    //----------------------------------------------------------------------------
+    // commit
+    // Commits the message returned by begin()
+    //----------------------------------------------------------------------------
+    void commit()
+    {
+        // If this is an urgent message, send it now - any pending messages
+        // are sent first (the batch continues), as the GUI does not apply it
+        // until it has received every normal message sent before it
+        const GuiMsg& msg = _msgs[_num_msgs];
+        GuiMsgType type = msg.type;
+        if (gui_msg_lane(type) == GuiMsgLane::LANE_URGENT) {
+            _send_batch(true);
+            _send_frame(msg, GuiMsgLane::LANE_URGENT);
+            if (_ring.is_open())
+                _ring.notify();
+            return;
+        }
+
+        // Is this message a value update?
+        if (gui_msg_policy(type) == GuiMsgPolicy::LAST_WRITER_WINS) {
+            // If the batch already has a message of this type since the last
+            // barrier, it is superseded
+            int last_index = _last_index[type];
+            if (last_index >= 0) {
+                _coalesced[last_index] = true;
+                _stats.num_coalesced++;
+            }
+            _last_index[type] = _num_msgs;
+        }
+        else {
+            // Barrier - no message can be coalesced across it
+            _reset_last_index();
+            _has_barrier = true;
+        }
+        _coalesced[_num_msgs] = false;
+        _num_msgs++;
+
+        // If not batching, send the message now
+        if (!_batching)
+            flush();
+    }
+
+    //----------------------------------------------------------------------------
+    // send
+    // Sends a message built outside the sender (copied into the batch)
+    //----------------------------------------------------------------------------
+    void send(const GuiMsg& msg)
+    {
+        std::memcpy((void *)&begin(msg.type), &msg, sizeof(GuiMsg));
+        commit();
+    }
+
+    //----------------------------------------------------------------------------
+    // intern_string
+    // Registers a string under an ID, so that later messages can reference it
+    // with set_str_ref(). The strings must be interned again if the Nina GUI
+    // restarts
+    //----------------------------------------------------------------------------
+    void intern_string(uint id, const char *str)
+    {
+        GuiMsg& msg = begin(GuiMsgType::INTERN_STRING);
+        msg.intern_string.id = id;
+        set_str(msg.intern_string.str, str);
+        commit();
+    }
+
+    //----------------------------------------------------------------------------
+    // begin_batch
+    // Messages committed are held until flush() is called
+    //----------------------------------------------------------------------------
+    void begin_batch()
+    {
+        _batching = true;
+    }
+
+    //----------------------------------------------------------------------------
+    // flush
+    // Sends the pending messages, and ends the batch (if any) - if flow
+    // controlled and the GUI is behind, value updates are held
+    //----------------------------------------------------------------------------
+    bool flush()
+    {
+        _batching = false;
+        return _send_batch();
+    }
+
+    //----------------------------------------------------------------------------
+    // stats
+    //----------------------------------------------------------------------------
+    const GuiMsgSenderStats& stats() const
+    {
+        return _stats;
+    }
+
+    //----------------------------------------------------------------------------
+    // set_str
+    // Copies a string into a message field, truncating it if needed
+    //----------------------------------------------------------------------------
+    static void set_str(char *dst, const char *src, uint size=STD_STR_LEN)
+    {
+        std::strncpy(dst, src, (size - 1));
+        dst[size - 1] = 0;
+    }
+
+    //----------------------------------------------------------------------------
+    // set_str_ref
+    // Sets a message field to reference an interned string
+    //----------------------------------------------------------------------------
+    static void set_str_ref(char *dst, uint id)
+    {
+        gui_msg_set_intern_ref(dst, id);
+    }
+
+private:
+    // Private variables
+    mqd_t _desc;
+    GuiMsgRing _ring;
+    GuiMsgRing _urgent_ring;
+    bool _blocking;
+    bool _trace;
+    uint32_t _trace_seq[NUM_GUI_MSG_LANES];
+    uint32_t _num_normal_sent;
+    uint _max_in_flight;
+    uint32_t _applied_seq;
+    uint64_t _last_ack_time;
+    std::vector<GuiMsg> _msgs;
+    bool _coalesced[GUI_MSG_SENDER_BATCH_SIZE];
+    int _last_index[NUM_GUI_MSG_TYPES];
+    uint _num_msgs;
+    bool _batching;
+    bool _has_barrier;
+    std::vector<uint8_t> _frame;
+    GuiMsgSenderStats _stats;
+    const char *_ring_name;
+    const char *_queue_name;
+    const char *_urgent_ring_name;
+
+    //----------------------------------------------------------------------------
+    // _open_transport
+    //----------------------------------------------------------------------------
+    bool _open_transport()
+    {
+        // Try the ring first - if there is no urgent ring, urgent messages are
+        // sent on the (normal) ring
+        if (_ring_name && _ring.open(_ring_name)) {
+            if (_urgent_ring_name)
+                _urgent_ring.open(_urgent_ring_name);
+            return true;
+        }
+
+        // Fall back to the queue - this is always non-blocking, as a full queue
+        // is handled when sending
+        mq_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.mq_maxmsg = GUI_MSG_QUEUE_SIZE;
+        attr.mq_msgsize = GUI_MSG_MAX_SIZE;
+        _desc = ::mq_open(_queue_name, (O_CREAT | O_WRONLY | O_NONBLOCK),
+                          (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH),
+                          &attr);
+        return _desc != (mqd_t)-1;
+    }
+
+    //----------------------------------------------------------------------------
+    // _reopen_transport
+    // Called if the ring consumer is no longer running - the ring is re-opened
+    // if the Nina GUI has been restarted, otherwise the queue is used
+    //----------------------------------------------------------------------------
+    bool _reopen_transport()
+    {
+        MSG("GuiMsgSender: The GUI message ring consumer is not running, re-opening");
+        _ring.close();
+        _urgent_ring.close();
+        return _open_transport();
+    }
+
+    //----------------------------------------------------------------------------
+    // _send_batch
+    //----------------------------------------------------------------------------
+    bool _send_batch(bool force=false)
+    {
+        bool ret = true;
+
+        // Hold the batch if it only has value updates and the GUI is behind
+        if (_num_msgs == 0)
+            return true;
+        if (!force && !_has_barrier && _congested()) {
+            _stats.num_held++;
+            return true;
+        }
+
+        // Send each message in the batch that has not been coalesced - the ring
+        // consumer is woken once after the whole batch
+        for (uint i=0; i<_num_msgs; i++) {
+            if (!_coalesced[i] && !_send_frame(_msgs[i], GuiMsgLane::LANE_NORMAL))
+                ret = false;
+        }
+        if (_ring.is_open())
+            _ring.notify();
+        _num_msgs = 0;
+        _has_barrier = false;
+        _reset_last_index();
+        return ret;
+    }
+
+    //----------------------------------------------------------------------------
+    // _congested
+    //----------------------------------------------------------------------------
+    bool _congested() const
+    {
+        // Congested if too many messages are in flight, and the GUI has
+        // acknowledged recently (otherwise it is assumed to be stalled or gone)
+        if ((_max_in_flight == 0) || (in_flight() < _max_in_flight))
+            return false;
+        return (_now() - _last_ack_time) < (GUI_MSG_SENDER_ACK_TIMEOUT_MS * 1000000ULL);
+    }
+
+    //----------------------------------------------------------------------------
+    // _send_frame
+    //----------------------------------------------------------------------------
+    bool _send_frame(const GuiMsg& msg, GuiMsgLane lane)
+    {
+        GuiMsgTrace trace;
+
+        // Encode the message frame, with a trace if enabled - each lane has its
+        // own sequence, and only the normal lane is acknowledged
+        bool traced = _trace || (_max_in_flight > 0);
+        if (traced) {
+            trace.seq = _trace_seq[lane]++;
+            trace.flags = ((_max_in_flight > 0) && (lane == GuiMsgLane::LANE_NORMAL)) ? GUI_MSG_TRACE_FLAG_ACK : 0;
+            trace.send_time = _now();
+        }
+        // Urgent messages carry the number of normal messages sent before them
+        uint32_t order = _num_normal_sent;
+        uint len = GuiMsgCodec::encode(msg, _frame.data(), _frame.size(), (traced ? &trace : nullptr),
+                                       ((lane == GuiMsgLane::LANE_URGENT) ? &order : nullptr));
+        if (len == 0) {
+            _stats.num_dropped++;
+            return false;
+        }
+
+        // Send the frame in its lane - if the transport is full either wait for
+        // it to drain, or drop the message
+        // Note: The consumer only waits on the (normal) ring doorbell
+        bool full_counted = false;
+        while (true) {
+            GuiMsgRing& ring = ((lane == GuiMsgLane::LANE_URGENT) && _urgent_ring.is_open()) ? _urgent_ring : _ring;
+            bool sent;
+            if (ring.is_open()) {
+                // If the ring is full, check it is because the consumer is no
+                // longer running - if so, re-open the transport and send again
+                sent = ring.push(_frame.data(), len, false);
+                if (!sent && !ring.consumer_alive()) {
+                    if (!_reopen_transport()) {
+                        _stats.num_dropped++;
+                        return false;
+                    }
+                    continue;
+                }
+            }
+            else {
+                sent = ::mq_send(_desc, (char *)_frame.data(), len, lane) == 0;
+            }
+            if (sent) {
+                if (lane == GuiMsgLane::LANE_NORMAL)
+                    _num_normal_sent++;
+                _stats.num_sent++;
+                return true;
+            }
+            if (!_ring.is_open() && (errno != EAGAIN)) {
+                _stats.num_dropped++;
+                return false;
+            }
+            if (!full_counted) {
+                _stats.num_queue_full++;
+                full_counted = true;
+            }
+            if (!_blocking) {
+                _stats.num_dropped++;
+                return false;
+            }
+
+            // Make sure the ring consumer is awake to drain the ring
+            if (_ring.is_open())
+                _ring.notify();
+            timespec ts = {0, (GUI_MSG_SENDER_RETRY_US * 1000)};
+            ::nanosleep(&ts, nullptr);
+        }
+    }
+
+    //----------------------------------------------------------------------------
+    // _reset_last_index
+    //----------------------------------------------------------------------------
+    void _reset_last_index()
+    {
+        for (uint i=0; i<NUM_GUI_MSG_TYPES; i++)
+            _last_index[i] = -1;
+    }
+
+    //----------------------------------------------------------------------------
+    // _now
+    //----------------------------------------------------------------------------
+    static uint64_t _now()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+    }
+};
+
+#endif  // GUI_MSG_SENDER_H
@@ -6,22 +6,66 @@
  * @brief GUI Message Thread class implementation.
  *-----------------------------------------------------------------------------
  */
+#include <algorithm>
 #include <mqueue.h>
 #include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include "gui_msg_thread.h"
+#include "gui_msg_codec.h"
+#include "gui_msg_ring.h"
 
 // Constants
-constexpr char GUI_MSG_QUEUE_NAME[] = "/nina_msg_queue";
-constexpr uint GUI_MSG_QUEUE_SIZE   = 50;
-constexpr auto GUI_POLL_TIMEOUT     = 1;
+#ifdef GUI_MSG_RING_TRANSPORT
+constexpr uint GUI_MSG_RING_SIZE        = (256 * 1024);
+constexpr uint GUI_MSG_URGENT_RING_SIZE = (32 * 1024);
+#endif
 
 //----------------------------------------------------------------------------
 // GuiMsgThread
 //----------------------------------------------------------------------------
-GuiMsgThread::GuiMsgThread(QObject *parent) : QThread(parent)
+GuiMsgThread::GuiMsgThread(GuiMsgPool& pool, IpcRecorder& recorder, IpcQueueHealth& health, QObject *parent) :
+    QThread(parent),
+    _pool(pool),
+    _recorder(recorder),
+    _health(health),
+    _coalescer(pool)
 {
     // Initialise class variables
     _exit_gui_msgs_thread = false;
+    _ring = nullptr;
+    _num_traced = 0;
+    for (uint i=0; i<NUM_GUI_MSG_LANES; i++)
+        _lane_stats[i].num_msgs = 0;
+    _num_normal_msgs = 0;
+    _held_urgent_head = 0;
+    _num_held_urgent_msgs = 0;
+    _pending_msgs.reserve(GUI_MSG_POOL_SIZE);
+    _pending_since = 0;
+
+    // Create the event used to wake the thread when it is stopped
+    _exit_event_fd = ::eventfd(0, (EFD_CLOEXEC | EFD_NONBLOCK));
+    if (_exit_event_fd == -1)
+    {
+        // This is not fatal, but the thread cannot be stopped while idle
+        MSG("GuiMsgThread: ERROR: Could not create the exit event: " << errno);
+    }
+
+    // Open the GUI Event Message Queue (create if it doesn't exist), used to send
+    // events back to the Nina UI app - this is non-blocking so the GUI is never
+    // blocked if the Nina UI app is not reading the events
+    mq_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.mq_maxmsg = GUI_EVENT_MSG_QUEUE_SIZE;
+    attr.mq_msgsize = sizeof(GuiEventMsg);
+    _event_queue_desc = ::mq_open(GUI_EVENT_MSG_QUEUE_NAME, (O_CREAT|O_WRONLY|O_NONBLOCK),
+                                  (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH),
+                                  &attr);
+    if (_event_queue_desc == (mqd_t)-1)
+    {
+        // This is not fatal, but no events can be sent
+        MSG("GuiMsgThread: ERROR: Could not open the GUI event message queue: " << errno);
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -29,23 +73,115 @@ GuiMsgThread::GuiMsgThread(QObject *parent) : QThread(parent)
 //----------------------------------------------------------------------------
 GuiMsgThread::~GuiMsgThread()
 {
-    // Stop the thread
+    // Stop the thread, and wake it if it is waiting for messages or a free
+    // message in the pool
     _exit_gui_msgs_thread = true;
+    _pool.cancel();
+    if (_exit_event_fd != -1)
+    {
+        uint64_t event = 1;
+        (void)::write(_exit_event_fd, &event, sizeof(event));
+    }
+    {
+        std::lock_guard<std::mutex> lock(_ring_mutex);
+        if (_ring)
+            _ring->wake();
+    }
     wait();
+
+    // Close the exit event and GUI event message queue
+    if (_exit_event_fd != -1)
+        ::close(_exit_event_fd);
+    if (_event_queue_desc != (mqd_t)-1)
+        ::mq_close(_event_queue_desc);
+}
+
+//----------------------------------------------------------------------------
+// take_msgs
+// Called from the GUI thread to take the pending messages, in the order they
+// were received
+//----------------------------------------------------------------------------
+void GuiMsgThread::take_msgs(std::vector<GuiMsgHandle>& msgs)
+{
+    // Swap the pending messages with the (empty) passed vector - this means
+    // no allocation is needed once both vectors have been reserved
+    std::lock_guard<std::mutex> lock(_pending_msgs_mutex);
+    msgs.swap(_pending_msgs);
+
+    // Measure how long the messages waited for the GUI thread
+    if (msgs.size())
+        _health.behind((GuiMsgLatency::now() - _pending_since) / 1000);
+}
+
+//----------------------------------------------------------------------------
+// send_event
+// Called from the GUI thread to send an event to the Nina UI app
+//----------------------------------------------------------------------------
+bool GuiMsgThread::send_event(const GuiEventMsg& event)
+{
+    // Send the event, if the queue is full the event is dropped
+    // Returns true if the event was sent
+    if (_event_queue_desc != (mqd_t)-1)
+    {
+        if (::mq_send(_event_queue_desc, (const char *)&event, sizeof(event), 0) == 0)
+            return true;
+        DEBUG_MSG("GuiMsgThread: Could not send event: " << errno);
+    }
+    return false;
 }
 
 //----------------------------------------------------------------------------
 // run
 //----------------------------------------------------------------------------
 void GuiMsgThread::run()
+{
+#ifdef GUI_MSG_RING_TRANSPORT
+    // Create the GUI Message Rings (normal and urgent lanes), and if successful
+    // process messages from them
+    GuiMsgRing ring;
+    GuiMsgRing urgent_ring;
+    if (ring.create(GUI_MSG_RING_NAME, GUI_MSG_RING_SIZE) &&
+        urgent_ring.create(GUI_MSG_URGENT_RING_NAME, GUI_MSG_URGENT_RING_SIZE))
+    {
+        // Make the ring available so the thread can be woken when stopped
+        {
+            std::lock_guard<std::mutex> lock(_ring_mutex);
+            _ring = &ring;
+        }
+        _process_ring(ring, urgent_ring);
+        {
+            std::lock_guard<std::mutex> lock(_ring_mutex);
+            _ring = nullptr;
+        }
+
+        // Remove the rings, so the Nina UI app does not send to them after
+        // this clean exit
+        ring.destroy(GUI_MSG_RING_NAME);
+        urgent_ring.destroy(GUI_MSG_URGENT_RING_NAME);
+        return;
+    }
+
+    // Could not create the ring, so fall back to the GUI Message Queue
+    MSG("GuiMsgThread: ERROR: Could not create the GUI message ring, using the message queue: " << errno);
+#endif
+    _process_msg_queue();
+}
+
+//----------------------------------------------------------------------------
+// _process_msg_queue
+//----------------------------------------------------------------------------
+void GuiMsgThread::_process_msg_queue()
 {
     mq_attr attr;
 
-    // Open the GUI Message Queue (create if it doesn't exist)
+    // Open the GUI Message Queue (create if it doesn't exist) - it is opened
+    // non-blocking so that it can be drained after each wakeup
+    // Note: The queue always returns the highest priority message first, so
+    // the urgent lane is drained first
     std::memset(&attr, 0, sizeof(attr));
     attr.mq_maxmsg = GUI_MSG_QUEUE_SIZE;
-    attr.mq_msgsize = sizeof(GuiMsg);
-    mqd_t desc = ::mq_open(GUI_MSG_QUEUE_NAME, (O_CREAT|O_RDONLY),
+    attr.mq_msgsize = GUI_MSG_MAX_SIZE;
+    mqd_t desc = ::mq_open(GUI_MSG_QUEUE_NAME, (O_CREAT|O_RDONLY|O_NONBLOCK),
                            (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH),
                            &attr);
     if (desc == (mqd_t)-1)
@@ -55,123 +191,305 @@ void GuiMsgThread::run()
         return;
     }
 
+    // Wait on the GUI Message Queue (on Linux the descriptor can be polled) and
+    // the exit event
+    pollfd pfds[2];
+    pfds[0].fd = desc;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = _exit_event_fd;
+    pfds[1].events = POLLIN;
+
     // Run until the thread is stopped
     while(!_exit_gui_msgs_thread)
     {
-        timespec poll_time;
-        auto msg = GuiMsg();
-
-        // Wait for GUI events, timeout, or an error
-        clock_gettime(CLOCK_REALTIME, &poll_time);
-        poll_time.tv_sec += GUI_POLL_TIMEOUT;        
-        int res = ::mq_timedreceive(desc, (char *)&msg, sizeof(msg), NULL, &poll_time);
-        if (res == sizeof(msg))
+        uint8_t msg_buf[GUI_MSG_MAX_SIZE];
+        uint prio;
+
+        // Wait for GUI events, the exit event, or an error - note there is no timeout,
+        // so the thread does not wake while idle
+        int res = ::poll(pfds, ((_exit_event_fd != -1) ? 2 : 1), -1);
+        if (res == -1)
         {
-            // Switch on the message type
-            switch (msg.type) 
+            // If not interrupted by a signal
+            if (errno != EINTR)
             {
-                case GuiMsgType::SET_LEFT_STATUS:
-                    emit left_status_msg(msg.left_status);
-                    break;
-
-                case GuiMsgType::SET_LAYER_STATUS:
-                    emit layer_status_msg(msg.layer_status);
-                    break;
-
-                case GuiMsgType::SET_MIDI_STATUS:
-                    emit midi_status_msg(msg.midi_status);
-                    break;
-
-                case GuiMsgType::SET_TEMPO_STATUS:
-                    emit tempo_status_msg(msg.tempo_status);
-                    break;
-
-                case GuiMsgType::SHOW_HOME_SCREEN:
-                    emit home_screen_msg(msg.home_screen);
-                    break;
-
-                case GuiMsgType::SHOW_LIST_ITEMS:
-                    emit list_items_msg(msg.list_items);
-                    break;
-
-                case GuiMsgType::LIST_SELECT_ITEM:
-                    emit list_select_item_msg(msg.list_select_item);
-                    break;
-
-                case GuiMsgType::SET_SOFT_BUTTONS:
-                    emit soft_buttons_msg(msg.soft_buttons);
-                    break;                
-
-                case GuiMsgType::SOFT_BUTTONS_STATE:
-                    emit soft_buttons_state_msg(msg.soft_buttons_state);
-                    break;
-                
-                case GuiMsgType::PARAM_UPDATE:
-                    emit param_update_msg(msg.param_update);
-                    break;
-
-                case GuiMsgType::PARAM_VALUE_UPDATE:
-                    emit param_value_update_msg(msg.param_value_update);
-                    break;
-
-                case GuiMsgType::ENUM_PARAM_UPDATE:
-                    emit enum_param_update_msg(msg.enum_param_update);
-                    break;                  
-
-                case GuiMsgType::ENUM_PARAM_UPDATE_VALUE:
-                    emit enum_param_value_update_msg(msg.list_select_item);
-                    break;
-
-                case GuiMsgType::EDIT_NAME:
-                    emit edit_name_msg(msg.edit_name);
-                    break;
-
-                case GuiMsgType::EDIT_NAME_SELECT_CHAR:
-                    emit edit_name_select_char_msg(msg.edit_name_select_char);
-                    break;
-
-                case GuiMsgType::EDIT_NAME_CHANGE_CHAR:
-                    emit edit_name_change_char_msg(msg.edit_name_change_char);
-                    break;
-
-                case GuiMsgType::SHOW_CONFIRMATION_SCREEN:
-                    emit confirmation_screen_msg(msg.confirmation_screen);
-                    break;
-
-                case GuiMsgType::SHOW_WARNING_SCREEN:
-                    emit warning_screen_msg(msg.warning_screen);
-                    break;
-
-                case GuiMsgType::CLEAR_BOOT_WARNING_SCREEN:
-                    emit clear_boot_warning_msg();
-                    break;
-
-                case GuiMsgType::SET_SYSTEM_COLOUR:
-                    emit set_system_colour_msg(msg.set_system_colour);
-                    break;
-
-                default:
-                    // Ignore any unknown messages
-                    break;
+                // An error occurred, stop processing the queue
+                DEBUG_MSG("GuiMsgThread: Message Queue poll error: " << errno);
+                break;
             }
+            continue;
         }
-        else if (res == -1)
+
+        // Update the queue depth
+        if (::mq_getattr(desc, &attr) == 0)
+            _health.set_depth(attr.mq_curmsgs);
+
+        // Drain the queued messages into the batch so that superseded messages
+        // are coalesced, and process the batch
+        // If the batch is full any remaining messages are processed on the next
+        // loop, as the poll returns immediately
+        // The queue returns urgent messages first, so any received before the
+        // normal messages sent before them are held until those are received
+        while (!_coalescer.full() &&
+               ((res = ::mq_receive(desc, (char *)msg_buf, sizeof(msg_buf), &prio)) > 0))
         {
-            // If not a timeout
-            if (errno != ETIMEDOUT)
+            if (prio >= GuiMsgLane::LANE_URGENT)
             {
-                // An error occurred, stop processing the queue
-                DEBUG_MSG("GuiMsgThread: Message Queue error: " << errno);
-                break;
+                if ((_num_held_urgent_msgs > 0) || !_urgent_msg_ready(msg_buf, res))
+                    _hold_urgent_msg(msg_buf, res);
+                else
+                    _add_msg(msg_buf, res, GuiMsgLane::LANE_URGENT);
+            }
+            else
+            {
+                _add_msg(msg_buf, res, GuiMsgLane::LANE_NORMAL);
+                _add_held_urgent_msgs(false);
             }
         }
+        int receive_errno = errno;
 
+        // If the queue is now empty, any normal messages still expected by the
+        // held urgent messages were lost, so add them anyway
+        if ((res == -1) && (receive_errno == EAGAIN))
+            _add_held_urgent_msgs(true);
+        _process_batch();
+        if ((res == -1) && (receive_errno != EAGAIN) && (receive_errno != EINTR))
+        {
+            // An error occurred, stop processing the queue
+            DEBUG_MSG("GuiMsgThread: Message Queue error: " << receive_errno);
+            _health.receive_error();
+            break;
+        }
     }
 
     // Thread exited
     DEBUG_MSG("GuiMsgThread: thread: EXIT");
+    _print_stats();
 
     // Close the GUI message queue
     ::mq_close(desc);
     //::mq_unlink(GUI_MSG_QUEUE_NAME);
 }
+
+#ifdef GUI_MSG_RING_TRANSPORT
+//----------------------------------------------------------------------------
+// _process_ring
+//----------------------------------------------------------------------------
+void GuiMsgThread::_process_ring(GuiMsgRing& ring, GuiMsgRing& urgent_ring)
+{
+    // Run until the thread is stopped
+    _health.set_depth_units("bytes");
+    while(!_exit_gui_msgs_thread)
+    {
+        const uint8_t *frame;
+        uint32_t len;
+
+        // Update the ring depth
+        _health.set_depth(ring.fill_level() + urgent_ring.fill_level());
+
+        // Process all messages in the rings, in batches - the urgent ring is
+        // checked before each message, so it is always drained first once the
+        // normal messages sent before the urgent message have been received
+        // Note: The frame is decoded directly from the ring
+        while (true)
+        {
+            const uint8_t *urgent_frame;
+            uint32_t urgent_len;
+            bool urgent = urgent_ring.front(urgent_frame, urgent_len);
+            bool normal = ring.front(frame, len);
+            if (urgent && (!normal || _urgent_msg_ready(urgent_frame, urgent_len)))
+            {
+                _add_msg(urgent_frame, urgent_len, GuiMsgLane::LANE_URGENT);
+                urgent_ring.pop();
+            }
+            else if (normal)
+            {
+                _add_msg(frame, len, GuiMsgLane::LANE_NORMAL);
+                ring.pop();
+            }
+            else
+            {
+                break;
+            }
+            if (_coalescer.full())
+                _process_batch();
+        }
+        _process_batch();
+
+        // Wait for the doorbell - there is no timeout, the thread is woken by
+        // the doorbell when stopped. The urgent ring producer also rings this
+        // doorbell
+        ring.wait(-1, &_exit_gui_msgs_thread, &urgent_ring);
+    }
+
+    // Thread exited
+    DEBUG_MSG("GuiMsgThread: thread: EXIT, ring high water mark: " << ring.high_water_mark() << "/" << ring.size() <<
+              ", urgent: " << urgent_ring.high_water_mark() << "/" << urgent_ring.size());
+    _print_stats();
+}
+#endif
+
+//----------------------------------------------------------------------------
+// _urgent_msg_ready
+// Returns true if every normal message sent before the urgent message has been
+// received
+//----------------------------------------------------------------------------
+bool GuiMsgThread::_urgent_msg_ready(const uint8_t *msg_buf, uint len) const
+{
+    // Messages without an order (e.g. legacy messages) are always ready
+    uint32_t order;
+    return !GuiMsgCodec::get_order(msg_buf, len, order) || ((int32_t)(order - _num_normal_msgs) <= 0);
+}
+
+//----------------------------------------------------------------------------
+// _hold_urgent_msg
+// Holds an urgent message until the normal messages sent before it have been
+// received
+//----------------------------------------------------------------------------
+void GuiMsgThread::_hold_urgent_msg(const uint8_t *msg_buf, uint len)
+{
+    // If the held messages are full, add them all (in order) rather than
+    // allocate more - the normal messages they are waiting for are unlikely to
+    // arrive
+    if (_num_held_urgent_msgs == GUI_MSG_MAX_HELD_URGENT_MSGS)
+    {
+        DEBUG_MSG("GuiMsgThread: Held urgent messages full, adding them");
+        _add_held_urgent_msgs(true);
+    }
+
+    // Copy the message to the next free held message
+    auto& msg = _held_urgent_msgs[(_held_urgent_head + _num_held_urgent_msgs) % GUI_MSG_MAX_HELD_URGENT_MSGS];
+    msg.len = std::min<uint>(len, sizeof(msg.buf));
+    std::memcpy(msg.buf, msg_buf, msg.len);
+    _num_held_urgent_msgs++;
+}
+
+//----------------------------------------------------------------------------
+// _add_held_urgent_msgs
+// Adds the held urgent messages that are now ready, in order, or all of them
+//----------------------------------------------------------------------------
+void GuiMsgThread::_add_held_urgent_msgs(bool all)
+{
+    while ((_num_held_urgent_msgs > 0) &&
+           (all || _urgent_msg_ready(_held_urgent_msgs[_held_urgent_head].buf, _held_urgent_msgs[_held_urgent_head].len)))
+    {
+        if (_coalescer.full())
+            _process_batch();
+        auto& msg = _held_urgent_msgs[_held_urgent_head];
+        _add_msg(msg.buf, msg.len, GuiMsgLane::LANE_URGENT);
+        _held_urgent_head = (_held_urgent_head + 1) % GUI_MSG_MAX_HELD_URGENT_MSGS;
+        _num_held_urgent_msgs--;
+    }
+}
+
+//----------------------------------------------------------------------------
+// _add_msg
+//----------------------------------------------------------------------------
+void GuiMsgThread::_add_msg(const uint8_t *msg_buf, uint len, GuiMsgLane lane)
+{
+    // Record the message if recording
+    _recorder.record(((lane == GuiMsgLane::LANE_URGENT) ? IpcQueue::GUI_MSG_URGENT_QUEUE : IpcQueue::GUI_MSG_QUEUE),
+                     msg_buf, len);
+
+    // Count the normal messages received, so that urgent messages are applied
+    // after the normal messages sent before them. Each urgent message resyncs
+    // the count with the sender (e.g. if it has restarted, or messages were
+    // lost)
+    uint32_t order;
+    if (lane == GuiMsgLane::LANE_NORMAL)
+        _num_normal_msgs++;
+    else if (GuiMsgCodec::get_order(msg_buf, len, order))
+        _num_normal_msgs = order;
+
+    // Get the next message in the batch - this is decoded straight into the
+    // pooled message, and is only unavailable if the thread is being stopped
+    auto msg = _coalescer.next_msg();
+    if (!msg)
+        return;
+
+    // Decode the message - this handles both the framed and legacy layouts
+    bool traced;
+    GuiMsgTrace trace;
+    if (!GuiMsgCodec::decode(msg_buf, len, *msg, &traced, &trace))
+    {
+        // Ignore any invalid messages
+        DEBUG_MSG("GuiMsgThread: Invalid message received, length: " << len);
+        _health.receive_error();
+        return;
+    }
+    _health.received();
+
+    // If the message is traced, set when it was sent and received
+    if (traced)
+    {
+        auto timing = _coalescer.next_timing();
+        timing->traced = true;
+        timing->ack = (trace.flags & GUI_MSG_TRACE_FLAG_ACK) != 0;
+        timing->lane = lane;
+        timing->source = msg->type;
+        timing->seq = trace.seq;
+        timing->sent = trace.send_time;
+        timing->received = GuiMsgLatency::now();
+        _lane_stats[lane].wait.record((timing->received - timing->sent) / 1000);
+        _health.traced(trace.seq, lane);
+        _num_traced++;
+    }
+    _lane_stats[lane].num_msgs++;
+    _coalescer.commit();
+}
+
+//----------------------------------------------------------------------------
+// _process_batch
+//----------------------------------------------------------------------------
+void GuiMsgThread::_process_batch()
+{
+    bool notify = false;
+
+    // Add each message in the batch that has not been superseded to the pending
+    // messages for the GUI thread
+    if (_coalescer.count())
+    {
+        // Get the dispatch time if there are traced messages in the batch
+        uint64_t dispatched = _num_traced ? GuiMsgLatency::now() : 0;
+        std::lock_guard<std::mutex> lock(_pending_msgs_mutex);
+        notify = _pending_msgs.empty();
+        for (uint i=0; i<_coalescer.count(); i++)
+        {
+            auto& handle = _coalescer.msg(i);
+            if (handle.is_valid())
+            {
+                if (handle.timing()->traced)
+                    handle.timing()->dispatched = dispatched;
+                _pending_msgs.push_back(handle);
+            }
+        }
+        notify = notify && !_pending_msgs.empty();
+        if (notify)
+            _pending_since = GuiMsgLatency::now();
+    }
+    _coalescer.clear();
+    _num_traced = 0;
+
+    // Notify the GUI thread if there were no messages pending - otherwise the
+    // GUI has not yet processed the last notification, and will take these
+    // messages at the same time
+    if (notify)
+        emit gui_msgs_ready();
+}
+
+//----------------------------------------------------------------------------
+// _print_stats
+//----------------------------------------------------------------------------
+void GuiMsgThread::_print_stats()
+{
+    // Show the messages received and the wait (us) in each lane
+    for (uint i=0; i<NUM_GUI_MSG_LANES; i++)
+    {
+        auto& stats = _lane_stats[i];
+        MSG("GuiMsgThread: " << ((i == GuiMsgLane::LANE_URGENT) ? "urgent" : "normal") << " lane: " << stats.num_msgs <<
+            " msgs, wait (traced): mean: " << stats.wait.mean() << " p99: " << stats.wait.percentile(99.0f) <<
+            " max: " << stats.wait.max() << " us");
+    }
+    _coalescer.print_stats();
+    _pool.print_stats();
+}
@@ -10,42 +10,80 @@
 #define GUI_MSG_THREAD_H
 
 #include <atomic>
+#include <mutex>
+#include <vector>
 #include <QThread>
 #include "common.h"
+#include "gui_msg_coalescer.h"
+#include "gui_msg_pool.h"
+#include "ipc_recorder.h"
+#include "ipc_queue_health.h"
+
+class GuiMsgRing;
+
+// Constants
+constexpr uint GUI_MSG_MAX_HELD_URGENT_MSGS = 8;
+
+// Held urgent GUI message
+// An urgent message received before the normal messages sent before it, held
+// as received until they have been received
+struct GuiMsgHeldUrgentMsg
+{
+    uint len;
+    uint8_t buf[GUI_MSG_MAX_SIZE];
+};
+
+// GUI message lane stats
+// The wait is the time traced messages spent in the lane (sent to received)
+struct GuiMsgLaneStats
+{
+    uint64_t num_msgs;
+    LatencyHistogram wait;
+};
 
 // GUI Message Thread class
 class GuiMsgThread : public QThread
 {
 	Q_OBJECT
 public:
-    GuiMsgThread(QObject *parent);
+    GuiMsgThread(GuiMsgPool& pool, IpcRecorder& recorder, IpcQueueHealth& health, QObject *parent);
     ~GuiMsgThread();
     void run();
 
+    void take_msgs(std::vector<GuiMsgHandle>& msgs);
+    bool send_event(const GuiEventMsg& event);
+
 signals:
-    void left_status_msg(const LeftStatus& msg);
-    void layer_status_msg(const LayerStatus& msg);
-    void midi_status_msg(const MidiStatus& msg);
-    void tempo_status_msg(const TempoStatus& msg);
-    void home_screen_msg(const HomeScreen& msg);
-    void list_items_msg(const ListItems& msg);
-    void list_select_item_msg(const ListSelectItem& msg);
-    void soft_buttons_msg(const SoftButtons& msg);
-    void soft_buttons_state_msg(const SoftButtonsState& msg);
-    void param_update_msg(const ParamUpdate& msg);
-    void param_value_update_msg(const ParamValueUpdate& msg);
-    void enum_param_update_msg(const EnumParamUpdate& msg);
-    void enum_param_value_update_msg(const ListSelectItem& msg);
-    void edit_name_msg(const EditName& msg);
-    void edit_name_select_char_msg(const EditNameSelectChar& msg);
-    void edit_name_change_char_msg(const EditNameChangeChar& msg);
-    void confirmation_screen_msg(const ConfirmationScreen& msg);
-    void warning_screen_msg(const WarningScreen& msg);
-    void clear_boot_warning_msg();
-    void set_system_colour_msg(const SetSystemColour &msg);
+    void gui_msgs_ready();
 
 private:
+    GuiMsgPool& _pool;
+    IpcRecorder& _recorder;
+    IpcQueueHealth& _health;
     std::atomic<bool> _exit_gui_msgs_thread;
+    int _exit_event_fd;
+    int _event_queue_desc;
+    std::mutex _ring_mutex;
+    GuiMsgRing *_ring;
+    GuiMsgCoalescer _coalescer;
+    uint _num_traced;
+    GuiMsgLaneStats _lane_stats[NUM_GUI_MSG_LANES];
+    uint32_t _num_normal_msgs;
+    GuiMsgHeldUrgentMsg _held_urgent_msgs[GUI_MSG_MAX_HELD_URGENT_MSGS];
+    uint _held_urgent_head;
+    uint _num_held_urgent_msgs;
+    std::mutex _pending_msgs_mutex;
+    std::vector<GuiMsgHandle> _pending_msgs;
+    uint64_t _pending_since;
+
+    void _process_msg_queue();
+    void _process_ring(GuiMsgRing& ring, GuiMsgRing& urgent_ring);
+    bool _urgent_msg_ready(const uint8_t *msg_buf, uint len) const;
+    void _hold_urgent_msg(const uint8_t *msg_buf, uint len);
+    void _add_held_urgent_msgs(bool all);
+    void _add_msg(const uint8_t *msg_buf, uint len, GuiMsgLane lane);
+    void _process_batch();
+    void _print_stats();
 };
 
 #endif
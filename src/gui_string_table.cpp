@@ -0,0 +1,100 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  gui_string_table.cpp
+ * @brief GUI String Table class implementation.
+ *-----------------------------------------------------------------------------
+ */
+#include "gui_string_table.h"
+
+//----------------------------------------------------------------------------
+// GuiStringTable
+//----------------------------------------------------------------------------
+GuiStringTable::GuiStringTable()
+{
+    // Initialise class variables
+    _strings.reserve(GUI_MSG_MAX_INTERNED_STRINGS);
+}
+
+//----------------------------------------------------------------------------
+// intern
+//----------------------------------------------------------------------------
+void GuiStringTable::intern(uint id, const char *str)
+{
+    // Is this a new ID?
+    auto itr = _strings.find(id);
+    if (itr == _strings.end()) {
+        // Limit the number of interned strings
+        if (_strings.size() >= GUI_MSG_MAX_INTERNED_STRINGS) {
+            DEBUG_MSG("GuiStringTable: Too many interned strings, ignoring ID: " << id);
+            return;
+        }
+        _strings.emplace(id, std::string(str, ::strnlen(str, (STD_STR_LEN - 1))));
+        return;
+    }
+
+    // The ID has been re-interned, if the string has changed then its cached
+    // display texts are now stale
+    std::string new_str(str, ::strnlen(str, (STD_STR_LEN - 1)));
+    if (itr->second != new_str) {
+        itr->second = new_str;
+        for (auto dt_itr = _display_texts.begin(); dt_itr != _display_texts.end();) {
+            if ((dt_itr->first >> 32) == id)
+                dt_itr = _display_texts.erase(dt_itr);
+            else
+                dt_itr++;
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// resolve
+// Returns the interned string if the string is a reference to one, otherwise
+// the string itself
+//----------------------------------------------------------------------------
+const char *GuiStringTable::resolve(const char *str) const
+{
+    // Is this a reference? If so return the interned string, or an empty
+    // string if the ID is unknown
+    uint id;
+    if (!gui_msg_get_intern_ref(str, id))
+        return str;
+    auto itr = _strings.find(id);
+    return (itr != _strings.end()) ? itr->second.c_str() : "";
+}
+
+//----------------------------------------------------------------------------
+// display_text
+// Returns the cached display text, or nullptr if not cached
+//----------------------------------------------------------------------------
+const QString *GuiStringTable::display_text(uint id, int max_width, int font_size, bool wt_style) const
+{
+    auto itr = _display_texts.find(_display_key(id, max_width, font_size, wt_style));
+    return (itr != _display_texts.end()) ? &itr->second : nullptr;
+}
+
+//----------------------------------------------------------------------------
+// set_display_text
+//----------------------------------------------------------------------------
+void GuiStringTable::set_display_text(uint id, int max_width, int font_size, bool wt_style, const QString& text)
+{
+    // Only cache the display text of known IDs, and if the cache is full just
+    // start again (the texts in use are quickly re-cached)
+    if (_strings.find(id) == _strings.end())
+        return;
+    if (_display_texts.size() >= GUI_STRING_TABLE_MAX_DISPLAY_TEXTS)
+        _display_texts.clear();
+    _display_texts[_display_key(id, max_width, font_size, wt_style)] = text;
+}
+
+//----------------------------------------------------------------------------
+// _display_key
+//----------------------------------------------------------------------------
+uint64_t GuiStringTable::_display_key(uint id, int max_width, int font_size, bool wt_style)
+{
+    // The ID is in the top 32 bits, followed by the truncation style, font size
+    // (7 bits) and max width (24 bits, -1 for no max width)
+    return ((uint64_t)id << 32) | ((uint64_t)wt_style << 31) | ((uint64_t)(font_size & 0x7F) << 24) |
+           (uint64_t)((max_width + 1) & 0xFFFFFF);
+}
@@ -0,0 +1,46 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  gui_string_table.h
+ * @brief GUI String Table class definitions.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef GUI_STRING_TABLE_H
+#define GUI_STRING_TABLE_H
+
+#include <string>
+#include <unordered_map>
+#include <QString>
+#include "common.h"
+
+// Constants
+constexpr uint GUI_STRING_TABLE_MAX_DISPLAY_TEXTS = 8192;
+
+// GUI String Table class
+// The strings interned by the Nina UI app (INTERN_STRING), and a cache of the
+// display text computed for each interned string - the string truncated to
+// fit a width in a font. A repeated name is therefore only laid out once
+// Note: Only accessed from the GUI thread
+class GuiStringTable
+{
+public:
+    // Constructor
+    GuiStringTable();
+
+    // Public functions
+    void intern(uint id, const char *str);
+    const char *resolve(const char *str) const;
+    const QString *display_text(uint id, int max_width, int font_size, bool wt_style) const;
+    void set_display_text(uint id, int max_width, int font_size, bool wt_style, const QString& text);
+
+private:
+    // Private data
+    std::unordered_map<uint, std::string> _strings;
+    std::unordered_map<uint64_t, QString> _display_texts;
+
+    // Private functions
+    static uint64_t _display_key(uint id, int max_width, int font_size, bool wt_style);
+};
+
+#endif  // GUI_STRING_TABLE_H
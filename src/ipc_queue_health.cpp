@@ -0,0 +1,133 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  ipc_queue_health.cpp
+ * @brief IPC Queue Health class implementation.
+ *-----------------------------------------------------------------------------
+ */
+#include "ipc_queue_health.h"
+#include "gui_msg_latency.h"
+
+//----------------------------------------------------------------------------
+// IpcQueueHealth
+//----------------------------------------------------------------------------
+IpcQueueHealth::IpcQueueHealth(const char *name) :
+    _name(name)
+{
+    // Initialise class variables
+    _depth_units = "msgs";
+    _start_time = GuiMsgLatency::now();
+    _num_msgs = 0;
+    _num_errors = 0;
+    _depth = 0;
+    _high_water = 0;
+    _num_dropped = 0;
+    for (uint i=0; i<IPC_QUEUE_HEALTH_MAX_STREAMS; i++) {
+        _seq_valid[i] = false;
+        _max_seq[i] = 0;
+    }
+    _num_behind = 0;
+    _total_behind_us = 0;
+    _max_behind_us = 0;
+    _last_print_time = _start_time;
+    _last_print_msgs = 0;
+}
+
+//----------------------------------------------------------------------------
+// set_depth_units
+// The depth is in messages unless set (e.g. bytes for a ring)
+//----------------------------------------------------------------------------
+void IpcQueueHealth::set_depth_units(const char *depth_units)
+{
+    _depth_units = depth_units;
+}
+
+//----------------------------------------------------------------------------
+// received
+//----------------------------------------------------------------------------
+void IpcQueueHealth::received(uint num_msgs)
+{
+    _num_msgs.fetch_add(num_msgs, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// receive_error
+// Called for a receive error, or an invalid message
+//----------------------------------------------------------------------------
+void IpcQueueHealth::receive_error()
+{
+    _num_errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// set_depth
+// Called with the queue depth when the receiving thread wakes
+//----------------------------------------------------------------------------
+void IpcQueueHealth::set_depth(uint depth)
+{
+    _depth.store(depth, std::memory_order_relaxed);
+    if (depth > _high_water.load(std::memory_order_relaxed))
+        _high_water.store(depth, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// traced
+// Called with the sequence number of each traced message received, and the
+// stream it was received in - each stream has its own sequence numbers
+//----------------------------------------------------------------------------
+void IpcQueueHealth::traced(uint32_t seq, uint stream)
+{
+    if (stream >= IPC_QUEUE_HEALTH_MAX_STREAMS)
+        return;
+
+    // A gap in the sequence numbers means the producer dropped messages (e.g.
+    // the queue was full). If the sequence goes backwards the producer has
+    // restarted, so follow it from there
+    if (_seq_valid[stream].load(std::memory_order_relaxed)) {
+        int32_t gap = (int32_t)(seq - _max_seq[stream].load(std::memory_order_relaxed));
+        if (gap > 1)
+            _num_dropped.fetch_add((gap - 1), std::memory_order_relaxed);
+    }
+    else {
+        _seq_valid[stream].store(true, std::memory_order_relaxed);
+    }
+    _max_seq[stream].store(seq, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// behind
+// Called with how long received messages waited for the GUI thread
+//----------------------------------------------------------------------------
+void IpcQueueHealth::behind(uint64_t behind_us)
+{
+    _num_behind.fetch_add(1, std::memory_order_relaxed);
+    _total_behind_us.fetch_add(behind_us, std::memory_order_relaxed);
+    if (behind_us > _max_behind_us.load(std::memory_order_relaxed))
+        _max_behind_us.store(behind_us, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// print_stats
+//----------------------------------------------------------------------------
+void IpcQueueHealth::print_stats() const
+{
+    // Show the gauges, with the message rate since the stats were last shown
+    uint64_t now = GuiMsgLatency::now();
+    uint64_t num_msgs = _num_msgs.load(std::memory_order_relaxed);
+    uint64_t num_behind = _num_behind.load(std::memory_order_relaxed);
+    double elapsed_s = (now - _last_print_time) / 1000000000.0;
+    uint rate = (elapsed_s > 0.0) ? ((num_msgs - _last_print_msgs) / elapsed_s) : 0;
+    _last_print_time = now;
+    _last_print_msgs = num_msgs;
+    MSG("IpcQueueHealth: " << _name << ": depth: " << _depth.load(std::memory_order_relaxed) <<
+        " (high water: " << _high_water.load(std::memory_order_relaxed) << ") " << _depth_units.load() <<
+        ", msgs: " << num_msgs << " (" << rate << "/s)" <<
+        ", errors: " << _num_errors.load(std::memory_order_relaxed) <<
+        ", dropped (traced): " << _num_dropped.load(std::memory_order_relaxed));
+    if (num_behind) {
+        MSG("IpcQueueHealth: " << _name << ": GUI behind: avg: " <<
+            (_total_behind_us.load(std::memory_order_relaxed) / num_behind) << " max: " <<
+            _max_behind_us.load(std::memory_order_relaxed) << " us");
+    }
+}
@@ -0,0 +1,59 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  ipc_queue_health.h
+ * @brief IPC Queue Health class definitions.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef IPC_QUEUE_HEALTH_H
+#define IPC_QUEUE_HEALTH_H
+
+#include <atomic>
+#include "common.h"
+
+// Constants
+constexpr uint IPC_QUEUE_HEALTH_MAX_STREAMS = NUM_GUI_MSG_LANES;
+
+// IPC Queue Health class
+// Live gauges for an IPC queue (or ring) - the depth when the receiving thread
+// wakes and its high water mark, the message rate, receive errors, messages
+// dropped by the producer (gaps in the traced sequence numbers of each stream,
+// e.g. GUI message lane), and how long the received messages waited for the
+// GUI thread
+// Note: Updated from the receiving thread, and shown from the GUI thread
+class IpcQueueHealth
+{
+public:
+    // Constructor
+    IpcQueueHealth(const char *name);
+
+    // Public functions
+    void set_depth_units(const char *depth_units);
+    void received(uint num_msgs=1);
+    void receive_error();
+    void set_depth(uint depth);
+    void traced(uint32_t seq, uint stream=0);
+    void behind(uint64_t behind_us);
+    void print_stats() const;
+
+private:
+    // Private data
+    const char *_name;
+    std::atomic<const char *> _depth_units;
+    uint64_t _start_time;
+    std::atomic<uint64_t> _num_msgs;
+    std::atomic<uint64_t> _num_errors;
+    std::atomic<uint> _depth;
+    std::atomic<uint> _high_water;
+    std::atomic<uint64_t> _num_dropped;
+    std::atomic<bool> _seq_valid[IPC_QUEUE_HEALTH_MAX_STREAMS];
+    std::atomic<uint32_t> _max_seq[IPC_QUEUE_HEALTH_MAX_STREAMS];
+    std::atomic<uint64_t> _num_behind;
+    std::atomic<uint64_t> _total_behind_us;
+    std::atomic<uint64_t> _max_behind_us;
+    mutable uint64_t _last_print_time;
+    mutable uint64_t _last_print_msgs;
+};
+
+#endif  // IPC_QUEUE_HEALTH_H
@@ -0,0 +1,256 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  ipc_recorder.h
+ * @brief IPC Recorder and Reader class definitions and implementation.
+ *
+ * Records the messages received on the IPC queues to a binary log, so they
+ * can be replayed later with the nina_ipc_replay tool. The log is a file
+ * header followed by a record for each message:
+ *   - timestamp (uint64_t, ns since the recording started, CLOCK_MONOTONIC)
+ *   - queue (uint8_t, IpcQueue)
+ *   - length (uint32_t)
+ *   - the message, exactly as received
+ * Note: The log format is shared with the replay tool, and is therefore
+ * implemented in this header.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef IPC_RECORDER_H
+#define IPC_RECORDER_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include "common.h"
+
+// Constants
+constexpr char IPC_RECORD_FILE_ENV_VAR[]  = "NINA_GUI_RECORD_FILE";
+constexpr uint32_t IPC_RECORD_MAGIC       = 0x4345524E;     // "NREC"
+constexpr uint32_t IPC_RECORD_VERSION     = 1;
+constexpr uint IPC_RECORD_MAX_MSG_SIZE    = GUI_MSG_MAX_SIZE;
+
+// IPC queue
+enum IpcQueue : uint8_t
+{
+    GUI_MSG_QUEUE = 0,
+    SCOPE_SAMPLES_MSG_QUEUE,
+    GUI_MSG_URGENT_QUEUE
+};
+
+// IPC record file header
+struct IpcRecordFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+};
+
+// IPC record header
+struct __attribute__((packed)) IpcRecordHeader
+{
+    uint64_t timestamp;
+    IpcQueue queue;
+    uint32_t len;
+};
+
+// IPC Recorder class
+class IpcRecorder
+{
+public:
+    //----------------------------------------------------------------------------
+    // IpcRecorder
+    //----------------------------------------------------------------------------
+    IpcRecorder()
+    {
+        // Initialise class variables
+        _file = nullptr;
+        _start_time = 0;
+        _num_records = 0;
+    }
+
+    //----------------------------------------------------------------------------
+    // ~IpcRecorder
+    //----------------------------------------------------------------------------
+    ~IpcRecorder()
+    {
+        // Make sure the log is closed
+        close();
+    }
+
+    //----------------------------------------------------------------------------
+    // open
+    //----------------------------------------------------------------------------
+    bool open(const char *filename)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // Create the log and write the header
+        _file = std::fopen(filename, "wb");
+        if (!_file)
+            return false;
+        IpcRecordFileHeader header = { IPC_RECORD_MAGIC, IPC_RECORD_VERSION };
+        if (std::fwrite(&header, sizeof(header), 1, _file) != 1) {
+            std::fclose(_file);
+            _file = nullptr;
+            return false;
+        }
+        _start_time = _now();
+        _num_records = 0;
+        return true;
+    }
+
+    //----------------------------------------------------------------------------
+    // open_from_env
+    // Opens the log if the record file environment variable is set
+    //----------------------------------------------------------------------------
+    bool open_from_env()
+    {
+        const char *filename = std::getenv(IPC_RECORD_FILE_ENV_VAR);
+        if (!filename || (std::strlen(filename) == 0))
+            return false;
+        if (!open(filename)) {
+            MSG("IpcRecorder: ERROR: Could not create the record file: " << filename);
+            return false;
+        }
+        MSG("IpcRecorder: Recording IPC messages to: " << filename);
+        return true;
+    }
+
+    //----------------------------------------------------------------------------
+    // close
+    //----------------------------------------------------------------------------
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // Close the log if open
+        if (_file) {
+            std::fclose(_file);
+            _file = nullptr;
+            MSG("IpcRecorder: Recorded " << _num_records << " IPC messages");
+        }
+    }
+
+    //----------------------------------------------------------------------------
+    // is_open
+    //----------------------------------------------------------------------------
+    bool is_open() const
+    {
+        return _file != nullptr;
+    }
+
+    //----------------------------------------------------------------------------
+    // record
+    // Called by the message threads for each message received
+    //----------------------------------------------------------------------------
+    void record(IpcQueue queue, const void *msg, uint32_t len)
+    {
+        // Ignore if not recording, this check is done without the lock as the
+        // log is only opened/closed when the message threads are not running
+        if (!_file)
+            return;
+
+        // Write the record - note the log is buffered
+        std::lock_guard<std::mutex> lock(_mutex);
+        IpcRecordHeader header;
+        header.timestamp = _now() - _start_time;
+        header.queue = queue;
+        header.len = len;
+        if ((std::fwrite(&header, sizeof(header), 1, _file) == 1) &&
+            (std::fwrite(msg, len, 1, _file) == 1)) {
+            _num_records++;
+        }
+    }
+
+private:
+    // Private data
+    std::mutex _mutex;
+    FILE *_file;
+    uint64_t _start_time;
+    uint64_t _num_records;
+
+    //----------------------------------------------------------------------------
+    // _now
+    //----------------------------------------------------------------------------
+    static uint64_t _now()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+    }
+};
+
+// IPC Record Reader class
+class IpcRecordReader
+{
+public:
+    //----------------------------------------------------------------------------
+    // IpcRecordReader
+    //----------------------------------------------------------------------------
+    IpcRecordReader()
+    {
+        // Initialise class variables
+        _file = nullptr;
+    }
+
+    //----------------------------------------------------------------------------
+    // ~IpcRecordReader
+    //----------------------------------------------------------------------------
+    ~IpcRecordReader()
+    {
+        // Make sure the log is closed
+        if (_file)
+            std::fclose(_file);
+    }
+
+    //----------------------------------------------------------------------------
+    // open
+    //----------------------------------------------------------------------------
+    bool open(const char *filename)
+    {
+        IpcRecordFileHeader header;
+
+        // Open the log and check the header
+        _file = std::fopen(filename, "rb");
+        if (!_file)
+            return false;
+        if ((std::fread(&header, sizeof(header), 1, _file) != 1) ||
+            (header.magic != IPC_RECORD_MAGIC) || (header.version != IPC_RECORD_VERSION)) {
+            std::fclose(_file);
+            _file = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    //----------------------------------------------------------------------------
+    // rewind
+    //----------------------------------------------------------------------------
+    void rewind()
+    {
+        // Go back to the first record
+        std::fseek(_file, sizeof(IpcRecordFileHeader), SEEK_SET);
+    }
+
+    //----------------------------------------------------------------------------
+    // read
+    // Reads the next record, the message buffer must be IPC_RECORD_MAX_MSG_SIZE
+    // bytes. Returns false at the end of the log, or if the record is invalid
+    //----------------------------------------------------------------------------
+    bool read(IpcRecordHeader& header, uint8_t *msg)
+    {
+        if ((std::fread(&header, sizeof(header), 1, _file) != 1) ||
+            (header.len > IPC_RECORD_MAX_MSG_SIZE) ||
+            ((header.len > 0) && (std::fread(msg, header.len, 1, _file) != 1))) {
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // Private data
+    FILE *_file;
+};
+
+#endif  // IPC_RECORDER_H
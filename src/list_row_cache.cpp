@@ -0,0 +1,94 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  list_row_cache.cpp
+ * @brief List Row Cache class implementation.
+ *-----------------------------------------------------------------------------
+ */
+#include "list_row_cache.h"
+
+//----------------------------------------------------------------------------
+// ListRowCache
+//----------------------------------------------------------------------------
+ListRowCache::ListRowCache()
+{
+    // Initialise class variables
+    clear();
+}
+
+//----------------------------------------------------------------------------
+// clear
+//----------------------------------------------------------------------------
+void ListRowCache::clear()
+{
+    // Invalidate all entries
+    for (uint i=0; i<LIST_ROW_CACHE_SIZE; i++) {
+        _entries[i].valid = false;
+    }
+    _use_count = 0;
+}
+
+//----------------------------------------------------------------------------
+// get
+//----------------------------------------------------------------------------
+const ListRow *ListRowCache::get(uint index)
+{
+    // Find the row, and if found mark it as used
+    int i = _find(index);
+    if (i < 0)
+        return nullptr;
+    _entries[i].last_used = ++_use_count;
+    return &_entries[i].row;
+}
+
+//----------------------------------------------------------------------------
+// put
+//----------------------------------------------------------------------------
+void ListRowCache::put(uint index, const char *text, bool enabled)
+{
+    // Replace the row if it is already cached
+    int i = _find(index);
+    if (i < 0) {
+        // Use an empty entry, or replace the least recently used entry
+        i = 0;
+        for (uint j=0; j<LIST_ROW_CACHE_SIZE; j++) {
+            if (!_entries[j].valid) {
+                i = j;
+                break;
+            }
+            if (_entries[j].last_used < _entries[i].last_used)
+                i = j;
+        }
+    }
+
+    // Set the row
+    _entries[i].valid = true;
+    _entries[i].index = index;
+    _entries[i].last_used = ++_use_count;
+    std::strncpy(_entries[i].row.text, text, (STD_STR_LEN - 1));
+    _entries[i].row.text[STD_STR_LEN - 1] = '\0';
+    _entries[i].row.enabled = enabled;
+}
+
+//----------------------------------------------------------------------------
+// contains
+//----------------------------------------------------------------------------
+bool ListRowCache::contains(uint index) const
+{
+    return _find(index) >= 0;
+}
+
+//----------------------------------------------------------------------------
+// _find
+//----------------------------------------------------------------------------
+int ListRowCache::_find(uint index) const
+{
+    // Search the entries for this row - the cache is small, so a linear
+    // search is used
+    for (uint i=0; i<LIST_ROW_CACHE_SIZE; i++) {
+        if (_entries[i].valid && (_entries[i].index == index))
+            return i;
+    }
+    return -1;
+}
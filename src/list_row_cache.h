@@ -0,0 +1,59 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  list_row_cache.h
+ * @brief List Row Cache class definitions.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef LIST_ROW_CACHE_H
+#define LIST_ROW_CACHE_H
+
+#include "common.h"
+
+// Constants
+constexpr uint LIST_ROW_CACHE_SIZE = 64;
+
+// List row
+struct ListRow
+{
+    char text[STD_STR_LEN];
+    bool enabled;
+};
+
+// List Row Cache class
+// Fixed size cache of the rows of a windowed list, indexed by the row index in
+// the full list. When full, the least recently used row is replaced - as the
+// rows around the cursor are used every time the list is shown, these are
+// kept
+class ListRowCache
+{
+public:
+    // Constructor
+    ListRowCache();
+
+    // Public functions
+    void clear();
+    const ListRow *get(uint index);
+    void put(uint index, const char *text, bool enabled);
+    bool contains(uint index) const;
+
+private:
+    // Cache entry
+    struct _Entry
+    {
+        bool valid;
+        uint index;
+        uint64_t last_used;
+        ListRow row;
+    };
+
+    // Private data
+    _Entry _entries[LIST_ROW_CACHE_SIZE];
+    uint64_t _use_count;
+
+    // Private functions
+    int _find(uint index) const;
+};
+
+#endif  // LIST_ROW_CACHE_H
@@ -25,6 +25,7 @@ QString _get_system_colour();
 QPixmap _set_pixmap_colour(const QPixmap& pixmap, QColor colour);
 void _print_nina_gui_info();
 void _sigint_handler([[maybe_unused]] int sig);
+void _sigusr1_handler([[maybe_unused]] int sig);
 
 //----------------------------------------------------------------------------
 // main
@@ -56,6 +57,9 @@ int main(int argc, char *argv[ ])
     signal(SIGINT, _sigint_handler);
     signal(SIGTERM, _sigint_handler);
 
+    // Setup the show stats signal handler (e.g. kill -USR1)
+    signal(SIGUSR1, _sigusr1_handler);
+
     // Show the app info
     _print_nina_gui_info();
 
@@ -153,3 +157,12 @@ void _sigint_handler([[maybe_unused]] int sig)
     // Quit the QT app and clean everything up
     qApp->quit();
 }
+
+//----------------------------------------------------------------------------
+// _sigusr1_handler
+//----------------------------------------------------------------------------
+void _sigusr1_handler([[maybe_unused]] int sig)
+{
+    // Show the GUI stats
+    MainWindow::request_print_stats();
+}
@@ -9,6 +9,8 @@
 #include <QFontDatabase>
 #include <QHeaderView>
 #include <QMovie>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include "main_window.h"
 #include "common.h"
 #include "version.h"
@@ -39,7 +41,9 @@ constexpr uint LIST_MARGIN_LEFT          = VISIBLE_LCD_MARGIN_LEFT;
 constexpr uint LIST_MARGIN_TOP           = (LEFT_STATUS_MARGIN_TOP + LEFT_STATUS_HEIGHT + 1);
 constexpr uint LIST_WIDTH                = VISIBLE_LCD_WIDTH;
 constexpr uint LIST_ROW_HEIGHT           = 48;
-constexpr uint LIST_HEIGHT               = (7 * LIST_ROW_HEIGHT);
+constexpr uint LIST_VISIBLE_ROWS         = 7;
+constexpr uint LIST_HEIGHT               = (LIST_VISIBLE_ROWS * LIST_ROW_HEIGHT);
+constexpr uint LIST_PREFETCH_ROWS        = 3;
 constexpr uint LIST_FONT_SIZE            = 30;
 constexpr uint WT_LIST_WIDTH             = (VISIBLE_LCD_WIDTH/2);
 constexpr uint WT_CHART_MARGIN_LEFT      = (LIST_MARGIN_LEFT + WT_LIST_WIDTH + 10);
@@ -87,8 +91,12 @@ constexpr uint SCOPE_HEIGHT                    = (VISIBLE_LCD_HEIGHT - SCOPE_MAR
 constexpr uint OSC_SCOPE_WIDTH                 = VISIBLE_LCD_WIDTH;
 constexpr uint XY_SCOPE_WIDTH                  = SCOPE_HEIGHT;
 constexpr uint OSC_SCOPE_MARGIN_LEFT           = VISIBLE_LCD_MARGIN_LEFT;
+constexpr uint DEFERRED_VISIBILITY_SIZE        = 96;
 constexpr uint XY_SCOPE_MARGIN_LEFT            = VISIBLE_LCD_MARGIN_LEFT + ((VISIBLE_LCD_WIDTH - XY_SCOPE_WIDTH) / 2);
 
+// Static variables
+int MainWindow::_print_stats_event_fd = -1;
+
 #ifdef SPI_STATUS_MONITOR
 constexpr uint SPI_STATUS_MARGIN_RIGHT   = 10;
 constexpr uint SPI_STATUS_MARGIN_TOP     = 0;
@@ -101,25 +109,20 @@ constexpr uint SPI_STATUS_FONT_SIZE      = 35;
 //----------------------------------------------------------------------------
 MainWindow::MainWindow(QString system_colour_str, QColor system_colour, QWidget *parent) : QMainWindow(parent)
 {
-    // Register the meta types
-    qRegisterMetaType<LeftStatus>();
-    qRegisterMetaType<LayerStatus>();
-    qRegisterMetaType<MidiStatus>();
-    qRegisterMetaType<TempoStatus>();
-    qRegisterMetaType<HomeScreen>();
-    qRegisterMetaType<ListItems>();
-    qRegisterMetaType<ListSelectItem>();
-    qRegisterMetaType<SoftButtons>();
-    qRegisterMetaType<SoftButtonsState>();
-    qRegisterMetaType<ParamUpdate>();
-    qRegisterMetaType<ParamValueUpdate>();
-    qRegisterMetaType<EnumParamUpdate>();
-    qRegisterMetaType<EditName>();
-    qRegisterMetaType<EditNameSelectChar>();
-    qRegisterMetaType<EditNameChangeChar>();
-    qRegisterMetaType<ConfirmationScreen>();
-    qRegisterMetaType<WarningScreen>();
-    qRegisterMetaType<SetSystemColour>();
+    // Reserve the GUI message batch, so it is not allocated when processing messages
+    _gui_msgs.reserve(GUI_MSG_POOL_SIZE);
+    _deferred_visibility.reserve(DEFERRED_VISIBILITY_SIZE);
+    _processing_gui_msgs = false;
+    _wt_chart_flush_pending = false;
+    _list_id = GuiListId::LIST_ID_MAIN_AREA;
+    _list_version = 0;
+    _list_resync_requested = false;
+    _list_has_state = false;
+    _list_windowed = false;
+    _list_serial = 0;
+    _list_total_items = 0;
+    _list_selected_item = 0;
+    _list_requested_item = -1;
 
     // Add the Melbourne Instruments specific fonts
     QFontDatabase::addApplicationFont(OCR_B_FONT_RES);
@@ -137,36 +140,29 @@ MainWindow::MainWindow(QString system_colour_str, QColor system_colour, QWidget
     // Set the default Scope mode to OFF
     _scope_mode = GuiScopeMode::SCOPE_MODE_OFF; 
 
+    // Record the IPC messages if a record file is specified
+    _ipc_recorder.open_from_env();
+
     // Create the thread to process incoming GUI messages from the Nina UI App, and connect
-    // to this thread
-    _gui_thread = new GuiMsgThread(this);
-    connect(_gui_thread, SIGNAL(left_status_msg(LeftStatus)), this, SLOT(set_left_status(LeftStatus)));
-    connect(_gui_thread, SIGNAL(layer_status_msg(LayerStatus)), this, SLOT(set_layer_status(LayerStatus)));
-    connect(_gui_thread, SIGNAL(midi_status_msg(MidiStatus)), this, SLOT(set_midi_status(MidiStatus)));
-    connect(_gui_thread, SIGNAL(tempo_status_msg(TempoStatus)), this, SLOT(set_tempo_status(TempoStatus)));
-    connect(_gui_thread, SIGNAL(home_screen_msg(HomeScreen)), this, SLOT(show_home_screen(HomeScreen)));
-    connect(_gui_thread, SIGNAL(list_items_msg(ListItems)), this, SLOT(show_list_items(ListItems)));
-    connect(_gui_thread, SIGNAL(list_select_item_msg(ListSelectItem)), this, SLOT(list_select_item(ListSelectItem)));
-    connect(_gui_thread, SIGNAL(soft_buttons_msg(SoftButtons)), this, SLOT(set_soft_buttons(SoftButtons)));
-    connect(_gui_thread, SIGNAL(soft_buttons_state_msg(SoftButtonsState)), this, SLOT(set_soft_buttons_state(SoftButtonsState)));
-    connect(_gui_thread, SIGNAL(param_update_msg(ParamUpdate)), this, SLOT(process_param_update(ParamUpdate)));
-    connect(_gui_thread, SIGNAL(param_value_update_msg(ParamValueUpdate)), this, SLOT(process_param_value_update(ParamValueUpdate)));
-    connect(_gui_thread, SIGNAL(enum_param_update_msg(EnumParamUpdate)), this, SLOT(process_enum_param_update(EnumParamUpdate)));
-    connect(_gui_thread, SIGNAL(enum_param_value_update_msg(ListSelectItem)), this, SLOT(process_enum_param_value_update(ListSelectItem)));
-    connect(_gui_thread, SIGNAL(edit_name_msg(EditName)), this, SLOT(process_edit_name(EditName)));
-    connect(_gui_thread, SIGNAL(edit_name_select_char_msg(EditNameSelectChar)), this, SLOT(process_edit_name_select_char(EditNameSelectChar)));
-    connect(_gui_thread, SIGNAL(edit_name_change_char_msg(EditNameChangeChar)), this, SLOT(process_edit_name_change_char(EditNameChangeChar)));
-    connect(_gui_thread, SIGNAL(confirmation_screen_msg(ConfirmationScreen)), this, SLOT(show_confirmation_screen(ConfirmationScreen)));
-    connect(_gui_thread, SIGNAL(warning_screen_msg(WarningScreen)), this, SLOT(show_warning_screen(WarningScreen)));
-    connect(_gui_thread, SIGNAL(clear_boot_warning_msg()), this, SLOT(clear_boot_warning()));
-    connect(_gui_thread, SIGNAL(set_system_colour_msg(SetSystemColour)), this, SLOT(set_system_colour(SetSystemColour)));
+    // to this thread - the messages are delivered in batches
+    _gui_thread = new GuiMsgThread(_gui_msg_pool, _ipc_recorder, _gui_msg_queue_health, this);
+    connect(_gui_thread, SIGNAL(gui_msgs_ready()), this, SLOT(process_gui_msgs()));
     _gui_thread->start();
 
     // Start the samples thread
-    _scope_thread = new ScopeMsgThread(_scope_data_source, this);
+    _scope_thread = new ScopeMsgThread(_scope_data_source, _ipc_recorder, _scope_msg_queue_health, this);
     _scope_thread->start();
     _conf_screen_timer = new Timer(TimerType::ONE_SHOT);
 
+    // Create the event used to show the stats (e.g. on SIGUSR1) - the event is
+    // signalled from the signal handler, and the stats shown from the GUI thread
+    _print_stats_notifier = nullptr;
+    _print_stats_event_fd = ::eventfd(0, (EFD_CLOEXEC | EFD_NONBLOCK));
+    if (_print_stats_event_fd != -1) {
+        _print_stats_notifier = new QSocketNotifier(_print_stats_event_fd, QSocketNotifier::Read, this);
+        connect(_print_stats_notifier, &QSocketNotifier::activated, this, &MainWindow::print_stats);
+    }
+
     // Create the SPI monitor thread, and connect to the thread
 #ifdef SPI_STATUS_MONITOR
     _spi_thread = new SpiMonitorThread(this);
@@ -183,6 +179,20 @@ MainWindow::~MainWindow()
     // Delete and stop the scope and GUI threads
     delete _scope_thread;
     delete _gui_thread;
+    _ipc_recorder.close();
+    print_stats();
+
+    // Close the print stats event
+    if (_print_stats_event_fd != -1) {
+        int fd = _print_stats_event_fd;
+        _print_stats_event_fd = -1;
+        delete _print_stats_notifier;
+        ::close(fd);
+    }
+
+    // Discard any pending GUI messages, so that their pooled messages are
+    // released before the pool is destroyed
+    QCoreApplication::removePostedEvents(this);
 
     // Note QT handles the deletion of other allocated objects
 }
@@ -197,6 +207,121 @@ void MainWindow::set_system_colour(QString colour_str, QColor colour)
     _system_colour = colour;
 }
 
+//----------------------------------------------------------------------------
+// request_print_stats
+// Note: Can be called from a signal handler
+//----------------------------------------------------------------------------
+void MainWindow::request_print_stats()
+{
+    // Signal the print stats event
+    if (_print_stats_event_fd != -1) {
+        uint64_t event = 1;
+        (void)::write(_print_stats_event_fd, &event, sizeof(event));
+    }
+}
+
+//----------------------------------------------------------------------------
+// print_stats
+//----------------------------------------------------------------------------
+void MainWindow::print_stats()
+{
+    // Clear the print stats event (if signalled)
+    if (_print_stats_event_fd != -1) {
+        uint64_t event;
+        (void)::read(_print_stats_event_fd, &event, sizeof(event));
+    }
+
+    // Show the GUI stats
+    _gui_msg_pool.print_stats();
+    _gui_msg_latency.print_stats();
+    _gui_msg_queue_health.print_stats();
+    _scope_msg_queue_health.print_stats();
+    _scope_data_source.print_stats();
+    _scope->print_stats("OSC");
+    _wt_scope->print_stats("WT");
+#ifdef GUI_HANDLER_PROFILING
+    _handler_profiler.print_stats();
+#endif
+}
+
+//----------------------------------------------------------------------------
+// process_gui_msgs
+//----------------------------------------------------------------------------
+void MainWindow::process_gui_msgs()
+{
+    // Ignore if already processing the GUI messages - this can happen if the
+    // event loop is run while processing, the messages are picked up below
+    if (_processing_gui_msgs)
+        return;
+    GUI_HANDLER_PROFILE(_handler_profiler, GUI_HANDLER_PROCESS_GUI_MSGS);
+
+    // Defer any visibility changes until the end of the batch, so that each
+    // batch is laid out once - only the widgets changed are repainted
+    _processing_gui_msgs = true;
+
+    // Process the pending messages, in order, until there are none left
+    bool ack[NUM_GUI_MSG_LANES] = {};
+    uint32_t ack_seq[NUM_GUI_MSG_LANES] = {};
+    _gui_thread->take_msgs(_gui_msgs);
+    while (_gui_msgs.size())
+    {
+        for (const GuiMsgHandle& handle : _gui_msgs) {
+            // If the message is traced, measure when it is started and applied
+            auto timing = handle.timing();
+            if (timing->traced) {
+                timing->started = GuiMsgLatency::now();
+                _process_gui_msg(*handle);
+                timing->applied = GuiMsgLatency::now();
+                _gui_msg_latency.applied(*timing);
+
+                // If the sender is flow controlled, note the applied seq in
+                // the message lane
+                if (timing->ack) {
+                    ack[timing->lane] = true;
+                    ack_seq[timing->lane] = timing->seq;
+                }
+            }
+            else {
+                _process_gui_msg(*handle);
+            }
+        }
+
+        // Release the messages back to the pool, and check for any more
+        _gui_msgs.clear();
+        _gui_thread->take_msgs(_gui_msgs);
+    }
+
+    // Tell the sender the messages applied in each lane (if flow controlled),
+    // so it can send any held value updates
+    for (uint i=0; i<NUM_GUI_MSG_LANES; i++) {
+        if (ack[i]) {
+            GuiEventMsg event;
+            event.type = GuiEventType::GUI_MSGS_APPLIED;
+            event.gui_msgs_applied.lane = (GuiMsgLane)i;
+            event.gui_msgs_applied.seq = ack_seq[i];
+            _gui_thread->send_event(event);
+        }
+    }
+
+    // Commit the visibility changes
+    _processing_gui_msgs = false;
+    _commit_deferred_visibility();
+}
+
+//----------------------------------------------------------------------------
+// event
+//----------------------------------------------------------------------------
+bool MainWindow::event(QEvent *event)
+{
+    // Process the event - if it was an update request, the window has now been
+    // repainted and flushed (on eglfs this includes the buffer swap), so any
+    // applied traced messages have been presented
+    bool res = QMainWindow::event(event);
+    if (event->type() == QEvent::UpdateRequest)
+        _gui_msg_latency.presented();
+    return res;
+}
+
 //----------------------------------------------------------------------------
 // set_left_status
 //----------------------------------------------------------------------------
@@ -212,7 +337,7 @@ void MainWindow::set_left_status(const LeftStatus& msg)
 void MainWindow::set_layer_status(const LayerStatus& msg)
 {
     // Update the Layer Status
-    _layer_status->setText(msg.status);
+    _layer_status->setText(_string_table.resolve(msg.status));
 }
 
 //----------------------------------------------------------------------------
@@ -222,8 +347,8 @@ void MainWindow::set_midi_status(const MidiStatus& msg)
 {
     // Update the MIDI status
     (msg.midi_active) ?
-        _midi_status->setVisible(true) :
-        _midi_status->setVisible(false);
+        _set_visible(_midi_status, true) :
+        _set_visible(_midi_status, false);
 }
 
 //----------------------------------------------------------------------------
@@ -232,7 +357,7 @@ void MainWindow::set_midi_status(const MidiStatus& msg)
 void MainWindow::set_tempo_status(const TempoStatus& msg)
 {
     // Update the Tempo Status
-    _tempo_status->setText(msg.tempo_string);
+    _tempo_status->setText(_string_table.resolve(msg.tempo_string));
 }
 
 //----------------------------------------------------------------------------
@@ -257,6 +382,7 @@ void MainWindow::show_home_screen(const HomeScreen& msg)
     }
     _show_default_background(true, true);
     _show_list_obj(false);
+    _list_release();
     //_show_soft_buttons(false);
     _show_param_obj(false);
     _show_enum_param_list_obj(false);
@@ -281,6 +407,11 @@ void MainWindow::show_list_items(const ListItems& msg)
         _list_items.clear();
         _list_items_enabled.clear();
         _list_items_separator.clear();
+        _list_id = GuiListId::LIST_ID_MAIN_AREA;
+        _list_version = 0;
+        _list_resync_requested = false;
+        _list_has_state = msg.process_enabled_state;
+        _list_window_reset();
         for (uint i=0; i<msg.num_items; i++) {
             // Special case!
             if (std::strcmp(msg.items[i], "GUI_VER") == 0) {
@@ -327,6 +458,15 @@ void MainWindow::show_list_items(const ListItems& msg)
 //----------------------------------------------------------------------------
 void MainWindow::list_select_item(const ListSelectItem& msg)
 {
+    // If the list is windowed, select the item in the full list
+    if (_list_windowed) {
+        if (msg.selected_item < _list_total_items) {
+            _list_selected_item = msg.selected_item;
+            _list_window_update();
+        }
+        return;
+    }
+
     // List - check the selected item is within range
     if (msg.selected_item < (uint)_main_area_list->count()) 
     {
@@ -342,7 +482,10 @@ void MainWindow::list_select_item(const ListSelectItem& msg)
             index = 3;
         _main_area_list->scrollToItem(_main_area_list->item(index), QAbstractItemView::PositionAtCenter);
 
-        if ((_list_items.size() > 0) && (_list_items_enabled.size() > 0)) {
+        // Note: Only if the list state is for this list (another screen may have
+        // replaced it)
+        if ((_list_id == GuiListId::LIST_ID_MAIN_AREA) && (_list_items.size() >= (uint)_main_area_list->count()) &&
+            (_list_items_enabled.size() >= (uint)_main_area_list->count())) {
             for (uint i=0; i<(uint)_main_area_list->count(); i++) {
                 auto item = reinterpret_cast<QLabel *>(_main_area_list->itemWidget(_main_area_list->item(i)));
                 _list_label_set_text(item, _list_items[i].c_str(), (i == msg.selected_item), _list_items_enabled[i], false);
@@ -351,6 +494,157 @@ void MainWindow::list_select_item(const ListSelectItem& msg)
     }
 }
 
+//----------------------------------------------------------------------------
+// process_list_items_delta
+//----------------------------------------------------------------------------
+void MainWindow::process_list_items_delta(const ListItemsDelta& msg)
+{
+    // Check the delta is the next delta for the current list, if not ignore it
+    // If it is for the current list but out of sequence, request the Nina UI
+    // app sends the full list again (once, until the full list is received)
+    if ((msg.list_id != _list_id) || (msg.version != _list_version) ||
+        ((_list_id == GuiListId::LIST_ID_MAIN_AREA) && _list_windowed)) {
+        DEBUG_MSG("MainWindow: List delta ignored, list: " << msg.list_id << " version: " << msg.version);
+        if ((msg.list_id == _list_id) && (msg.version != _list_version)) {
+            _list_request_resync();
+        }
+        return;
+    }
+
+    // Set a pointer to the list object to update
+    auto list = (_list_id == GuiListId::LIST_ID_PARAMS) ? _params_list : _main_area_list;
+    uint count = list->count();
+    int current_row = list->currentRow();
+
+    // Process the delta operation - if the operation is rejected (e.g. the
+    // index is out of range) the list is out of sync, so request the full list
+    switch (msg.op)
+    {
+        case GuiListOp::LIST_OP_INSERT:
+            // Insert a new row
+            if ((msg.index > count) || (count >= LIST_MAX_ITEMS)) {
+                _list_request_resync();
+                return;
+            }
+            _list_insert_item(list, msg.index, msg.item, msg.enabled, msg.separator);
+            break;
+
+        case GuiListOp::LIST_OP_UPDATE:
+            // Replace the row text and state
+            if (msg.index >= count) {
+                _list_request_resync();
+                return;
+            }
+            if (_list_has_state) {
+                _label_set_text(_dummy_label, msg.item, _list_text_width(list));
+                _list_items[msg.index] = _dummy_label->text().toStdString();
+                _list_items_enabled[msg.index] = msg.enabled;
+                _list_items_separator[msg.index] = msg.separator;
+                _list_refresh_item(list, msg.index);
+            }
+            else {
+                _label_set_text(_dummy_label, msg.item, _list_text_width(list));
+                list->item(msg.index)->setText(_dummy_label->text());
+            }
+            break;
+
+        case GuiListOp::LIST_OP_REMOVE:
+            // Remove the row
+            if (msg.index >= count) {
+                _list_request_resync();
+                return;
+            }
+            delete list->takeItem(msg.index);
+            if (_list_has_state) {
+                _list_items.erase(_list_items.begin() + msg.index);
+                _list_items_enabled.erase(_list_items_enabled.begin() + msg.index);
+                _list_items_separator.erase(_list_items_separator.begin() + msg.index);
+            }
+            break;
+
+        case GuiListOp::LIST_OP_SET_ENABLED:
+            // Change the row enabled state
+            if (msg.index >= count) {
+                _list_request_resync();
+                return;
+            }
+            if (_list_has_state) {
+                _list_items_enabled[msg.index] = msg.enabled;
+                _list_refresh_item(list, msg.index);
+            }
+            break;
+
+        default:
+            // Ignore any unknown operations
+            return;
+    }
+    _list_version++;
+
+    // If the current row has changed (the current row was removed), make sure
+    // the new current row is shown as selected
+    if (_list_has_state && (list->currentRow() != current_row) && (list->currentRow() >= 0)) {
+        _list_refresh_item(list, list->currentRow());
+    }
+}
+
+//----------------------------------------------------------------------------
+// process_list_window
+//----------------------------------------------------------------------------
+void MainWindow::process_list_window(const ListWindow& msg)
+{
+    // Is this a new list? The visible rows are also re-created if another list
+    // has replaced them
+    if (!_list_windowed || (msg.list_serial != _list_serial) ||
+        (_list_id != GuiListId::LIST_ID_MAIN_AREA) || (_list_items.size() != LIST_VISIBLE_ROWS)) {
+        // Create the visible rows - these are re-used as the list is scrolled,
+        // so the number of rows is fixed regardless of the list size
+        // Note: If the list has items, scroll to the start of the list to reset the scroll
+        if (_main_area_list->count()) {
+            _main_area_list->scrollToItem(_main_area_list->item(0), QAbstractItemView::PositionAtCenter);
+        }
+        _main_area_list->clear();
+        _list_items.clear();
+        _list_items_enabled.clear();
+        _list_items_separator.clear();
+        for (uint i=0; i<LIST_VISIBLE_ROWS; i++) {
+            _list_add_item(_main_area_list, "", LIST_WIDTH-40, false, true);
+        }
+        _list_row_cache.clear();
+        _list_id = GuiListId::LIST_ID_MAIN_AREA;
+        _list_version = 0;
+        _list_resync_requested = false;
+        _list_has_state = true;
+        _list_windowed = true;
+        _list_serial = msg.list_serial;
+        _list_requested_item = -1;
+
+        // Show the list
+        _show_list_obj(true);
+        _show_default_background(false, false);
+        _show_param_obj(false);
+        _show_enum_param_list_obj(false);
+        _show_edit_name_obj(false);        
+    }
+    _list_total_items = msg.total_items;
+    if (msg.selected_item < msg.total_items) {
+        _list_selected_item = msg.selected_item;
+    }
+
+    // Add the rows to the cache
+    for (uint i=0; (i<msg.num_items) && (i<LIST_WINDOW_MAX_ITEMS); i++) {
+        _label_set_text(_dummy_label, msg.items[i], LIST_WIDTH-40);
+        _list_row_cache.put((msg.first_item + i), _dummy_label->text().toStdString().c_str(), msg.list_item_enabled[i]);
+    }
+
+    // If this window was requested, the request has been completed
+    if ((int)msg.first_item == _list_requested_item) {
+        _list_requested_item = -1;
+    }
+
+    // Update the visible rows
+    _list_window_update();
+}
+
 //----------------------------------------------------------------------------
 // set_soft_buttons
 //----------------------------------------------------------------------------
@@ -361,18 +655,18 @@ void MainWindow::set_soft_buttons(const SoftButtons& msg)
         (std::strlen(msg.button2) == 0) &&
         (std::strlen(msg.button3) == 0)) {
         // Hide the soft buttons
-        _soft_button1->setVisible(false);
-        _soft_button2->setVisible(false);
-        _soft_button3->setVisible(false);
+        _set_visible(_soft_button1, false);
+        _set_visible(_soft_button2, false);
+        _set_visible(_soft_button3, false);
     }
     else {
         // Update the soft buttons text
         _set_soft_button_text(_soft_button1, msg.button1);
         _set_soft_button_text(_soft_button2, msg.button2); 
         _set_soft_button_text(_soft_button3, msg.button3);
-        _soft_button1->setVisible(true);
-        _soft_button2->setVisible(true);
-        _soft_button3->setVisible(true);        
+        _set_visible(_soft_button1, true);
+        _set_visible(_soft_button2, true);
+        _set_visible(_soft_button3, true);        
     }
 }
 
@@ -400,14 +694,14 @@ void MainWindow::process_param_update(const ParamUpdate& msg)
     if (std::strlen(msg.display_string) > 0) 
     {
         // Show the param value as a text string
-        str = msg.display_string;
+        str = _string_table.resolve(msg.display_string);
         _param_value->setFont(QFont(STANDARD_FONT_NAME, PARAM_VALUE_TXT_FONT_SIZE));
         _param_value->setText(str);              
     }
     else 
     {
         // Show the param value as a numerical value
-        str = msg.value_string;
+        str = _string_table.resolve(msg.value_string);
         _param_value->setFont(QFont(PARAM_VALUE_FONT_NAME, PARAM_VALUE_NUM_FONT_SIZE));
         _param_value->setText(str);
     }
@@ -427,8 +721,8 @@ void MainWindow::process_param_update(const ParamUpdate& msg)
     _param_value->setGeometry (x, y, width, _param_value->height());
 
     if (std::strlen(msg.value_tag) > 0) {
-        str = msg.value_tag;
-        _param_value_tag->setText(msg.value_tag);
+        str = _string_table.resolve(msg.value_tag);
+        _param_value_tag->setText(str);
         _param_value_tag->adjustSize();
         uint width = _param_value_tag->width();
         while (width > PARAM_VALUE_WIDTH) {
@@ -441,12 +735,12 @@ void MainWindow::process_param_update(const ParamUpdate& msg)
         x = (VISIBLE_LCD_WIDTH - _param_value_tag->width() - 20);
         y += _param_value->height() + 10;
         _param_value_tag->setGeometry (x, y, _param_value_tag->width(), _param_value_tag->height());
-        _param_value_tag->setVisible(true);  
+        _set_visible(_param_value_tag, true);  
     }
     else {
         _param_value_tag->setText("");
         _param_value_tag->adjustSize();
-        _param_value_tag->setVisible(false); 
+        _set_visible(_param_value_tag, false); 
     }
     if ((uint)_param_value_tag->width() > width)
         width = _param_value_tag->width();
@@ -460,6 +754,11 @@ void MainWindow::process_param_update(const ParamUpdate& msg)
     _list_items.clear();
     _list_items_enabled.clear();
     _list_items_separator.clear();
+    _list_id = GuiListId::LIST_ID_PARAMS;
+    _list_version = 0;
+    _list_resync_requested = false;
+    _list_has_state = true;
+    _list_window_reset();
 
     for (uint i=0; i<msg.num_items; i++) {
         _label_set_text(_dummy_label, msg.list_items[i], PARAM_LIST_WIDTH-30);
@@ -479,7 +778,7 @@ void MainWindow::process_param_update(const ParamUpdate& msg)
         _params_list->setCurrentRow(msg.selected_item);
     else
         _params_list->setCurrentRow(0);
-    _params_list->setVisible(true);
+    _set_visible(_params_list, true);
 
     // Trick to make QT scroll LOGICALLY and CONSISTENTLY (duh)
     // Note this assumes that there are 6 items shown in the list
@@ -490,23 +789,23 @@ void MainWindow::process_param_update(const ParamUpdate& msg)
         index = 3;
     _params_list->scrollToItem(_params_list->item(index), QAbstractItemView::PositionAtCenter);
 
-    if (_enum_param_list->isVisible() || _wt_enum_param_list->isVisible()) {
+    if (_is_visible(_enum_param_list) || _is_visible(_wt_enum_param_list)) {
         _show_enum_param_list_obj(false);
     } 
     _show_param_obj(true);
-    if (_default_background->isVisible() || (_scope->display_mode() == ScopeDisplayMode::FOREGROUND)) {
+    if (_is_visible(_default_background) || (_scope->display_mode() == ScopeDisplayMode::FOREGROUND)) {
         _show_default_background(false, msg.show_scope);
     }
     _show_list_obj(false);
     _show_edit_name_obj(false);
 
     if (msg.num_items == 0) {
-        _param_value->setVisible(false);
+        _set_visible(_param_value, false);
         _set_soft_button_text(_soft_button2, "----"); 
         _set_soft_button_text(_soft_button3, "----");             
     }
     else {
-        _param_value->setVisible(true);          
+        _set_visible(_param_value, true);          
     }
 }
 
@@ -520,14 +819,14 @@ void MainWindow::process_param_value_update(const ParamValueUpdate& msg)
     if (std::strlen(msg.display_string) > 0) 
     {
         // Show the param value as a text string
-        str = msg.display_string;
+        str = _string_table.resolve(msg.display_string);
         _param_value->setFont(QFont(STANDARD_FONT_NAME, PARAM_VALUE_TXT_FONT_SIZE));
         _param_value->setText(str);              
     }
     else 
     {
         // Show the param value as a numerical value
-        str = msg.value_string;
+        str = _string_table.resolve(msg.value_string);
         _param_value->setFont(QFont(PARAM_VALUE_FONT_NAME, PARAM_VALUE_NUM_FONT_SIZE));
         _param_value->setText(str);
     }
@@ -547,8 +846,8 @@ void MainWindow::process_param_value_update(const ParamValueUpdate& msg)
     _param_value->setGeometry(x, y, width, _param_value->height());
 
     if (std::strlen(msg.value_tag) > 0) {
-        str = msg.value_tag;
-        _param_value_tag->setText(msg.value_tag);
+        str = _string_table.resolve(msg.value_tag);
+        _param_value_tag->setText(str);
         _param_value_tag->adjustSize();
         uint width = _param_value_tag->width();
         while (width > PARAM_VALUE_WIDTH) {
@@ -561,12 +860,12 @@ void MainWindow::process_param_value_update(const ParamValueUpdate& msg)
         x = (VISIBLE_LCD_WIDTH - _param_value_tag->width() - 20);
         y += _param_value->height() + 10;
         _param_value_tag->setGeometry (x, y, _param_value_tag->width(), _param_value_tag->height());
-        _param_value_tag->setVisible(true);  
+        _set_visible(_param_value_tag, true);  
     }
     else {
         _param_value_tag->setText("");
         _param_value_tag->adjustSize();
-        _param_value_tag->setVisible(false); 
+        _set_visible(_param_value_tag, false); 
     }
 
     if ((uint)_param_value_tag->width() > width)
@@ -628,14 +927,14 @@ void MainWindow::process_enum_param_update(const EnumParamUpdate& msg)
         item->setSizeHint(QSize(list_width, LIST_ROW_HEIGHT));  
         enum_param_list->addItem(item);
         enum_param_list->setItemWidget(item, label);
-        _enum_list_items.push_back(msg.list_items[i]);
+        _enum_list_items.push_back(_string_table.resolve(msg.list_items[i]));
     }
 
     if (msg.selected_item < msg.num_items)
         enum_param_list->setCurrentRow(msg.selected_item);
     else
         enum_param_list->setCurrentRow(0);
-    enum_param_list->setVisible(true);
+    _set_visible(enum_param_list, true);
 
     // Trick to make QT scroll LOGICALLY and CONSISTENTLY (duh)
     // Note this assumes that there are 6 items shown in the list
@@ -647,9 +946,10 @@ void MainWindow::process_enum_param_update(const EnumParamUpdate& msg)
     enum_param_list->scrollToItem(enum_param_list->item(index), QAbstractItemView::PositionAtCenter);
     _show_default_background(false, false);
     _show_list_obj(false);
-    _params_list->setVisible(false);
-    _param_value->setVisible(false);
-    _param_value_tag->setVisible(false);
+    _set_visible(_params_list, false);
+    _list_release();
+    _set_visible(_param_value, false);
+    _set_visible(_param_value_tag, false);
 
     // Are we showing a WT list?
     if (msg.wt_list) {
@@ -667,17 +967,17 @@ void MainWindow::process_enum_param_update(const EnumParamUpdate& msg)
             // The WT file could not be loaded, so just display a line at 0.0
             _show_zero_wt_chart();
         }
-        _scope->setVisible(false);
-        _wt_scope->setVisible(true);
+        _set_visible(_scope, false);
+        _set_visible(_wt_scope, true);
     }
     else {
         // Make sure the WT enum param list and chart is not shown
-        _wt_enum_param_list->setVisible(false);
+        _set_visible(_wt_enum_param_list, false);
         _wt_chart_timer->stop();
         _wt_file.unload();
         _clear_wt_chart();
-        QCoreApplication::processEvents();
-        _wt_scope->setVisible(false);
+        _flush_wt_chart();
+        _set_visible(_wt_scope, false);
     }
 }
 
@@ -720,7 +1020,7 @@ void MainWindow::process_enum_param_value_update(const ListSelectItem& msg)
             // Load the WT file
             if (_wt_file.load(_enum_list_items[msg.selected_item] )) {
                 // Start the WT timer and show the WT chart
-                _wt_scope->setVisible(true);
+                _set_visible(_wt_scope, true);
                 _wt_chart_timer->start(WT_CHART_REFRESH_RATE);
             }
             else {
@@ -736,6 +1036,10 @@ void MainWindow::process_enum_param_value_update(const ListSelectItem& msg)
 //----------------------------------------------------------------------------
 void MainWindow::process_edit_name(const EditName& msg)
 {
+    // Get the name, padded so each character can be shown
+    char name[STD_STR_LEN] = {};
+    std::strncpy(name, _string_table.resolve(msg.name), (STD_STR_LEN - 1));
+
     // Has a selected character been specified?
     if (_selected_char == -1) 
     {
@@ -743,7 +1047,7 @@ void MainWindow::process_edit_name(const EditName& msg)
         int width;
 
         // No - always select one following the last character
-        _selected_char = (std::strlen(msg.name) < EDIT_NAME_STR_LEN) ? std::strlen(msg.name) : (EDIT_NAME_STR_LEN-1);
+        _selected_char = (std::strlen(name) < EDIT_NAME_STR_LEN) ? std::strlen(name) : (EDIT_NAME_STR_LEN-1);
 
         // Set the style for each character in the name
         for (uint i=0; i<EDIT_NAME_STR_LEN; i++) 
@@ -769,9 +1073,9 @@ void MainWindow::process_edit_name(const EditName& msg)
     {
         // Show each character in the name
         std::string s;
-        s = msg.name[i];
+        s = name[i];
         _edit_name[i]->setText(s.c_str());
-        _edit_name[i]->setVisible(true);
+        _set_visible(_edit_name[i], true);
     }
 
     // Set the ASCII picker geometry
@@ -782,6 +1086,7 @@ void MainWindow::process_edit_name(const EditName& msg)
     _show_param_obj(false);
     _show_enum_param_list_obj(false);
     _show_list_obj(false);
+    _list_release();
 }
 
 //----------------------------------------------------------------------------
@@ -836,7 +1141,7 @@ void MainWindow::process_edit_name_change_char(const EditNameChangeChar& msg)
         list_index = 1;
     
     // Hide the selected character in the name
-    _edit_name[_selected_char]->setVisible(false);
+    _set_visible(_edit_name[_selected_char], false);
 
     // Set the ASCII chars to show in the list
     int index = list_index - 3;
@@ -849,12 +1154,12 @@ void MainWindow::process_edit_name_change_char(const EditNameChangeChar& msg)
             std::string str;
             str = _ascii_chars[index];
             _ascii_picker[i]->setText(str.c_str());
-            _ascii_picker[i]->setVisible(true);
+            _set_visible(_ascii_picker[i], true);
         }
         else
         {
             // The index is out of range, so don't show this picker item
-            _ascii_picker[i]->setVisible(false);
+            _set_visible(_ascii_picker[i], false);
         }
         index++;
     }
@@ -869,9 +1174,9 @@ void MainWindow::show_confirmation_screen(const ConfirmationScreen& msg)
     _conf_screen_timer->stop();
 
     // Show the confirmation screen
-    _confirmation_screen_line_1->setText(msg.line_1);
+    _confirmation_screen_line_1->setText(_string_table.resolve(msg.line_1));
     _confirmation_screen_line_1->adjustSize();
-    _confirmation_screen_line_2->setText(msg.line_2);
+    _confirmation_screen_line_2->setText(_string_table.resolve(msg.line_2));
     _confirmation_screen_line_2->adjustSize();
     auto x = (LCD_WIDTH - _confirmation_screen_line_1->width()) / 2;
     if (x < (CONFIRMATION_SCREEN_MARGIN_LEFT + 40)) {
@@ -950,11 +1255,11 @@ void MainWindow::show_warning_screen(const WarningScreen& msg)
 //----------------------------------------------------------------------------
 // clear_boot_warning
 //----------------------------------------------------------------------------
-void MainWindow::clear_boot_warning()
+void MainWindow::clear_boot_warning([[maybe_unused]] const ClearBootWarning& msg)
 {
     // Hide the boot warning background screen and start processing the scope
-    _boot_warning_background->setVisible(false);
-    _scope_data_source.start(_scope);
+    _set_visible(_boot_warning_background, false);
+    _scope_data_source.start(_scope, &_gui_msg_latency);
 }
 
 //----------------------------------------------------------------------------
@@ -976,6 +1281,25 @@ void MainWindow::set_system_colour(const SetSystemColour& msg)
     _set_gui_objs_system_colour();
 }
 
+//----------------------------------------------------------------------------
+// intern_string
+//----------------------------------------------------------------------------
+void MainWindow::intern_string(const InternString& msg)
+{
+    // Register the string, it can now be referenced by later messages
+    _string_table.intern(msg.id, msg.str);
+}
+
+//----------------------------------------------------------------------------
+// set_scope_timebase
+//----------------------------------------------------------------------------
+void MainWindow::set_scope_timebase(const ScopeTimebase& msg)
+{
+    // Set the OSC scope timebase - a long timebase is reduced to an envelope
+    // with a column per pixel of the OSC scope width
+    _scope_data_source.set_timebase(msg.num_frames, OSC_SCOPE_WIDTH);
+}
+
 #ifdef SPI_STATUS_MONITOR
 //----------------------------------------------------------------------------
 // set_spi_status
@@ -992,6 +1316,99 @@ void MainWindow::set_spi_status(uint count)
 }
 #endif
 
+//----------------------------------------------------------------------------
+// _process_gui_msg
+//----------------------------------------------------------------------------
+void MainWindow::_process_gui_msg(const GuiMsg& msg)
+{
+    GUI_HANDLER_PROFILE(_handler_profiler, msg.type);
+
+    // Dispatch the message to its handler (see the GUI message registry)
+    switch (msg.type)
+    {
+#define GUI_MSG_DISPATCH(type, payload, member, handler, policy, lane) \
+        case GuiMsgType::type: handler(msg.member); break;
+        GUI_MSG_REGISTRY(GUI_MSG_DISPATCH)
+#undef GUI_MSG_DISPATCH
+
+        default:
+            // Ignore any unknown messages
+            break;
+    }
+}
+
+//----------------------------------------------------------------------------
+// _set_visible
+//----------------------------------------------------------------------------
+void MainWindow::_set_visible(QWidget *widget, bool visible)
+{
+    // If processing GUI messages, defer the change until the end of the batch,
+    // otherwise apply it now
+    if (_processing_gui_msgs) {
+        // If there is already a change for this widget, replace it
+        for (auto& v : _deferred_visibility) {
+            if (v.first == widget) {
+                v.second = visible;
+                return;
+            }
+        }
+        _deferred_visibility.push_back(std::pair<QWidget *, bool>(widget, visible));
+    }
+    else {
+        widget->setVisible(visible);
+    }
+}
+
+//----------------------------------------------------------------------------
+// _is_visible
+//----------------------------------------------------------------------------
+bool MainWindow::_is_visible(QWidget *widget)
+{
+    // Check for a deferred change first
+    for (auto& v : _deferred_visibility) {
+        if (v.first == widget)
+            return v.second;
+    }
+    return widget->isVisible();
+}
+
+//----------------------------------------------------------------------------
+// _commit_deferred_visibility
+//----------------------------------------------------------------------------
+void MainWindow::_commit_deferred_visibility()
+{
+    // If the WT chart was cleared, make sure it is repainted before it is hidden,
+    // so the old chart is not shown when it is next made visible
+    if (_wt_chart_flush_pending) {
+        _wt_scope->repaint();
+        _wt_chart_flush_pending = false;
+    }
+
+    // Apply the deferred visibility changes, skipping any that don't change
+    // the widget state
+    for (auto& v : _deferred_visibility) {
+        if (v.first->isVisible() != v.second)
+            v.first->setVisible(v.second);
+    }
+    _deferred_visibility.clear();
+
+    // The scope may have been shown or hidden, so update its frame demand
+    _scope_data_source.update_frame_demand();
+}
+
+//----------------------------------------------------------------------------
+// _flush_wt_chart
+//----------------------------------------------------------------------------
+void MainWindow::_flush_wt_chart()
+{
+    // Make sure the cleared WT chart is rendered - if processing GUI messages this
+    // is done at the end of the batch
+    if (_processing_gui_msgs)
+        _wt_chart_flush_pending = true;
+    else
+        QCoreApplication::processEvents();
+}
+
 //----------------------------------------------------------------------------
 // _create_gui_objs
 //----------------------------------------------------------------------------
@@ -1009,11 +1426,11 @@ void MainWindow::_create_gui_objs()
     _default_background->setVisible(false);
 
     // Create the Osc scope
-    _scope = new Scope(SCOPE_NUM_SAMPLES, this);
+    _scope = new Scope(SCOPE_NUM_SAMPLES, this, OSC_SCOPE_WIDTH);
     _scope->set_colour(_system_colour);
     _scope->setGeometry (OSC_SCOPE_MARGIN_LEFT, SCOPE_MARGIN_TOP, OSC_SCOPE_WIDTH, SCOPE_HEIGHT);
-    _scope->setVisible(false);
-    _scope_data_source.start(_scope);
+    _set_visible(_scope, false);
+    _scope_data_source.start(_scope, &_gui_msg_latency);
 
     // Create the status bar background object
     _status_bar_background = new QLabel(this);
@@ -1460,13 +1877,13 @@ void MainWindow::_show_default_background(bool show, bool show_scope)
         if ((_scope_mode == GuiScopeMode::SCOPE_MODE_OFF) || !show_scope) {
             // No Scope, show the default background        
             _clear_scope();
-            _scope->hide();
-            _default_background->setVisible(true);
+            _hide_scope();
+            _set_visible(_default_background, true);
         }
         else {
             // Show the scope in the foreground and hide the default background
-            _scope->show(ScopeDisplayMode::FOREGROUND);
-            _default_background->setVisible(false);            
+            _show_scope(ScopeDisplayMode::FOREGROUND);
+            _set_visible(_default_background, false);            
         }
     }
     else {
@@ -1474,15 +1891,15 @@ void MainWindow::_show_default_background(bool show, bool show_scope)
         if ((_scope_mode == GuiScopeMode::SCOPE_MODE_OFF) || !show_scope) {
             // No Scope
             _clear_scope();
-            _scope->hide();                    
+            _hide_scope();
         }
         else {
             // Show the scope in the background
-            _scope->show(ScopeDisplayMode::BACKGROUND);
+            _show_scope(ScopeDisplayMode::BACKGROUND);
         }
 
         // Hide the default background
-        _default_background->setVisible(false); 
+        _set_visible(_default_background, false); 
     }
 }
 
@@ -1492,9 +1909,9 @@ void MainWindow::_show_default_background(bool show, bool show_scope)
 void MainWindow::_show_param_obj(bool show)
 {
     // Show/hide the Param
-    _param_value->setVisible(show);
-    _param_value_tag->setVisible(show);
-    _params_list->setVisible(show);
+    _set_visible(_param_value, show);
+    _set_visible(_param_value_tag, show);
+    _set_visible(_params_list, show);
 }
 
 //----------------------------------------------------------------------------
@@ -1503,19 +1920,19 @@ void MainWindow::_show_param_obj(bool show)
 void MainWindow::_show_enum_param_list_obj(bool show)
 {
     // Show/hide the enum Param lists
-    _enum_param_list->setVisible(show);
-    _wt_enum_param_list->setVisible(show);
+    _set_visible(_enum_param_list, show);
+    _set_visible(_wt_enum_param_list, show);
 
     // If hiding, make sure the WT chart is stopped and cleared
     if (!show) {
         _wt_chart_timer->stop();
         _wt_file.unload();
         _clear_wt_chart();
-        QCoreApplication::processEvents();
+        _flush_wt_chart();
     }
 
     // Show/hide the WT chart
-    _wt_scope->setVisible(show);
+    _set_visible(_wt_scope, show);
 }
 
 //----------------------------------------------------------------------------
@@ -1524,7 +1941,7 @@ void MainWindow::_show_enum_param_list_obj(bool show)
 void MainWindow::_show_list_obj(bool show)
 {
     // Show/hide the List
-    _main_area_list->setVisible(show);
+    _set_visible(_main_area_list, show);
 }
 
 //----------------------------------------------------------------------------
@@ -1532,9 +1949,9 @@ void MainWindow::_show_list_obj(bool show)
 //----------------------------------------------------------------------------
 void MainWindow::_show_soft_buttons(bool show)
 {
-    _soft_button1->setVisible(show);
-    _soft_button2->setVisible(show);
-    _soft_button3->setVisible(show);
+    _set_visible(_soft_button1, show);
+    _set_visible(_soft_button2, show);
+    _set_visible(_soft_button3, show);
 }
 
 //----------------------------------------------------------------------------
@@ -1544,9 +1961,9 @@ void MainWindow::_show_edit_name_obj(bool show)
 {
     // Show/hide the Edit Name and ASCII Picker
     for (uint i=0; i<EDIT_NAME_STR_LEN; i++)
-        _edit_name[i]->setVisible(show);
+        _set_visible(_edit_name[i], show);
     for (uint i=0; i<ASCII_PICKER_SIZE; i++)
-        _ascii_picker[i]->setVisible(show);
+        _set_visible(_ascii_picker[i], show);
     if (!show)
         _selected_char = -1;
 }
@@ -1556,9 +1973,9 @@ void MainWindow::_show_edit_name_obj(bool show)
 //----------------------------------------------------------------------------
 void MainWindow::_show_confirmation_screen_obj(bool show)
 {
-    _confirmation_screen_background->setVisible(show);
-    _confirmation_screen_line_1->setVisible(show);
-    _confirmation_screen_line_2->setVisible(show);
+    _set_visible(_confirmation_screen_background, show);
+    _set_visible(_confirmation_screen_line_1, show);
+    _set_visible(_confirmation_screen_line_2, show);
 }
 
 //----------------------------------------------------------------------------
@@ -1566,11 +1983,11 @@ void MainWindow::_show_confirmation_screen_obj(bool show)
 //----------------------------------------------------------------------------
 void MainWindow::_show_warning_screen_obj(bool show, bool show_hourglass)
 {
-    _warning_screen_background_1->setVisible(show);
-    _warning_screen_background_2->setVisible(show);
-    _warning_screen_line_1->setVisible(show);
-    _warning_screen_line_2->setVisible(show);
-    _warning_screen_hourglass->setVisible(show && show_hourglass);
+    _set_visible(_warning_screen_background_1, show);
+    _set_visible(_warning_screen_background_2, show);
+    _set_visible(_warning_screen_line_1, show);
+    _set_visible(_warning_screen_line_2, show);
+    _set_visible(_warning_screen_hourglass, show && show_hourglass);
 }
 
 //----------------------------------------------------------------------------
@@ -1579,7 +1996,7 @@ void MainWindow::_show_warning_screen_obj(bool show, bool show_hourglass)
 void MainWindow::_set_soft_button_text(QLabel *soft_button, const char *txt)
 {
     if (std::strlen(txt) > 0)
-        soft_button->setText(txt);
+        soft_button->setText(_string_table.resolve(txt));
     else
         soft_button->setText("----");
 }
@@ -1629,7 +2046,7 @@ void MainWindow::_set_ascii_picker_geometry(bool hide)
                                 ASCII_PICKER_ITEM_WIDTH,
                                 ASCII_PICKER_ITEM_HEIGHT);
         if (hide)
-            _ascii_picker[i]->setVisible(false);
+            _set_visible(_ascii_picker[i], false);
     }
 }
 
@@ -1638,8 +2055,9 @@ void MainWindow::_set_ascii_picker_geometry(bool hide)
 //----------------------------------------------------------------------------
 void MainWindow::_conf_screen_timer_callback()
 {
-    // Hide the confirmation screen
-    _show_confirmation_screen_obj(false);    
+    // Hide the confirmation screen - note this is called from the timer thread,
+    // so hide the screen from the GUI thread
+    QMetaObject::invokeMethod(this, [this]() { _show_confirmation_screen_obj(false); }, Qt::QueuedConnection);
 }
 
 //----------------------------------------------------------------------------
@@ -1653,11 +2071,11 @@ void MainWindow::_left_status_set_text(const char *text, bool patch_modified)
     if (patch_modified) {
         _patch_modified_status->setText("*");
         _patch_modified_status->adjustSize();
-        _patch_modified_status->setVisible(true);
+        _set_visible(_patch_modified_status, true);
         max_width -= _patch_modified_status->width();
     }
     else {
-        _patch_modified_status->setVisible(false); 
+        _set_visible(_patch_modified_status, false); 
     }
 
     // Show the home screen
@@ -1679,6 +2097,19 @@ void MainWindow::_left_status_set_text(const char *text, bool patch_modified)
 //----------------------------------------------------------------------------
 void MainWindow::_label_set_text(QLabel *label, const char *text, int max_width)
 {
+    // If the text references an interned string, use its cached display text
+    // for this width and font (if any)
+    uint id;
+    bool interned = gui_msg_get_intern_ref(text, id);
+    if (interned) {
+        auto display_text = _string_table.display_text(id, max_width, label->font().pointSize(), false);
+        if (display_text) {
+            label->setText(*display_text);
+            label->adjustSize();
+            return;
+        }
+        text = _string_table.resolve(text);
+    }
     QString str = text;
 
     // Update the object text
@@ -1694,6 +2125,8 @@ void MainWindow::_label_set_text(QLabel *label, const char *text, int max_width)
             width = label->width();
         }
     }
+    if (interned)
+        _string_table.set_display_text(id, max_width, label->font().pointSize(), false, label->text());
 }
 
 //----------------------------------------------------------------------------
@@ -1701,6 +2134,20 @@ void MainWindow::_label_set_text(QLabel *label, const char *text, int max_width)
 //----------------------------------------------------------------------------
 void MainWindow::_wt_label_set_text(QLabel *label, const char *text)
 {
+    // If the text references an interned string, use its cached display text
+    // (if any)
+    uint id;
+    bool interned = gui_msg_get_intern_ref(text, id);
+    if (interned) {
+        auto display_text = _string_table.display_text(id, (WT_LIST_WIDTH - 30), label->font().pointSize(), true);
+        if (display_text) {
+            label->setText(*display_text);
+            label->adjustSize();
+            return;
+        }
+        text = _string_table.resolve(text);
+    }
+
     // Get the start and end strings to use if string truncation is needed
     QString str1 = text;
     QString str2 = text;
@@ -1718,6 +2165,8 @@ void MainWindow::_wt_label_set_text(QLabel *label, const char *text)
         label->adjustSize();
         width = label->width();
     }
+    if (interned)
+        _string_table.set_display_text(id, (WT_LIST_WIDTH - 30), label->font().pointSize(), true, label->text());
 }
 
 //----------------------------------------------------------------------------
@@ -1797,6 +2246,178 @@ void MainWindow::_list_add_item(QListWidget *list, const char *text, int list_wi
 
     _list_items.push_back(_dummy_label->text().toStdString());
     _list_items_enabled.push_back(enabled);  
+    _list_items_separator.push_back(false);
+}
+
+//----------------------------------------------------------------------------
+// _list_insert_item
+//----------------------------------------------------------------------------
+void MainWindow::_list_insert_item(QListWidget *list, uint index, const char *text, bool enabled, bool separator)
+{
+    // Firstly find the text we can display, truncated if necessary
+    // We do this with the dummy QLabel object  
+    _label_set_text(_dummy_label, text, _list_text_width(list));
+
+    // If the list items have no state, just insert the text
+    if (!_list_has_state) {
+        list->insertItem(index, _dummy_label->text());
+        list->item(index)->setSizeHint(QSize(_list_row_width(list), LIST_ROW_HEIGHT));
+        return;
+    }
+
+    // Insert the item into the list
+    auto label = new QLabel(this);
+    auto item = new QListWidgetItem();
+    label->setFont(QFont(STANDARD_FONT_NAME, LIST_FONT_SIZE));
+    item->setSizeHint(QSize(_list_row_width(list), LIST_ROW_HEIGHT));
+    list->insertItem(index, item);
+    list->setItemWidget(item, label);
+    _list_items.insert(_list_items.begin() + index, _dummy_label->text().toStdString());
+    _list_items_enabled.insert(_list_items_enabled.begin() + index, enabled);
+    _list_items_separator.insert(_list_items_separator.begin() + index, separator);
+    _list_refresh_item(list, index);
+}
+
+//----------------------------------------------------------------------------
+// _list_refresh_item
+//----------------------------------------------------------------------------
+void MainWindow::_list_refresh_item(QListWidget *list, uint index)
+{
+    // Update the item label from the list item state
+    auto label = reinterpret_cast<QLabel *>(list->itemWidget(list->item(index)));
+    if (label) {
+        _list_label_set_text(label, _list_items[index].c_str(), ((int)index == list->currentRow()),
+                             _list_items_enabled[index], _list_items_separator[index]);
+    }
+}
+
+//----------------------------------------------------------------------------
+// _list_text_width
+//----------------------------------------------------------------------------
+int MainWindow::_list_text_width(QListWidget *list)
+{
+    // Return the maximum width of the item text
+    return (list == _params_list) ? (PARAM_LIST_WIDTH - 30) : (LIST_WIDTH - 40);
+}
+
+//----------------------------------------------------------------------------
+// _list_row_width
+//----------------------------------------------------------------------------
+int MainWindow::_list_row_width(QListWidget *list)
+{
+    // Return the width of each list row
+    return (list == _params_list) ? PARAM_LIST_WIDTH : (LIST_WIDTH - 40);
+}
+
+//----------------------------------------------------------------------------
+// _list_window_update
+//----------------------------------------------------------------------------
+void MainWindow::_list_window_update()
+{
+    // Ignore if the visible rows are not the windowed list rows
+    if (!_list_windowed || (_list_items.size() != LIST_VISIBLE_ROWS))
+        return;
+
+    // Get the first visible row in the full list - this keeps the same scroll
+    // behaviour as the non-windowed list, where the list is scrolled so the
+    // selected item is centered
+    uint first_row = (_list_selected_item <= 4) ? 0 : (_list_selected_item - 3);
+    if ((first_row + LIST_VISIBLE_ROWS) > _list_total_items) {
+        first_row = (_list_total_items > LIST_VISIBLE_ROWS) ? (_list_total_items - LIST_VISIBLE_ROWS) : 0;
+    }
+
+    // Update each visible row from the row cache
+    // Any rows not yet received are shown empty until they are received
+    bool rows_missing = false;
+    for (uint i=0; i<LIST_VISIBLE_ROWS; i++) {
+        uint row = first_row + i;
+        auto cached_row = (row < _list_total_items) ? _list_row_cache.get(row) : nullptr;
+        if ((row < _list_total_items) && !cached_row) {
+            rows_missing = true;
+        }
+        _list_items[i] = cached_row ? cached_row->text : "";
+        _list_items_enabled[i] = cached_row ? cached_row->enabled : true;
+        auto label = reinterpret_cast<QLabel *>(_main_area_list->itemWidget(_main_area_list->item(i)));
+        _list_label_set_text(label, _list_items[i].c_str(), (row == _list_selected_item), _list_items_enabled[i], false);
+    }
+    if (_list_selected_item >= first_row) {
+        _main_area_list->setCurrentRow(_list_selected_item - first_row);
+    }
+
+    // Request the rows around the visible rows if any are missing, or the rows
+    // just outside the visible rows are not cached (so they are fetched before
+    // being scrolled into view)
+    uint prefetch_first = (first_row > LIST_PREFETCH_ROWS) ? (first_row - LIST_PREFETCH_ROWS) : 0;
+    uint prefetch_last = std::min((first_row + LIST_VISIBLE_ROWS + LIST_PREFETCH_ROWS), _list_total_items);
+    for (uint row=prefetch_first; (row<prefetch_last) && !rows_missing; row++) {
+        if (!_list_row_cache.contains(row))
+            rows_missing = true;
+    }
+    if (rows_missing) {
+        // Request a window of rows centered on the selected item, unless it has
+        // already been requested
+        uint first_item = (_list_selected_item > (LIST_WINDOW_MAX_ITEMS / 2)) ? (_list_selected_item - (LIST_WINDOW_MAX_ITEMS / 2)) : 0;
+        if ((first_item + LIST_WINDOW_MAX_ITEMS) > _list_total_items) {
+            first_item = (_list_total_items > LIST_WINDOW_MAX_ITEMS) ? (_list_total_items - LIST_WINDOW_MAX_ITEMS) : 0;
+        }
+        if ((int)first_item == _list_requested_item)
+            return;
+        GuiEventMsg event;
+        event.type = GuiEventType::LIST_WINDOW_REQUEST;
+        event.list_window_request.list_id = GuiListId::LIST_ID_MAIN_AREA;
+        event.list_window_request.list_serial = _list_serial;
+        event.list_window_request.first_item = first_item;
+        event.list_window_request.num_items = LIST_WINDOW_MAX_ITEMS;
+
+        // Only mark the window as requested if the request was sent - if the
+        // event queue was full, it is requested again on the next update
+        if (_gui_thread->send_event(event))
+            _list_requested_item = first_item;
+    }
+}
+
+//----------------------------------------------------------------------------
+// _list_window_reset
+// Called when the windowed list is replaced by another list or screen
+//----------------------------------------------------------------------------
+void MainWindow::_list_window_reset()
+{
+    // Discard the windowed list state, so any late select or window messages
+    // for it are not applied to the rows of another list
+    _list_windowed = false;
+    _list_serial = 0;
+    _list_requested_item = -1;
+    _list_row_cache.clear();
+}
+
+//----------------------------------------------------------------------------
+// _list_release
+// Called when another screen takes over from the main area or params list
+//----------------------------------------------------------------------------
+void MainWindow::_list_release()
+{
+    // No list is now shown, so any deltas for the previous list are ignored
+    // until a full list is received
+    _list_id = GuiListId::LIST_ID_NONE;
+    _list_has_state = false;
+    _list_resync_requested = false;
+    _list_window_reset();
+}
+
+//----------------------------------------------------------------------------
+// _list_request_resync
+//----------------------------------------------------------------------------
+void MainWindow::_list_request_resync()
+{
+    // Request the Nina UI app sends the full list again (once, until the full
+    // list is received)
+    if (!_list_resync_requested) {
+        GuiEventMsg event;
+        event.type = GuiEventType::LIST_RESYNC_REQUEST;
+        event.list_resync_request.list_id = _list_id;
+        event.list_resync_request.expected_version = _list_version;
+        _list_resync_requested = _gui_thread->send_event(event);
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -1830,6 +2451,30 @@ QString MainWindow::_get_dimmed_system_stylesheet_colour()
     return QString("#%1%2%3").arg(((rgb >> 16) & 0xFF) / 2, 2, 16, QChar('0')).arg(((rgb >> 8) & 0xFF) / 2, 2, 16, QChar('0')).arg((rgb & 0xFF) / 2, 2, 16, QChar('0'));
 }
 
+//----------------------------------------------------------------------------
+// _show_scope
+//----------------------------------------------------------------------------
+void MainWindow::_show_scope(ScopeDisplayMode display_mode)
+{
+    // Set the scope display mode, and show it (deferred if processing GUI
+    // messages) - the scope frames are then demanded if read on demand
+    _scope->set_display_mode(display_mode);
+    _set_visible(_scope, true);
+    _scope_data_source.update_frame_demand();
+}
+
+//----------------------------------------------------------------------------
+// _hide_scope
+//----------------------------------------------------------------------------
+void MainWindow::_hide_scope()
+{
+    // Hide the scope (deferred if processing GUI messages), and reset the
+    // display mode
+    _set_visible(_scope, false);
+    _scope->set_display_mode(ScopeDisplayMode::FOREGROUND);
+    _scope_data_source.update_frame_demand();
+}
+
 //----------------------------------------------------------------------------
 // _clear_scope
 //----------------------------------------------------------------------------
@@ -1852,6 +2497,7 @@ void MainWindow::_clear_scope()
 //----------------------------------------------------------------------------
 void MainWindow::_update_wt_chart()
 {
+    GUI_HANDLER_PROFILE(_handler_profiler, GUI_HANDLER_UPDATE_WT_CHART);
     QVector<QPointF> data;
 
     // Get the next wave samples to display
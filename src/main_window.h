@@ -16,6 +16,7 @@
 #include <QListWidget>
 #include <QTreeWidget>
 #include <QTimer>
+#include <QSocketNotifier>
 #include <QtCharts/QChart>
 #include <QtCharts/QChartView>
 #include "background.h"
@@ -25,6 +26,10 @@
 #include "scope_msg_thread.h"
 #include "scope_data_source.h"
 #include "scope.h"
+#include "list_row_cache.h"
+#include "gui_string_table.h"
+#include "gui_handler_profiler.h"
+#include "ipc_queue_health.h"
 #ifdef SPI_STATUS_MONITOR
 #include "spi_monitor_thread.h"
 #endif
@@ -45,32 +50,25 @@ public:
     MainWindow(QString colour_str, QColor colour, QWidget *parent = nullptr);
     ~MainWindow();
     void set_system_colour(QString colour_str, QColor colour);
+    static void request_print_stats();
 
 public slots:
-    void set_left_status(const LeftStatus& msg);
-    void set_layer_status(const LayerStatus& msg);
-    void set_midi_status(const MidiStatus& msg);
-    void set_tempo_status(const TempoStatus& msg);
-    void show_home_screen(const HomeScreen& msg);
-    void show_list_items(const ListItems& msg);
-    void list_select_item(const ListSelectItem& msg);
-    void set_soft_buttons(const SoftButtons& msg);
-    void set_soft_buttons_state(const SoftButtonsState& msg);
-    void process_param_update(const ParamUpdate& msg);
-    void process_param_value_update(const ParamValueUpdate& msg);
-    void process_enum_param_update(const EnumParamUpdate& msg);
-    void process_enum_param_value_update(const ListSelectItem& msg);
-    void process_edit_name(const EditName& msg);
-    void process_edit_name_select_char(const EditNameSelectChar& msg);
-    void process_edit_name_change_char(const EditNameChangeChar& msg);
-    void show_confirmation_screen(const ConfirmationScreen& msg);
-    void show_warning_screen(const WarningScreen& msg);
-    void clear_boot_warning();
-    void set_system_colour(const SetSystemColour& msg);  
+    void process_gui_msgs();
+    void print_stats();
 #ifdef SPI_STATUS_MONITOR
     void set_spi_status(uint count);
 #endif
 
+public:
+    // GUI message handlers - declared from the GUI message registry (common.h),
+    // so each message type only needs its handler defined
+#define GUI_MSG_HANDLER_DECL(type, payload, member, handler, policy, lane) void handler(const payload& msg);
+    GUI_MSG_REGISTRY(GUI_MSG_HANDLER_DECL)
+#undef GUI_MSG_HANDLER_DECL
+
+protected:
+    bool event(QEvent *event) override;
+
 private:
     // Private variables
     Background *_background;
@@ -112,6 +110,17 @@ private:
     std::vector<bool> _list_items_enabled;
     std::vector<bool> _list_items_separator;
     std::vector<std::string> _enum_list_items;
+    GuiListId _list_id;
+    uint _list_version;
+    bool _list_resync_requested;
+    bool _list_has_state;
+    bool _list_windowed;
+    uint _list_serial;
+    uint _list_total_items;
+    uint _list_selected_item;
+    int _list_requested_item;
+    ListRowCache _list_row_cache;
+    GuiStringTable _string_table;
     GuiMsgThread *_gui_thread;
     ScopeMsgThread *_scope_thread;
 #ifdef SPI_STATUS_MONITOR
@@ -126,8 +135,27 @@ private:
     WtFile _wt_file;
     GuiScopeMode _scope_mode;
     ScopeDataSource _scope_data_source{_scope_mode};
+    GuiMsgPool _gui_msg_pool;
+    GuiMsgLatency _gui_msg_latency;
+#ifdef GUI_HANDLER_PROFILING
+    GuiHandlerProfiler _handler_profiler;
+#endif
+    static int _print_stats_event_fd;
+    QSocketNotifier *_print_stats_notifier;
+    IpcRecorder _ipc_recorder;
+    IpcQueueHealth _gui_msg_queue_health{"GUI messages"};
+    IpcQueueHealth _scope_msg_queue_health{"Scope samples"};
+    std::vector<GuiMsgHandle> _gui_msgs;
+    bool _processing_gui_msgs;
+    std::vector<std::pair<QWidget *, bool>> _deferred_visibility;
+    bool _wt_chart_flush_pending;
 
     // Private functions
+    void _process_gui_msg(const GuiMsg& msg);
+    void _set_visible(QWidget *widget, bool visible);
+    bool _is_visible(QWidget *widget);
+    void _commit_deferred_visibility();
+    void _flush_wt_chart();
     void _show_default_background(bool show, bool show_scope);
     void _show_top_bar(bool show);
     void _show_logo_obj(bool show);
@@ -150,8 +178,18 @@ private:
     void _list_label_set_text(QLabel *label, QString text, bool selected, bool enabled, bool separator);
     void _list_add_item(QListWidget *list, const char *text, int list_width);
     void _list_add_item(QListWidget *list, const char *text, int list_width, bool selected, bool enabled);
+    void _list_insert_item(QListWidget *list, uint index, const char *text, bool enabled, bool separator);
+    void _list_refresh_item(QListWidget *list, uint index);
+    int _list_text_width(QListWidget *list);
+    int _list_row_width(QListWidget *list);
+    void _list_window_update();
+    void _list_window_reset();
+    void _list_release();
+    void _list_request_resync();
     QPixmap _set_pixmap_to_system_colour(const QPixmap& pixmap);
     QString _get_dimmed_system_stylesheet_colour();
+    void _show_scope(ScopeDisplayMode display_mode);
+    void _hide_scope();
     void _clear_scope();
     void _update_wt_chart();
     void _show_zero_wt_chart();
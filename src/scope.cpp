@@ -6,10 +6,13 @@
  * @brief Scope class implementation.
  *-----------------------------------------------------------------------------
  */
+#include <algorithm>
+#include <cstring>
 #include <QPainter>
 #include "scope.h"
 #include <QOpenGLShaderProgram>
 #include "common.h"
+#include "gui_msg_latency.h"
 
 // Constants
 constexpr float FOREGROUND_ALPHA = 1.0f;
@@ -17,12 +20,27 @@ constexpr float BACKGROUND_ALPHA = 0.5f;
 constexpr uint DEFAULT_PEN_WIDTH = 4;
 
 // Vertex shader
+// Each vertex is either an x/y point, or the raw L/R samples - for OSC the x
+// is derived from the vertex index, and for XY the L/R is rotated by 45 degrees
+// For an envelope each column has a bottom and top vertex (both the column
+// min/max), and the top is at least the min height above the bottom
 static const char *vertexShaderSourceCore =
     "#version 310 es\n"
-        "layout (location = 0) in vec3 aPos;\n"
+        "layout (location = 0) in vec2 aPos;\n"
+        "uniform int vertex_mode;\n"
+        "uniform float x_scale;\n"
+        "uniform float min_height;\n"
         "void main()\n"
         "{\n"
-        "   gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1.0);\n"
+        "   vec2 pos = aPos;\n"
+        "   if (vertex_mode == 1)\n"
+        "       pos = vec2((float(gl_VertexID) * x_scale) - 1.0, aPos.x + aPos.y);\n"
+        "   else if (vertex_mode == 2)\n"
+        "       pos = vec2(aPos.x - aPos.y, aPos.x + aPos.y) * 0.70710678;\n"
+        "   else if (vertex_mode == 3)\n"
+        "       pos = vec2((float(gl_VertexID / 2) * x_scale) - 1.0,\n"
+        "                  ((gl_VertexID & 1) == 0) ? aPos.x : max(aPos.y, aPos.x + min_height));\n"
+        "   gl_Position = vec4(pos, 0.0, 1.0);\n"
         "}\0";
 
 // Fragment shader
@@ -39,15 +57,25 @@ static const char *fragmentShaderSourceCore =
 //----------------------------------------------------------------------------
 // Scope
 //----------------------------------------------------------------------------
-Scope::Scope(uint num_samples, QWidget *parent) : QOpenGLWidget(parent)
+Scope::Scope(uint num_samples, QWidget *parent, uint max_envelope_columns) : QOpenGLWidget(parent)
 {
-    // Initialise class variables
-    _vertices = new float[num_samples * 2 * 3];
-    for (uint i=0; i<num_samples; i++) {
-        _vertices[(i*3)] = -1.0f + ((qreal(i) / num_samples) * 2);
-        _vertices[(i*3)+1] = 0.0f;
-        _vertices[(i*3)+2] = 0.0f;
-    }
+    // Initialise class variables - the initial vertices are silent OSC samples
+    // The vertices are sized for the samples, or the envelope (two vertices
+    // per column) if larger
+    _vertices_size = std::max((num_samples * 2), (max_envelope_columns * 4));
+    _vertices = new float[_vertices_size];
+    std::memset(_vertices, 0, _vertices_size * sizeof(float));
+    _vertex_mode = ScopeVertexMode::OSC;
+    _num_vertices = num_samples;
+    _max_envelope_columns = max_envelope_columns;
+    _vertices_seq = 0;
+    _uploaded_seq = 0;
+    _vbo_index = 0;
+    _num_paints = 0;
+    _num_uploads = 0;
+    _bytes_uploaded = 0;
+    _last_print_time = GuiMsgLatency::now();
+    _last_print_bytes = 0;
     _num_samples = num_samples;
     _program = nullptr;
     _alpha = FOREGROUND_ALPHA;
@@ -113,6 +141,21 @@ void Scope::hide(bool reset_display_mode)
         _alpha = FOREGROUND_ALPHA;
 }
 
+//----------------------------------------------------------------------------
+// set_display_mode
+//----------------------------------------------------------------------------
+void Scope::set_display_mode(ScopeDisplayMode display_mode)
+{
+    // Set the display mode (without changing the visibility), and repaint if
+    // it has changed
+    float alpha = display_mode == ScopeDisplayMode::FOREGROUND ? 
+                    FOREGROUND_ALPHA : BACKGROUND_ALPHA;
+    if (alpha != _alpha) {
+        _alpha = alpha;
+        update();
+    }
+}
+
 //----------------------------------------------------------------------------
 // set_colour
 //----------------------------------------------------------------------------
@@ -140,13 +183,73 @@ void Scope::refresh_data(const QVector<QPointF>& data)
     if (data.size() >= _num_samples) {
         // Update the verticies data, and refresh the scope
         for (uint i=0; i<_num_samples; i++) {
-            _vertices[(i*3)] = data[i].x();
-            _vertices[(i*3)+1] = data[i].y();
+            _vertices[(i*2)] = data[i].x();
+            _vertices[(i*2)+1] = data[i].y();
         }
+        _vertex_mode = ScopeVertexMode::POINTS;
+        _num_vertices = _num_samples;
+        _vertices_seq++;
+        update();
+    }
+}
+
+//----------------------------------------------------------------------------
+// refresh_data
+//----------------------------------------------------------------------------
+void Scope::refresh_data(const float *samples, uint num_samples, GuiScopeMode mode)
+{
+    // Make sure we actually have useful data
+    if ((num_samples >= _num_samples) && (mode != GuiScopeMode::SCOPE_MODE_OFF)) {
+        // Update the verticies data (the raw interleaved L/R samples, mapped
+        // in the vertex shader), and refresh the scope
+        std::memcpy(_vertices, samples, (_num_samples * 2) * sizeof(float));
+        _vertex_mode = (mode == GuiScopeMode::SCOPE_MODE_OSC) ? ScopeVertexMode::OSC : ScopeVertexMode::XY;
+        _num_vertices = _num_samples;
+        _vertices_seq++;
         update();
     }
 }
 
+//----------------------------------------------------------------------------
+// refresh_envelope
+//----------------------------------------------------------------------------
+void Scope::refresh_envelope(const float *envelope, uint num_columns)
+{
+    // Make sure we actually have a useful envelope
+    if ((num_columns > 1) && (num_columns <= _max_envelope_columns)) {
+        // Update the verticies data - a bottom and top vertex for each column,
+        // each with the column min/max (interleaved), and refresh the scope
+        for (uint i=0; i<num_columns; i++) {
+            float min = envelope[(i*2)];
+            float max = envelope[(i*2)+1];
+            _vertices[(i*4)] = min;
+            _vertices[(i*4)+1] = max;
+            _vertices[(i*4)+2] = min;
+            _vertices[(i*4)+3] = max;
+        }
+        _vertex_mode = ScopeVertexMode::ENVELOPE;
+        _num_vertices = num_columns * 2;
+        _vertices_seq++;
+        update();
+    }
+}
+
+//----------------------------------------------------------------------------
+// print_stats
+//----------------------------------------------------------------------------
+void Scope::print_stats(const char *name) const
+{
+    // Show the paint and upload counts, with the upload rate since the stats
+    // were last shown
+    uint64_t now = GuiMsgLatency::now();
+    double elapsed_s = (now - _last_print_time) / 1000000000.0;
+    uint64_t rate = (elapsed_s > 0.0) ? ((_bytes_uploaded - _last_print_bytes) / elapsed_s) : 0;
+    _last_print_time = now;
+    _last_print_bytes = _bytes_uploaded;
+    MSG("Scope: " << name << ": paints: " << _num_paints << ", uploads: " << _num_uploads <<
+        ", uploaded: " << _bytes_uploaded << " bytes (" << rate << " bytes/s)");
+}
+
 //----------------------------------------------------------------------------
 // cleanup
 //----------------------------------------------------------------------------
@@ -158,8 +261,12 @@ void Scope::cleanup()
         delete [] _vertices;
     }
     else {
-        // Clean up the shader program
+        // Clean up the shader program and buffers
         makeCurrent();
+        for (uint i=0; i<SCOPE_NUM_VBOS; i++) {
+            _vbo[i].destroy();
+            _vao[i].destroy();
+        }
         delete [] _vertices;
         delete _program;
         _program = nullptr;
@@ -191,19 +298,28 @@ void Scope::initializeGL()
     _program->link();
     _program->bind();
     _colour_loc = _program->uniformLocation("system_colour");
+    _vertex_mode_loc = _program->uniformLocation("vertex_mode");
+    _x_scale_loc = _program->uniformLocation("x_scale");
+    _min_height_loc = _program->uniformLocation("min_height");
     
-    // Create our Vertex Array Object (VAO), and bind it to our Vertex Buffer Object (VBO)
-    _vao.create();
-    QOpenGLVertexArrayObject::Binder vaoBinder(&_vao);
+    // Create our Vertex Array Objects (VAOs), each bound to a Vertex Buffer Object (VBO)
+    // The VBOs are allocated once, and the vertices streamed into them in turn,
+    // so an upload never waits for the GPU to finish drawing the previous frame
     QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
-    _vbo.create();
-    _vbo.bind();
-    _vbo.setUsagePattern(QOpenGLBuffer::DynamicDraw);
-    _vbo.allocate(_vertices, (_num_samples * 3 * 2) * sizeof(GLfloat));
-    f->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat),
-                             nullptr);
-    f->glEnableVertexAttribArray(0);
-    _vbo.release();
+    for (uint i=0; i<SCOPE_NUM_VBOS; i++) {
+        _vao[i].create();
+        QOpenGLVertexArrayObject::Binder vaoBinder(&_vao[i]);
+        _vbo[i].create();
+        _vbo[i].bind();
+        _vbo[i].setUsagePattern(QOpenGLBuffer::StreamDraw);
+        _vbo[i].allocate(_vertices, _vertices_size * sizeof(GLfloat));
+        f->glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat),
+                                 nullptr);
+        f->glEnableVertexAttribArray(0);
+        _vbo[i].release();
+    }
+    _vbo_index = 0;
+    _uploaded_seq = _vertices_seq;
     _program->release();
 }
 
@@ -215,19 +331,40 @@ void Scope::paintGL()
     // Clear the scope
     glClear(GL_COLOR_BUFFER_BIT);
 
-    // Get the VAO and bind it
-     QOpenGLVertexArrayObject::Binder vaoBinder(&_vao);
-    _program->bind();
+    // If the verticies have changed since they were last uploaded, stream them
+    // into the next VBO (glBufferSubData)
+    if (_uploaded_seq != _vertices_seq) {
+        uint size = (_num_vertices * 2) * sizeof(GLfloat);
+        _vbo_index = (_vbo_index + 1) % SCOPE_NUM_VBOS;
+        _vbo[_vbo_index].bind();
+        _vbo[_vbo_index].write(0, _vertices, size);
+        _vbo[_vbo_index].release();
+        _uploaded_seq = _vertices_seq;
+        _num_uploads++;
+        _bytes_uploaded += size;
+    }
+    _num_paints++;
 
-    // Update our VBO verticies and pen width
+    // Get the VAO for the current VBO and bind it, and set the pen width
+    QOpenGLVertexArrayObject::Binder vaoBinder(&_vao[_vbo_index]);
+    _program->bind();
     QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
-    _vbo.bind();
-    _vbo.allocate(_vertices, (_num_samples * 3 * 2) * sizeof(GLfloat));
     f->glLineWidth(_pen_width);
-    _vbo.release();
 
-    // Set the line colour and alpha, and draw the scope
+    // Set the vertex mapping, and the line colour and alpha
+    _program->setUniformValue(_vertex_mode_loc, (int)_vertex_mode);
     _program->setUniformValue(_colour_loc, QVector4D(_colour.redF(), _colour.greenF(), _colour.blueF(), _alpha));
-    glDrawArrays(GL_LINE_STRIP, 0, _num_samples);
+
+    // Draw the scope - an envelope is filled between the column min/max, and
+    // is at least the pen width high
+    if (_vertex_mode == ScopeVertexMode::ENVELOPE) {
+        _program->setUniformValue(_x_scale_loc, (2.0f / ((_num_vertices / 2) - 1)));
+        _program->setUniformValue(_min_height_loc, ((2.0f * _pen_width) / height()));
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, _num_vertices);
+    }
+    else {
+        _program->setUniformValue(_x_scale_loc, (2.0f / _num_samples));
+        glDrawArrays(GL_LINE_STRIP, 0, _num_samples);
+    }
     _program->release();
 }
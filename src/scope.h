@@ -18,6 +18,9 @@
 
 QT_FORWARD_DECLARE_CLASS(QOpenGLShaderProgram)
 
+// Constants
+constexpr uint SCOPE_NUM_VBOS = 2;
+
 // Scope Display Mode
 enum class ScopeDisplayMode
 {
@@ -25,13 +28,25 @@ enum class ScopeDisplayMode
 	BACKGROUND
 };
 
+// Scope Vertex Mode
+// How the vertex shader maps each vertex - the points are x/y, otherwise the
+// vertices are the raw L/R samples, mapped for the scope mode, or the min/max
+// of each column of an OSC envelope (drawn filled)
+enum class ScopeVertexMode : int
+{
+	POINTS,
+	OSC,
+	XY,
+	ENVELOPE
+};
+
 // Scope class
 class Scope : public QOpenGLWidget, protected QOpenGLFunctions
 {
 	Q_OBJECT
 public:
 	// Constructor
-	explicit Scope(uint num_samples, QWidget *parent = nullptr);
+	explicit Scope(uint num_samples, QWidget *parent = nullptr, uint max_envelope_columns = 0);
 	~Scope();
 
 	// Public functions
@@ -40,9 +55,13 @@ public:
 	void show();
 	void show(ScopeDisplayMode display_mode);
 	void hide(bool reset_display_mode=true);
+	void set_display_mode(ScopeDisplayMode display_mode);
 	void set_colour(QColor colour);
 	void set_pen_width(uint width);
 	void refresh_data(const QVector<QPointF>& data);
+	void refresh_data(const float *samples, uint num_samples, GuiScopeMode mode);
+	void refresh_envelope(const float *envelope, uint num_columns);
+	void print_stats(const char *name) const;
 
 public slots:
 	// Public slot functions
@@ -55,12 +74,27 @@ protected:
 
 private:
 	// Private data
-    QOpenGLVertexArrayObject _vao;
-    QOpenGLBuffer _vbo;
+    QOpenGLVertexArrayObject _vao[SCOPE_NUM_VBOS];
+    QOpenGLBuffer _vbo[SCOPE_NUM_VBOS];
+    uint _vbo_index;
     QOpenGLShaderProgram *_program;
 	int _colour_loc;
+	int _vertex_mode_loc;
+	int _x_scale_loc;
+	int _min_height_loc;
 	uint _num_samples;
+	uint _max_envelope_columns;
+	uint _vertices_size;
+	uint _num_vertices;
 	float *_vertices;
+	ScopeVertexMode _vertex_mode;
+	uint64_t _vertices_seq;
+	uint64_t _uploaded_seq;
+	uint64_t _num_paints;
+	uint64_t _num_uploads;
+	uint64_t _bytes_uploaded;
+	mutable uint64_t _last_print_time;
+	mutable uint64_t _last_print_bytes;
 	QColor _colour;
 	float _alpha;
 	uint _pen_width;
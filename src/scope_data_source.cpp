@@ -7,19 +7,21 @@
  *-----------------------------------------------------------------------------
  */
 
-#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include "scope.h"
 #include "scope_data_source.h"
+#include "scope_kernel.h"
 #include "common.h"
 #include "timer.h"
 
 // Constants
-constexpr uint REFRESH_RATE_MS        = ((1.f / 60.f) * 1000.f);
-constexpr uint SCOPE_IDLE_FRAME_COUNT = 60 * 3;
-const float PI                        = std::acos(-1);
-const float ROTATE_SCOPE_XY_ANGLE     = 45;
-const float ROTATE_SCOPE_XY_SIN       = std::sin((ROTATE_SCOPE_XY_ANGLE * PI) / 180.f);
-const float ROTATE_SCOPE_XY_COS       = std::cos((ROTATE_SCOPE_XY_ANGLE * PI) / 180.f);
+constexpr uint SCOPE_IDLE_FRAME_COUNT   = 60 * 3;
+constexpr uint SCOPE_SWAP_TIMEOUT_MS    = 100;
+constexpr uint DISPLAY_FRAME_PERIOD_US  = 1000000 / 60;
+constexpr uint SCOPE_STREAM_GAP_US      = 100000;
 
 //----------------------------------------------------------------------------
 // ScopeDataSource
@@ -29,17 +31,64 @@ ScopeDataSource::ScopeDataSource(GuiScopeMode& scope_mode, QObject *parent) :
     _scope_mode(scope_mode)
 {
     // Initialise class variables
-    _data1.clear();
-    _data2.clear();
-    for (uint i=0; i<SCOPE_NUM_SAMPLES; i++) {
-        float x = -1.0f + ((qreal(i) / SCOPE_NUM_SAMPLES) * 2);
-        _data1.append(QPointF(x, 0.0f));
-        _data2.append(QPointF(x, 0.0f));
-    }     
-    _data = &_data1;
+    for (ScopeFrame& frame : _frames.buffers()) {
+        frame.seq = 0;
+        frame.shown_seq = 0;
+        frame.active = false;
+        frame.idle_frames = 0;
+        frame.mode = GuiScopeMode::SCOPE_MODE_OSC;
+        frame.envelope = false;
+        frame.num_samples = SCOPE_NUM_SAMPLES;
+        std::memset(frame.samples, 0, sizeof(frame.samples));
+        frame.timing.traced = false;
+    }
+    _frame_seq = 0;
+    _shown_seq = 0;
+    _refreshed_seq = ~0ULL;
+    _refreshed_shown_seq = 0;
+    _frame_pending = false;
+    _swap_pending = false;
+    _frame_demand = false;
+    _frames_wanted = false;
     _scope = nullptr;
+    _latency = nullptr;
     _scope_idle_threshold = 0.0f;
+    _timebase_frames = SCOPE_NUM_SAMPLES;
+    _envelope_columns = SCOPE_ENVELOPE_MAX_COLUMNS;
+    _idle_frames = 0;
     _scope_idle_frame_count = 0;
+    _last_presented_time = 0;
+    _num_presented = 0;
+    _num_duplicates = 0;
+    _num_skipped = 0;
+    _num_swap_timeouts = 0;
+
+    // The frame ready signal is emitted from the scope message thread, so is
+    // always queued to the GUI thread
+    QObject::connect(this, &ScopeDataSource::frame_ready, this, &ScopeDataSource::process_frame_ready, Qt::QueuedConnection);
+
+    // Setup the swap timeout timer - if the scope is hidden before a requested
+    // repaint, there is no frame swap to wait for
+    _swap_timeout_timer.setInterval(SCOPE_SWAP_TIMEOUT_MS);
+    _swap_timeout_timer.setSingleShot(true);
+    QObject::connect(&_swap_timeout_timer, &QTimer::timeout, this, &ScopeDataSource::swap_timeout);
+
+    // Create the event used to demand frames from the scope message thread
+    _demand_event_fd = ::eventfd(0, (EFD_CLOEXEC | EFD_NONBLOCK));
+    if (_demand_event_fd == -1) {
+        // This is not fatal, the scope message thread then reads the frames
+        // at the display rate
+        MSG("ScopeDataSource: ERROR: Could not create the frame demand event: " << errno);
+    }
+
+    // Setup the frame demand timer - if a refreshed frame is not repainted,
+    // there is no frame swap to pace the next frame demand
+    // The frame demand is started from the scope message thread, so the first
+    // frame request is always queued to the GUI thread
+    _demand_timer.setInterval(DISPLAY_FRAME_PERIOD_US / 1000);
+    _demand_timer.setSingleShot(true);
+    QObject::connect(&_demand_timer, &QTimer::timeout, this, &ScopeDataSource::demand_timeout);
+    QObject::connect(this, &ScopeDataSource::frame_demand_started, this, &ScopeDataSource::request_frame, Qt::QueuedConnection);
 }
 
 //----------------------------------------------------------------------------
@@ -47,100 +96,151 @@ ScopeDataSource::ScopeDataSource(GuiScopeMode& scope_mode, QObject *parent) :
 //----------------------------------------------------------------------------
 ScopeDataSource::~ScopeDataSource()
 {
-    // Nothing specific to do
+    // Close the frame demand event
+    if (_demand_event_fd != -1)
+        ::close(_demand_event_fd);
 }
 
 //----------------------------------------------------------------------------
 // start
 //----------------------------------------------------------------------------
-void ScopeDataSource::start(Scope *scope)
+void ScopeDataSource::start(Scope *scope, GuiMsgLatency *latency)
 {
-    // Save the scope and calculate the idle threshold (+/- 1px)
+    // Save the scope and latency (if any), and calculate the idle threshold (+/- 1px)
     _scope = scope;
+    _latency = latency;
     _scope_idle_threshold = 1.0f / (_scope->height() / 2);
 
-    // Start the scope refresh timer
-    _scope_refresh_timer.setInterval(REFRESH_RATE_MS);
-    _scope_refresh_timer.setSingleShot(false);
-    QObject::connect(&_scope_refresh_timer, &QTimer::timeout, this, &ScopeDataSource::refreshSeries);
-    _scope_refresh_timer.start();
+    // Pace the scope refresh by its frame swaps, and refresh any pending frame
+    QObject::connect(_scope, &Scope::frameSwapped, this, &ScopeDataSource::frame_swapped, Qt::UniqueConnection);
+    refreshSeries();
 }
 
 //----------------------------------------------------------------------------
 // updateData
+// Returns true if the frame is to be shown
 //----------------------------------------------------------------------------
-void ScopeDataSource::updateData(float *samples)
+bool ScopeDataSource::updateData(float *samples, const GuiMsgTiming& timing)
 {
-    // Get the alternate data to update and clear it
-    QVector<QPointF>& data = (_data == &_data1) ? _data2 : _data1;
-    data.clear();
+    // Get the frame to update (the triple buffer back buffer) and clear it
+    // Note: This is called from the scope message thread, so must not access
+    // the scope widget - the GUI thread applies any visibility changes
+    ScopeFrame& frame = _frames.write_buffer();
+    frame.envelope = false;
+    frame.num_samples = 0;
+    float peak = 0.0f;
 
     // If there is a scope mode
-    if (_scope_mode != GuiScopeMode::SCOPE_MODE_OFF) {
-        bool scope_idle = _scope->display_mode() == ScopeDisplayMode::BACKGROUND;
-
-        // Add the points to the data
-        for (uint i=0; i<SCOPE_NUM_SAMPLES; i++) {
-            QPointF point;
-
-            // Get the L/R samples
-            auto l_sample = *samples++;
-            auto r_sample = *samples++;
-
-            // If the scope samples are idle so far
-            if (scope_idle) {
-                // Check if these L and R samples are no longer idle
-                if ((l_sample < -(_scope_idle_threshold)) || (l_sample > _scope_idle_threshold) ||
-                    (r_sample < -(_scope_idle_threshold)) || (r_sample > _scope_idle_threshold)) {
-                    // No longer idle - make sure the scope is shown if it is in
-                    // background
-                    if (_scope->display_mode() == ScopeDisplayMode::BACKGROUND) {
-                        _scope->show();
-                    }
-                    _scope_idle_frame_count = 0;
-                    scope_idle = false;
-                }
-            }
-
-            // Check the scope mode
-            if (_scope_mode == GuiScopeMode::SCOPE_MODE_OSC) {
-                // Oscillator - add the scope point
-                qreal x = ((qreal(i) / qreal(SCOPE_NUM_SAMPLES)) * 2) - 1.0;
-                qreal y = l_sample + r_sample;
-                point = QPointF(x, y);
-            }
-            else {
-                // X/Y - add the scope point (rotated)
-                point = _rotate_point(l_sample, r_sample);             
-            }
-            data.append(point);
-        }
+    GuiScopeMode scope_mode = _scope_mode;
+    if (scope_mode != GuiScopeMode::SCOPE_MODE_OFF) {
+        // Copy the samples (the scope maps them for the mode), and get the
+        // peak sample
+        peak = ScopeKernel::copy_peak(samples, SCOPE_NUM_SAMPLES, frame.samples);
+        frame.mode = scope_mode;
+        frame.num_samples = SCOPE_NUM_SAMPLES;
+    }
+    return _publish_frame(frame, peak, timing);
+}
 
-        // If the scope is currently shown in the background and these samples were idle
-        if (scope_idle && _scope->shown() && (_scope->display_mode() == ScopeDisplayMode::BACKGROUND)) {
-            // Increment the idle frame count, and if it exceeds the idle
-            // threshold then hide the scope (don't reset the display mode when hiding)
-            _scope_idle_frame_count++;
-            if (_scope_idle_frame_count >= SCOPE_IDLE_FRAME_COUNT) {
-                _scope->hide(false);
-                _scope_idle_frame_count = 0;      
-            }
-        }
+//----------------------------------------------------------------------------
+// updateEnvelope
+// Returns true if the frame is to be shown
+//----------------------------------------------------------------------------
+bool ScopeDataSource::updateEnvelope(const ScopeEnvelope& envelope, const GuiMsgTiming& timing)
+{
+    // Get the frame to update (the triple buffer back buffer) and clear it
+    // Note: This is called from the scope message thread (see updateData)
+    ScopeFrame& frame = _frames.write_buffer();
+    frame.envelope = true;
+    frame.num_samples = 0;
+    float peak = 0.0f;
+
+    // The envelope is only shown in OSC mode
+    GuiScopeMode scope_mode = _scope_mode;
+    if (scope_mode == GuiScopeMode::SCOPE_MODE_OSC) {
+        // Read the envelope columns, and get the peak
+        peak = envelope.read(frame.samples);
+        frame.mode = scope_mode;
+        frame.num_samples = envelope.num_columns();
     }
+    return _publish_frame(frame, peak, timing);
+}
+
+//----------------------------------------------------------------------------
+// set_timebase
+//----------------------------------------------------------------------------
+void ScopeDataSource::set_timebase(uint num_frames, uint num_columns)
+{
+    // Set the OSC timebase, and the number of columns any envelope is reduced to
+    // (the scope width) - the scope message thread applies them
+    _timebase_frames = std::clamp(num_frames, SCOPE_NUM_SAMPLES, SCOPE_MAX_TIMEBASE_FRAMES);
+    _envelope_columns = std::clamp(num_columns, 1U, SCOPE_ENVELOPE_MAX_COLUMNS);
+}
+
+//----------------------------------------------------------------------------
+// timebase_frames
+//----------------------------------------------------------------------------
+uint ScopeDataSource::timebase_frames() const
+{
+    return _timebase_frames.load(std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// envelope_columns
+//----------------------------------------------------------------------------
+uint ScopeDataSource::envelope_columns() const
+{
+    return _envelope_columns.load(std::memory_order_relaxed);
+}
 
-    // Set the data pointer to the updated data
-    _data = &data;    
+//----------------------------------------------------------------------------
+// scope_mode
+//----------------------------------------------------------------------------
+GuiScopeMode ScopeDataSource::scope_mode() const
+{
+    return _scope_mode;
+}
+
+//----------------------------------------------------------------------------
+// start_frame_demand
+// Called from the scope message thread when it reads the frames on demand
+//----------------------------------------------------------------------------
+void ScopeDataSource::start_frame_demand()
+{
+    // Enable the frame demand, and request the first frame
+    _frame_demand = true;
+    emit frame_demand_started();
+}
+
+//----------------------------------------------------------------------------
+// demand_event_fd
+//----------------------------------------------------------------------------
+int ScopeDataSource::demand_event_fd() const
+{
+    return _demand_event_fd;
+}
+
+//----------------------------------------------------------------------------
+// frames_wanted
+// Called from the scope message thread - returns false if the scope is off
+// or hidden, so no frames are needed
+//----------------------------------------------------------------------------
+bool ScopeDataSource::frames_wanted() const
+{
+    return _frames_wanted.load(std::memory_order_acquire);
 }
 
 //----------------------------------------------------------------------------
-// _rotate_point
+// update_frame_demand
+// Called when the scope is shown or hidden
 //----------------------------------------------------------------------------
-QPointF ScopeDataSource::_rotate_point(float x, float y)
+void ScopeDataSource::update_frame_demand()
 {
-    // Rotate the point
-    qreal rotated_x = (x * ROTATE_SCOPE_XY_COS) - (y * ROTATE_SCOPE_XY_SIN);
-    qreal rotated_y = (x * ROTATE_SCOPE_XY_SIN) + (y * ROTATE_SCOPE_XY_COS);
-    return QPointF(rotated_x, rotated_y);
+    // If the scope now wants frames, or no longer wants them, wake the scope
+    // message thread so it starts or stops reading them
+    bool wanted = _samples_wanted();
+    if ((_frames_wanted.exchange(wanted, std::memory_order_acq_rel) != wanted) && _frame_demand)
+        _signal_demand();
 }
 
 //----------------------------------------------------------------------------
@@ -148,8 +248,232 @@ QPointF ScopeDataSource::_rotate_point(float x, float y)
 //----------------------------------------------------------------------------
 void ScopeDataSource::refreshSeries()
 {
-    // Refresh the scope
+    // Clear the pending flag before taking the frame, so any frame published
+    // after this is signalled
+    _frame_pending.store(false, std::memory_order_release);
+
+    // Refresh the scope if a new frame has arrived
     if (_scope) {
-        _scope->refresh_data(*_data);
+        _frames.update();
+        ScopeFrame& frame = _frames.read_buffer();
+        if (frame.seq == _refreshed_seq)
+            return;
+        uint num_new_frames = frame.seq - _refreshed_seq;
+
+        // Count the frames to be shown that were overwritten before the GUI
+        // thread took them
+        if ((frame.shown_seq - _refreshed_shown_seq) > 1)
+            _num_skipped += frame.shown_seq - _refreshed_shown_seq - 1;
+        _refreshed_shown_seq = frame.shown_seq;
+        _refreshed_seq = frame.seq;
+        _update_visibility(frame, num_new_frames);
+
+        // If the frame is traced, set when it was refreshed
+        uint64_t started = frame.timing.traced ? GuiMsgLatency::now() : 0;
+        frame.envelope ?
+            _scope->refresh_envelope(frame.samples, frame.num_samples) :
+            _scope->refresh_data(frame.samples, frame.num_samples, frame.mode);
+        if (frame.timing.traced && _latency) {
+            frame.timing.started = started;
+            frame.timing.applied = GuiMsgLatency::now();
+            _latency->applied(frame.timing);
+        }
+
+        // If the scope will be repainted, hold any further frames until it
+        // has been swapped - otherwise there is no swap to demand the next
+        // frame, so demand it after a display frame
+        if ((frame.num_samples > 0) && _scope->isVisible()) {
+            _swap_pending = true;
+            _swap_timeout_timer.start();
+        }
+        else if (_frame_demand) {
+            _demand_timer.start();
+        }
     }
 }
+
+//----------------------------------------------------------------------------
+// process_frame_ready
+//----------------------------------------------------------------------------
+void ScopeDataSource::process_frame_ready()
+{
+    // Refresh the scope now, unless a repaint is already pending - the frame
+    // is then refreshed when the scope is swapped
+    if (!_swap_pending)
+        refreshSeries();
+}
+
+//----------------------------------------------------------------------------
+// frame_swapped
+//----------------------------------------------------------------------------
+void ScopeDataSource::frame_swapped()
+{
+    // Ignore swaps not requested by a refresh (e.g. exposes)
+    if (!_swap_pending)
+        return;
+    _swap_pending = false;
+    _swap_timeout_timer.stop();
+
+    // Record the interval since the last presented frame, unless the stream
+    // was paused - each display frame in the interval after the first showed
+    // the previous scope frame again
+    uint64_t now = GuiMsgLatency::now();
+    uint64_t interval_us = (now - _last_presented_time) / 1000;
+    if ((_num_presented > 0) && (interval_us < SCOPE_STREAM_GAP_US)) {
+        _frame_intervals.record(interval_us);
+        uint display_frames = (interval_us + (DISPLAY_FRAME_PERIOD_US / 2)) / DISPLAY_FRAME_PERIOD_US;
+        if (display_frames > 1)
+            _num_duplicates += display_frames - 1;
+    }
+    _last_presented_time = now;
+    _num_presented++;
+
+    // Refresh any frame that arrived while the repaint was pending, and
+    // demand the next frame
+    if (_frame_pending.load(std::memory_order_acquire))
+        refreshSeries();
+    request_frame();
+}
+
+//----------------------------------------------------------------------------
+// swap_timeout
+//----------------------------------------------------------------------------
+void ScopeDataSource::swap_timeout()
+{
+    // The scope was not repainted (e.g. it was hidden), so stop waiting for
+    // the swap and refresh any pending frame
+    _swap_pending = false;
+    _num_swap_timeouts++;
+    if (_frame_pending.load(std::memory_order_acquire))
+        refreshSeries();
+    request_frame();
+}
+
+//----------------------------------------------------------------------------
+// request_frame
+//----------------------------------------------------------------------------
+void ScopeDataSource::request_frame()
+{
+    // Ignore if the frames are not read on demand
+    if (!_frame_demand)
+        return;
+
+    // Wake the scope message thread to read a new frame - if the scope is off
+    // or hidden it instead waits until the scope is shown
+    _frames_wanted.store(_samples_wanted(), std::memory_order_release);
+    _signal_demand();
+}
+
+//----------------------------------------------------------------------------
+// demand_timeout
+//----------------------------------------------------------------------------
+void ScopeDataSource::demand_timeout()
+{
+    // If a repaint is now pending, its frame swap demands the next frame
+    if (!_swap_pending)
+        request_frame();
+}
+
+//----------------------------------------------------------------------------
+// print_stats
+//----------------------------------------------------------------------------
+void ScopeDataSource::print_stats() const
+{
+    // Show the presented frames and the interval between them (us), with the
+    // jitter (p99 - p50), and the duplicated and skipped frames
+    uint64_t p50 = _frame_intervals.percentile(50.0f);
+    uint64_t p99 = _frame_intervals.percentile(99.0f);
+    MSG("Scope frames: presented: " << _num_presented << ", duplicated: " << _num_duplicates <<
+        ", skipped: " << _num_skipped << ", swap timeouts: " << _num_swap_timeouts);
+    MSG("Scope frame interval (us): mean: " << _frame_intervals.mean() << ", p50: " << p50 <<
+        ", p99: " << p99 << ", max: " << _frame_intervals.max() << ", jitter: " << (p99 - std::min(p99, p50)));
+}
+
+//----------------------------------------------------------------------------
+// _publish_frame
+// Called from the scope message thread, returns true if the frame is to be
+// shown
+//----------------------------------------------------------------------------
+bool ScopeDataSource::_publish_frame(ScopeFrame& frame, float peak, const GuiMsgTiming& timing)
+{
+    // Set the frame sequence and timing
+    frame.seq = ++_frame_seq;
+    frame.active = false;
+    frame.idle_frames = 0;
+    frame.timing = timing;
+
+    // If there are samples, check if they are idle, and count the consecutive
+    // idle frames
+    if (frame.num_samples > 0) {
+        frame.active = peak > _scope_idle_threshold.load(std::memory_order_relaxed);
+        _idle_frames = frame.active ? 0 : (_idle_frames + 1);
+        frame.idle_frames = _idle_frames;
+    }
+
+    // There is nothing to show if the scope is off, or once the samples have
+    // been idle long enough to hide the scope
+    bool show = (frame.num_samples > 0) && (frame.idle_frames <= SCOPE_IDLE_FRAME_COUNT);
+    if (show)
+        _shown_seq++;
+    frame.shown_seq = _shown_seq;
+
+    // Publish the updated frame, and if it is to be shown signal the GUI
+    // thread - unless it has not yet taken the last frame signalled
+    _frames.publish();
+    if (show && !_frame_pending.exchange(true, std::memory_order_acq_rel))
+        emit frame_ready();
+    return show;
+}
+
+//----------------------------------------------------------------------------
+// _update_visibility
+//----------------------------------------------------------------------------
+void ScopeDataSource::_update_visibility(const ScopeFrame& frame, uint num_new_frames)
+{
+    // Only applies to scope frames shown in the background
+    if ((frame.num_samples == 0) || (_scope->display_mode() != ScopeDisplayMode::BACKGROUND))
+        return;
+
+    // If the samples are active, make sure the scope is shown
+    if (frame.active) {
+        if (!_scope->shown()) {
+            _scope->show();
+        }
+        _scope_idle_frame_count = 0;
+    }
+    else if (_scope->shown()) {
+        // Increment the idle frame count by the frames since the last refresh
+        // (but no more than the consecutive idle frames), and if it exceeds the
+        // idle threshold then hide the scope (don't reset the display mode when
+        // hiding)
+        _scope_idle_frame_count = std::min((_scope_idle_frame_count + num_new_frames), frame.idle_frames);
+        if (_scope_idle_frame_count >= SCOPE_IDLE_FRAME_COUNT) {
+            _scope->hide(false);
+            _scope_idle_frame_count = 0;
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// _signal_demand
+//----------------------------------------------------------------------------
+void ScopeDataSource::_signal_demand()
+{
+    // Signal the frame demand event
+    if (_demand_event_fd != -1) {
+        uint64_t event = 1;
+        (void)::write(_demand_event_fd, &event, sizeof(event));
+    }
+}
+
+//----------------------------------------------------------------------------
+// _samples_wanted
+// Returns true if the scope is shown, or is hidden in the background while
+// the samples are idle (the samples must be read to show it when they become
+// active)
+//----------------------------------------------------------------------------
+bool ScopeDataSource::_samples_wanted() const
+{
+    return _scope && (_scope_mode != GuiScopeMode::SCOPE_MODE_OFF) &&
+           (_scope->isVisible() || (_scope->display_mode() == ScopeDisplayMode::BACKGROUND));
+}
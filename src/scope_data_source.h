@@ -9,14 +9,57 @@
 #ifndef SCOPE_DATA_SOURCE_H
 #define SCOPE_DATA_SOURCE_H
 
+#include <algorithm>
+#include <atomic>
 #include <QtCore/QObject>
 #include <QtWidgets/QLabel>
 #include <QtCore/QElapsedTimer>
 #include <QtCore/QTimer>
 #include "scope.h"
 #include "common.h"
+#include "gui_msg_latency.h"
+#include "scope_envelope.h"
+#include "triple_buffer.h"
+
+// Constants
+constexpr uint SCOPE_FRAME_MAX_VALUES = std::max((SCOPE_NUM_SAMPLES * 2), (SCOPE_ENVELOPE_MAX_COLUMNS * 2));
+
+// Scope frame
+// A complete frame of raw scope samples (interleaved L/R) and the scope mode
+// to show them in (the scope maps them in its vertex shader) - the sequence number is incremented for
+// each frame, so the GUI thread can tell if a new frame has arrived
+// For a long timebase the frame is instead an OSC min/max envelope, with the
+// number of samples being the number of columns (interleaved min/max)
+// The frame is active if its peak exceeds the idle threshold, otherwise the
+// idle frames are the number of consecutive idle frames up to this one
+// The shown sequence number only counts the frames signalled to the GUI thread
+// (with samples to show), so it can tell how many it skipped
+struct ScopeFrame
+{
+    uint64_t seq;
+    uint64_t shown_seq;
+    bool active;
+    uint idle_frames;
+    GuiScopeMode mode;
+    bool envelope;
+    uint num_samples;
+    float samples[SCOPE_FRAME_MAX_VALUES];
+    GuiMsgTiming timing;
+};
 
 // Scope Data Source class
+// The scope frames are passed from the scope message thread to the GUI thread
+// via a lock-free triple buffer. The GUI thread is only signalled when a new
+// frame is pending, and the scope refresh is paced by its frame swaps (vsync)
+// - at most one new frame is applied per swap, and nothing is refreshed while
+// the scope samples are idle or off
+// When the samples are read from the scope sample ring, the scope message
+// thread reads a frame only when the GUI thread demands one - once per frame
+// swap while the scope is repainted. Once a frame has nothing new to show (no
+// new samples, or the samples are idle) the GUI thread is not signalled and so
+// demands no more frames, and the scope message thread instead watches the
+// ring write index at a slow rate until there is a frame to show. Nothing is
+// read while the scope is off or hidden
 class ScopeDataSource : public QObject
 {
     Q_OBJECT
@@ -24,25 +67,65 @@ public:
     ScopeDataSource(GuiScopeMode& scope_mode, QObject *parent=0);
     ~ScopeDataSource();
 
-    void start(Scope *scope);
-    void updateData(float *samples);
+    void start(Scope *scope, GuiMsgLatency *latency=nullptr);
+    bool updateData(float *samples, const GuiMsgTiming& timing);
+    bool updateEnvelope(const ScopeEnvelope& envelope, const GuiMsgTiming& timing);
+    void set_timebase(uint num_frames, uint num_columns);
+    uint timebase_frames() const;
+    uint envelope_columns() const;
+    GuiScopeMode scope_mode() const;
+    void start_frame_demand();
+    int demand_event_fd() const;
+    bool frames_wanted() const;
+    void update_frame_demand();
+    void print_stats() const;
+
+signals:
+    void frame_ready();
+    void frame_demand_started();
 
 public slots:
     void refreshSeries();
+    void process_frame_ready();
+    void frame_swapped();
+    void swap_timeout();
+    void request_frame();
+    void demand_timeout();
 
 private:
     // Private data
     GuiScopeMode& _scope_mode;
-    QVector<QPointF> _data1;
-    QVector<QPointF> _data2;
-    QVector<QPointF> *_data;
-    QTimer _scope_refresh_timer;
+    TripleBuffer<ScopeFrame> _frames;
+    uint64_t _frame_seq;
+    uint64_t _shown_seq;
+    uint64_t _refreshed_seq;
+    uint64_t _refreshed_shown_seq;
+    std::atomic<bool> _frame_pending;
+    bool _swap_pending;
+    QTimer _swap_timeout_timer;
+    std::atomic<bool> _frame_demand;
+    std::atomic<bool> _frames_wanted;
+    int _demand_event_fd;
+    QTimer _demand_timer;
     Scope *_scope;
-    float _scope_idle_threshold;
+    GuiMsgLatency *_latency;
+    std::atomic<float> _scope_idle_threshold;
+    std::atomic<uint> _timebase_frames;
+    std::atomic<uint> _envelope_columns;
+    uint _idle_frames;
     uint _scope_idle_frame_count;
+    uint64_t _last_presented_time;
+    LatencyHistogram _frame_intervals;
+    uint64_t _num_presented;
+    uint64_t _num_duplicates;
+    uint64_t _num_skipped;
+    uint64_t _num_swap_timeouts;
 
     // Private functions
-    QPointF _rotate_point(float x, float y);
+    bool _publish_frame(ScopeFrame& frame, float peak, const GuiMsgTiming& timing);
+    void _update_visibility(const ScopeFrame& frame, uint num_new_frames);
+    void _signal_demand();
+    bool _samples_wanted() const;
 };
 
 #endif
@@ -0,0 +1,119 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  scope_envelope.cpp
+ * @brief Scope Envelope class implementation.
+ *-----------------------------------------------------------------------------
+ */
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "scope_envelope.h"
+#include "scope_kernel.h"
+
+//----------------------------------------------------------------------------
+// ScopeEnvelope
+//----------------------------------------------------------------------------
+ScopeEnvelope::ScopeEnvelope()
+{
+    // Initialise class variables
+    configure(SCOPE_ENVELOPE_MAX_COLUMNS, SCOPE_ENVELOPE_MAX_COLUMNS);
+}
+
+//----------------------------------------------------------------------------
+// configure
+// Sets the timebase and number of columns, and resets the envelope
+//----------------------------------------------------------------------------
+void ScopeEnvelope::configure(uint timebase_frames, uint num_columns)
+{
+    // There can be no more columns than frames - each bin is then the same
+    // whole number of frames, so the window may be slightly shorter than the
+    // timebase
+    _timebase_frames = std::max(timebase_frames, 1U);
+    _num_columns = std::min(std::clamp(num_columns, 1U, SCOPE_ENVELOPE_MAX_COLUMNS), _timebase_frames);
+    _bin_frames = _timebase_frames / _num_columns;
+    reset();
+}
+
+//----------------------------------------------------------------------------
+// reset
+//----------------------------------------------------------------------------
+void ScopeEnvelope::reset()
+{
+    // Clear the bins (silent) and start a new bin
+    std::fill_n(_bins, (_num_columns * 2), 0.0f);
+    _next_bin = 0;
+    _num_bin_frames = 0;
+    _bin_min = FLT_MAX;
+    _bin_max = -FLT_MAX;
+}
+
+//----------------------------------------------------------------------------
+// process
+// Adds a block of interleaved L/R frames to the envelope
+//----------------------------------------------------------------------------
+void ScopeEnvelope::process(const float *samples, uint num_frames)
+{
+    // Reduce the frames into the current bin, and each time it is complete
+    // add it to the envelope (replacing the oldest bin)
+    while (num_frames > 0) {
+        uint n = std::min(num_frames, (_bin_frames - _num_bin_frames));
+        ScopeKernel::min_max(samples, n, _bin_min, _bin_max);
+        samples += (n * 2);
+        num_frames -= n;
+        _num_bin_frames += n;
+        if (_num_bin_frames == _bin_frames) {
+            _bins[(_next_bin * 2)] = _bin_min;
+            _bins[(_next_bin * 2) + 1] = _bin_max;
+            _next_bin = (_next_bin + 1) % _num_columns;
+            _num_bin_frames = 0;
+            _bin_min = FLT_MAX;
+            _bin_max = -FLT_MAX;
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// read
+// Reads the complete bins, oldest first, as interleaved min/max pairs - one
+// per column - and returns the peak absolute value
+//----------------------------------------------------------------------------
+float ScopeEnvelope::read(float *envelope) const
+{
+    // Copy the bins from the oldest (the next bin to be replaced)
+    uint num_oldest = (_num_columns - _next_bin) * 2;
+    std::copy_n((_bins + (_next_bin * 2)), num_oldest, envelope);
+    std::copy_n(_bins, (_next_bin * 2), (envelope + num_oldest));
+
+    // Get the peak
+    float peak = 0.0f;
+    for (uint i=0; i<(_num_columns * 2); i++)
+        peak = std::max(peak, std::fabs(_bins[i]));
+    return peak;
+}
+
+//----------------------------------------------------------------------------
+// timebase_frames
+//----------------------------------------------------------------------------
+uint ScopeEnvelope::timebase_frames() const
+{
+    return _timebase_frames;
+}
+
+//----------------------------------------------------------------------------
+// num_columns
+//----------------------------------------------------------------------------
+uint ScopeEnvelope::num_columns() const
+{
+    return _num_columns;
+}
+
+//----------------------------------------------------------------------------
+// window_frames
+// Returns the number of frames covered by the envelope
+//----------------------------------------------------------------------------
+uint ScopeEnvelope::window_frames() const
+{
+    return _bin_frames * _num_columns;
+}
@@ -0,0 +1,47 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  scope_envelope.h
+ * @brief Scope Envelope class definitions.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef SCOPE_ENVELOPE_H
+#define SCOPE_ENVELOPE_H
+
+#include "common.h"
+
+// Scope Envelope class
+// Min/max (peak envelope) decimator for long scope timebases. The timebase is
+// split into one bin per display column, and the stream of samples is reduced
+// to the min and max OSC value (L+R) of each bin as it arrives - so each sample
+// is only processed once, and the envelope always has the same number of
+// columns however long the timebase
+class ScopeEnvelope
+{
+public:
+    // Constructor
+    ScopeEnvelope();
+
+    // Public functions
+    void configure(uint timebase_frames, uint num_columns);
+    void reset();
+    void process(const float *samples, uint num_frames);
+    float read(float *envelope) const;
+    uint timebase_frames() const;
+    uint num_columns() const;
+    uint window_frames() const;
+
+private:
+    // Private data
+    float _bins[SCOPE_ENVELOPE_MAX_COLUMNS * 2];
+    uint _timebase_frames;
+    uint _num_columns;
+    uint _bin_frames;
+    uint _next_bin;
+    uint _num_bin_frames;
+    float _bin_min;
+    float _bin_max;
+};
+
+#endif  // SCOPE_ENVELOPE_H
@@ -0,0 +1,151 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  scope_kernel.cpp
+ * @brief Scope Kernel class implementation.
+ *-----------------------------------------------------------------------------
+ */
+#include <algorithm>
+#include <cmath>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "scope_kernel.h"
+
+//----------------------------------------------------------------------------
+// copy_peak
+//----------------------------------------------------------------------------
+float ScopeKernel::copy_peak(const float *samples, uint num_frames, float *dst)
+{
+#if defined(__ARM_NEON) || defined(__SSE2__)
+    // Copy 4 samples (2 frames) at a time, and track the peak
+    uint num_samples = num_frames * 2;
+    uint num_vector_samples = num_samples & ~3U;
+    float peak;
+#if defined(__ARM_NEON)
+    float32x4_t peak_v = vdupq_n_f32(0.0f);
+    for (uint i=0; i<num_vector_samples; i+=4) {
+        float32x4_t s = vld1q_f32(samples + i);
+        peak_v = vmaxq_f32(peak_v, vabsq_f32(s));
+        vst1q_f32(dst + i, s);
+    }
+    float32x2_t peak_h = vpmax_f32(vget_low_f32(peak_v), vget_high_f32(peak_v));
+    peak = vget_lane_f32(vpmax_f32(peak_h, peak_h), 0);
+#else
+    __m128 abs_mask_v = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 peak_v = _mm_setzero_ps();
+    for (uint i=0; i<num_vector_samples; i+=4) {
+        __m128 s = _mm_loadu_ps(samples + i);
+        peak_v = _mm_max_ps(peak_v, _mm_and_ps(s, abs_mask_v));
+        _mm_storeu_ps(dst + i, s);
+    }
+    peak_v = _mm_max_ps(peak_v, _mm_shuffle_ps(peak_v, peak_v, _MM_SHUFFLE(1, 0, 3, 2)));
+    peak_v = _mm_max_ps(peak_v, _mm_shuffle_ps(peak_v, peak_v, _MM_SHUFFLE(2, 3, 0, 1)));
+    peak = _mm_cvtss_f32(peak_v);
+#endif
+
+    // Copy any remaining frame
+    if (num_vector_samples < num_samples) {
+        uint first_frame = num_vector_samples / 2;
+        peak = std::max(peak, copy_peak_scalar((samples + num_vector_samples), (num_frames - first_frame), (dst + num_vector_samples)));
+    }
+    return peak;
+#else
+    return copy_peak_scalar(samples, num_frames, dst);
+#endif
+}
+
+//----------------------------------------------------------------------------
+// copy_peak_scalar
+//----------------------------------------------------------------------------
+float ScopeKernel::copy_peak_scalar(const float *samples, uint num_frames, float *dst)
+{
+    float peak = 0.0f;
+
+    // Copy each sample, and track the peak
+    for (uint i=0; i<(num_frames * 2); i++) {
+        float sample = samples[i];
+        peak = std::max(peak, std::fabs(sample));
+        dst[i] = sample;
+    }
+    return peak;
+}
+
+//----------------------------------------------------------------------------
+// min_max
+// Updates the min and max with the min and max OSC value (L+R) of the frames
+//----------------------------------------------------------------------------
+void ScopeKernel::min_max(const float *samples, uint num_frames, float& min, float& max)
+{
+#if defined(__ARM_NEON) || defined(__SSE2__)
+    // Reduce 4 frames at a time
+    uint num_vector_frames = num_frames & ~3U;
+    if (num_vector_frames > 0) {
+#if defined(__ARM_NEON)
+        float32x4_t min_v = vdupq_n_f32(min);
+        float32x4_t max_v = vdupq_n_f32(max);
+        for (uint i=0; i<num_vector_frames; i+=4) {
+            float32x4x2_t lr = vld2q_f32(samples + (i * 2));
+            float32x4_t s = vaddq_f32(lr.val[0], lr.val[1]);
+            min_v = vminq_f32(min_v, s);
+            max_v = vmaxq_f32(max_v, s);
+        }
+        float32x2_t min_h = vpmin_f32(vget_low_f32(min_v), vget_high_f32(min_v));
+        float32x2_t max_h = vpmax_f32(vget_low_f32(max_v), vget_high_f32(max_v));
+        min = vget_lane_f32(vpmin_f32(min_h, min_h), 0);
+        max = vget_lane_f32(vpmax_f32(max_h, max_h), 0);
+#else
+        __m128 min_v = _mm_set1_ps(min);
+        __m128 max_v = _mm_set1_ps(max);
+        for (uint i=0; i<num_vector_frames; i+=4) {
+            __m128 a = _mm_loadu_ps(samples + (i * 2));
+            __m128 b = _mm_loadu_ps(samples + (i * 2) + 4);
+            __m128 s = _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+            min_v = _mm_min_ps(min_v, s);
+            max_v = _mm_max_ps(max_v, s);
+        }
+        min_v = _mm_min_ps(min_v, _mm_shuffle_ps(min_v, min_v, _MM_SHUFFLE(1, 0, 3, 2)));
+        min_v = _mm_min_ps(min_v, _mm_shuffle_ps(min_v, min_v, _MM_SHUFFLE(2, 3, 0, 1)));
+        max_v = _mm_max_ps(max_v, _mm_shuffle_ps(max_v, max_v, _MM_SHUFFLE(1, 0, 3, 2)));
+        max_v = _mm_max_ps(max_v, _mm_shuffle_ps(max_v, max_v, _MM_SHUFFLE(2, 3, 0, 1)));
+        min = _mm_cvtss_f32(min_v);
+        max = _mm_cvtss_f32(max_v);
+#endif
+    }
+
+    // Reduce any remaining frames
+    min_max_scalar((samples + (num_vector_frames * 2)), (num_frames - num_vector_frames), min, max);
+#else
+    min_max_scalar(samples, num_frames, min, max);
+#endif
+}
+
+//----------------------------------------------------------------------------
+// min_max_scalar
+//----------------------------------------------------------------------------
+void ScopeKernel::min_max_scalar(const float *samples, uint num_frames, float& min, float& max)
+{
+    // Reduce each frame
+    for (uint i=0; i<num_frames; i++) {
+        float sample = samples[(i * 2)] + samples[(i * 2) + 1];
+        min = std::min(min, sample);
+        max = std::max(max, sample);
+    }
+}
+
+//----------------------------------------------------------------------------
+// simd_name
+//----------------------------------------------------------------------------
+const char *ScopeKernel::simd_name()
+{
+#if defined(__ARM_NEON)
+    return "NEON";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "none";
+#endif
+}
@@ -0,0 +1,33 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  scope_kernel.h
+ * @brief Scope Kernel class definitions.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef SCOPE_KERNEL_H
+#define SCOPE_KERNEL_H
+
+#include "common.h"
+
+// Scope Kernel class
+// The scope maps the raw L/R samples to vertices in its vertex shader, so the
+// CPU only copies a frame of interleaved L/R samples and returns the peak
+// absolute sample, for the idle test (copy_peak). The CPU vertex conversion is
+// kept in nina_scope_bench as the reference for the vertex shader mapping
+// For long timebases, min_max reduces a block of frames to the min and max
+// OSC value (L+R), for the scope min/max envelope
+// The kernels are vectorised with NEON or SSE if available, with a scalar
+// fallback
+class ScopeKernel
+{
+public:
+    static float copy_peak(const float *samples, uint num_frames, float *dst);
+    static float copy_peak_scalar(const float *samples, uint num_frames, float *dst);
+    static void min_max(const float *samples, uint num_frames, float& min, float& max);
+    static void min_max_scalar(const float *samples, uint num_frames, float& min, float& max);
+    static const char *simd_name();
+};
+
+#endif  // SCOPE_KERNEL_H
@@ -8,22 +8,41 @@
  */
 #include <mqueue.h>
 #include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include "scope_msg_thread.h"
+#include "scope_sample_ring.h"
+#include "scope_envelope.h"
 
 // Constants
-constexpr char MSG_QUEUE_NAME[] = "/nina_samples_msg_queue";
-constexpr uint MSG_QUEUE_SIZE   = 1;
-constexpr auto POLL_TIMEOUT     = 1;
+// The ring holds the sample history for the longest timebase (the readable
+// window is three quarters of the ring)
+constexpr uint SCOPE_SAMPLE_RING_FRAMES   = (256 * 1024);
+constexpr uint SCOPE_SAMPLE_RING_POLL_MS  = 16;    // Only if there is no frame demand event
+constexpr uint SCOPE_SAMPLE_RING_WATCH_MS = 100;
+constexpr uint SCOPE_ENVELOPE_READ_FRAMES = 4096;
+static_assert(SCOPE_MAX_TIMEBASE_FRAMES <= ((SCOPE_SAMPLE_RING_FRAMES / 4) * 3), "The scope sample ring is too small for the max timebase");
 
 //----------------------------------------------------------------------------
 // ScopeMsgThread
 //----------------------------------------------------------------------------
-ScopeMsgThread::ScopeMsgThread(ScopeDataSource &data_source, QObject *parent) :
+ScopeMsgThread::ScopeMsgThread(ScopeDataSource &data_source, IpcRecorder& recorder, IpcQueueHealth& health, QObject *parent) :
     QThread(parent),
-    _scope_data_source(data_source)
+    _scope_data_source(data_source),
+    _recorder(recorder),
+    _health(health)
 {
     // Initialise class variables
     _exit_msgs_thread = false;
+    _envelope_samples.resize(SCOPE_ENVELOPE_READ_FRAMES * 2);
+
+    // Create the event used to wake the thread when it is stopped
+    _exit_event_fd = ::eventfd(0, (EFD_CLOEXEC | EFD_NONBLOCK));
+    if (_exit_event_fd == -1)
+    {
+        // This is not fatal, but the thread cannot be stopped while idle
+        MSG("ScopeMsgThread: ERROR: Could not create the exit event: " << errno);
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -31,23 +50,53 @@ ScopeMsgThread::ScopeMsgThread(ScopeDataSource &data_source, QObject *parent) :
 //----------------------------------------------------------------------------
 ScopeMsgThread::~ScopeMsgThread()
 {
-    // Stop the thread
+    // Stop the thread, and wake it if it is waiting for samples
     _exit_msgs_thread = true;
+    if (_exit_event_fd != -1)
+    {
+        uint64_t event = 1;
+        (void)::write(_exit_event_fd, &event, sizeof(event));
+    }
     wait();
+
+    // Close the exit event
+    if (_exit_event_fd != -1)
+        ::close(_exit_event_fd);
 }
 
 //----------------------------------------------------------------------------
 // run
 //----------------------------------------------------------------------------
 void ScopeMsgThread::run()
+{
+#ifdef SCOPE_SAMPLE_RING_TRANSPORT
+    // Create the Scope Sample Ring, and if successful read the samples from it
+    ScopeSampleRing ring;
+    if (ring.create(SCOPE_SAMPLE_RING_NAME, SCOPE_SAMPLE_RING_FRAMES))
+    {
+        _process_ring(ring);
+        return;
+    }
+
+    // Could not create the ring, so fall back to the Samples Message Queue
+    MSG("ScopeMsgThread: ERROR: Could not create the scope sample ring, using the message queue: " << errno);
+#endif
+    _process_msg_queue();
+}
+
+//----------------------------------------------------------------------------
+// _process_msg_queue
+//----------------------------------------------------------------------------
+void ScopeMsgThread::_process_msg_queue()
 {
     mq_attr attr;
 
-    // Open the Samples Message Queue (create if it doesn't exist)
+    // Open the Samples Message Queue (create if it doesn't exist) - it is opened
+    // non-blocking so that it can be drained after each wakeup
     std::memset(&attr, 0, sizeof(attr));
-    attr.mq_maxmsg = MSG_QUEUE_SIZE;
-    attr.mq_msgsize = sizeof(float) * SCOPE_SAMPLES_MSG_SIZE;
-    mqd_t desc = ::mq_open(MSG_QUEUE_NAME, (O_CREAT|O_RDONLY),
+    attr.mq_maxmsg = SCOPE_SAMPLES_MSG_QUEUE_SIZE;
+    attr.mq_msgsize = SCOPE_SAMPLES_MSG_MAX_LEN;
+    mqd_t desc = ::mq_open(SCOPE_SAMPLES_MSG_QUEUE_NAME, (O_CREAT|O_RDONLY|O_NONBLOCK),
                            (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH),
                            &attr);
     if (desc == (mqd_t)-1)
@@ -57,31 +106,76 @@ void ScopeMsgThread::run()
         return;
     }
 
+    // Wait on the Samples Message Queue and the exit event
+    pollfd pfds[2];
+    pfds[0].fd = desc;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = _exit_event_fd;
+    pfds[1].events = POLLIN;
+
     // Run until the thread is stopped
     while(!_exit_msgs_thread)
     {
-        timespec poll_time;
-        float msg[SCOPE_SAMPLES_MSG_SIZE];
-        std::memset(&msg, 0, sizeof(msg));
-
-        // Wait for Sample events, timeout, or an error
-        clock_gettime(CLOCK_REALTIME, &poll_time);
-        poll_time.tv_sec += POLL_TIMEOUT;
-        int res = ::mq_timedreceive(desc, (char *)&msg, sizeof(msg), NULL, &poll_time);
-        if (res == sizeof(msg))
-        {
-            // Update the data
-            _scope_data_source.updateData(msg);
-        }
-        else if (res == -1)
+        float msg[SCOPE_SAMPLES_MSG_MAX_LEN / sizeof(float)];
+
+        // Wait for Sample events, the exit event, or an error - note there is no
+        // timeout, so the thread does not wake while idle
+        int res = ::poll(pfds, ((_exit_event_fd != -1) ? 2 : 1), -1);
+        if (res == -1)
         {
-            // If not a timeout
-            if (errno != ETIMEDOUT)
+            // If not interrupted by a signal
+            if (errno != EINTR)
             {
                 // An error occurred, stop processing the queue
-                DEBUG_MSG("ScopeMsgThread: Message Queue error: " << errno);
+                DEBUG_MSG("ScopeMsgThread: Message Queue poll error: " << errno);
                 break;
             }
+            continue;
+        }
+
+        // Update the queue depth
+        if (::mq_getattr(desc, &attr) == 0)
+            _health.set_depth(attr.mq_curmsgs);
+
+        // Process the queued samples - a zero length message is counted as a
+        // receive error (it is not the samples length)
+        while ((res = ::mq_receive(desc, (char *)&msg, sizeof(msg), NULL)) >= 0)
+        {
+            // Record the samples if recording
+            _recorder.record(IpcQueue::SCOPE_SAMPLES_MSG_QUEUE, msg, res);
+
+            // If the samples are traced, set when they were sent and received
+            GuiMsgTiming timing;
+            timing.traced = (res == SCOPE_SAMPLES_MSG_MAX_LEN);
+            timing.ack = false;
+            timing.lane = GuiMsgLane::LANE_NORMAL;
+            if (timing.traced)
+            {
+                GuiMsgTrace trace;
+                std::memcpy(&trace, (uint8_t *)msg + SCOPE_SAMPLES_MSG_LEN, sizeof(trace));
+                timing.source = GUI_MSG_LATENCY_SCOPE_SAMPLES;
+                timing.seq = trace.seq;
+                timing.sent = trace.send_time;
+                timing.received = GuiMsgLatency::now();
+                timing.dispatched = timing.received;
+                _health.traced(trace.seq);
+            }
+
+            // Update the data
+            if ((res == SCOPE_SAMPLES_MSG_LEN) || timing.traced) {
+                _scope_data_source.updateData(msg, timing);
+                _health.received();
+            }
+            else {
+                _health.receive_error();
+            }
+        }
+        if ((res == -1) && (errno != EAGAIN) && (errno != EINTR))
+        {
+            // An error occurred, stop processing the queue
+            DEBUG_MSG("ScopeMsgThread: Message Queue error: " << errno);
+            _health.receive_error();
+            break;
         }
     }
 
@@ -90,5 +184,172 @@ void ScopeMsgThread::run()
 
     // Close the Samples message queue
     ::mq_close(desc);
-    //::mq_unlink(MSG_QUEUE_NAME);
+    //::mq_unlink(SCOPE_SAMPLES_MSG_QUEUE_NAME);
+}
+
+//----------------------------------------------------------------------------
+// _process_ring
+//----------------------------------------------------------------------------
+void ScopeMsgThread::_process_ring(ScopeSampleRing& ring)
+{
+    float samples[SCOPE_SAMPLES_MSG_SIZE];
+    uint64_t read_index = ring.write_index();
+    ScopeEnvelope envelope;
+    uint64_t envelope_index = 0;
+    bool envelope_valid = false;
+    bool watching = false;
+
+    // The depth is the number of frames written since the last read
+    _health.set_depth_units("frames");
+
+    // Wait on the frame demand and exit events - the ring is read when the GUI
+    // thread demands a frame, so there is no need for the producer to wake this
+    // thread (an event that could not be created is ignored by poll)
+    pollfd pfds[2];
+    pfds[0].fd = _scope_data_source.demand_event_fd();
+    pfds[0].events = POLLIN;
+    pfds[1].fd = _exit_event_fd;
+    pfds[1].events = POLLIN;
+
+    _scope_data_source.start_frame_demand();
+
+    // Run until the thread is stopped
+    while(!_exit_msgs_thread)
+    {
+        // Wait for the next frame demand, or the exit event - note there is no
+        // timeout, so the thread does not wake while the scope is off or hidden
+        // If the last frame had nothing new to show the GUI thread is not
+        // signalled, so demands no more frames - instead watch the write index
+        // at a slow rate until there is a frame to show
+        // If there is no frame demand event, read the ring at the display rate
+        int timeout = -1;
+        if (pfds[0].fd == -1)
+            timeout = SCOPE_SAMPLE_RING_POLL_MS;
+        else if (watching && _scope_data_source.frames_wanted())
+            timeout = SCOPE_SAMPLE_RING_WATCH_MS;
+        int res = ::poll(pfds, 2, timeout);
+        if (res == -1)
+        {
+            // If not interrupted by a signal
+            if (errno != EINTR)
+            {
+                // An error occurred, stop processing the ring
+                DEBUG_MSG("ScopeMsgThread: Sample ring poll error: " << errno);
+                break;
+            }
+            continue;
+        }
+
+        // Clear the frame demand event - any demands since the last read are
+        // met by this one
+        if (pfds[0].revents & POLLIN)
+        {
+            uint64_t event;
+            (void)::read(pfds[0].fd, &event, sizeof(event));
+        }
+
+        // Ignore if the scope is off or hidden
+        if (!_scope_data_source.frames_wanted())
+        {
+            watching = false;
+            continue;
+        }
+
+        // If new samples have been written since the last read - if not, watch
+        // for them
+        uint64_t write_index = ring.write_index();
+        if ((write_index == read_index) || (write_index < SCOPE_NUM_SAMPLES))
+        {
+            watching = true;
+            continue;
+        }
+        _health.set_depth(std::min<uint64_t>((write_index - read_index), SCOPE_SAMPLE_RING_FRAMES));
+        read_index = write_index;
+
+        // The ring samples are not traced
+        GuiMsgTiming timing;
+        timing.traced = false;
+        timing.ack = false;
+        timing.lane = GuiMsgLane::LANE_NORMAL;
+
+        // If a long OSC timebase is set, update the envelope with the new
+        // samples and show it
+        uint timebase_frames = _scope_data_source.timebase_frames();
+        if ((timebase_frames > SCOPE_NUM_SAMPLES) && (_scope_data_source.scope_mode() == GuiScopeMode::SCOPE_MODE_OSC))
+        {
+            // If the timebase or scope width has changed, reconfigure the
+            // envelope - it is then refilled from the ring history
+            uint num_columns = _scope_data_source.envelope_columns();
+            if ((timebase_frames != envelope.timebase_frames()) || (std::min(num_columns, timebase_frames) != envelope.num_columns()))
+            {
+                envelope.configure(timebase_frames, num_columns);
+                envelope_valid = false;
+            }
+            if (!_update_envelope(ring, envelope, envelope_index, envelope_valid, write_index))
+            {
+                // The samples were overwritten while they were read
+                _health.receive_error();
+                continue;
+            }
+
+            // If recording, also record the newest window (the envelope is not
+            // recorded)
+            if (_recorder.is_open() && ring.read((write_index - SCOPE_NUM_SAMPLES), SCOPE_NUM_SAMPLES, samples))
+                _recorder.record(IpcQueue::SCOPE_SAMPLES_MSG_QUEUE, samples, SCOPE_SAMPLES_MSG_LEN);
+            watching = !_scope_data_source.updateEnvelope(envelope, timing);
+            _health.received();
+            continue;
+        }
+        envelope_valid = false;
+
+        // Read the newest window
+        if (!ring.read((write_index - SCOPE_NUM_SAMPLES), SCOPE_NUM_SAMPLES, samples))
+        {
+            // The window was overwritten while it was read
+            _health.receive_error();
+            continue;
+        }
+
+        // Record the window if recording - it is recorded as a samples message,
+        // so it can be replayed into the Samples Message Queue
+        _recorder.record(IpcQueue::SCOPE_SAMPLES_MSG_QUEUE, samples, SCOPE_SAMPLES_MSG_LEN);
+
+        // Update the data
+        watching = !_scope_data_source.updateData(samples, timing);
+        _health.received();
+    }
+
+    // Thread exited
+    DEBUG_MSG("ScopeMsgThread: thread: EXIT");
+}
+
+//----------------------------------------------------------------------------
+// _update_envelope
+// Adds the samples written since the envelope was last updated, or if it is
+// not valid (or has fallen too far behind) refills it from the ring history
+//----------------------------------------------------------------------------
+bool ScopeMsgThread::_update_envelope(ScopeSampleRing& ring, ScopeEnvelope& envelope, uint64_t& envelope_index, bool& envelope_valid, uint64_t write_index)
+{
+    // Check if the envelope needs to be refilled - from the start of its
+    // window, or as much of it as has been written
+    if (!envelope_valid || ((write_index - envelope_index) > ring.max_window()))
+    {
+        envelope.reset();
+        envelope_index = write_index - std::min<uint64_t>(envelope.window_frames(), write_index);
+        envelope_valid = true;
+    }
+
+    // Read and process the new samples in blocks
+    while (envelope_index < write_index)
+    {
+        uint num_frames = std::min<uint64_t>((write_index - envelope_index), SCOPE_ENVELOPE_READ_FRAMES);
+        if (!ring.read(envelope_index, num_frames, _envelope_samples.data()))
+        {
+            envelope_valid = false;
+            return false;
+        }
+        envelope.process(_envelope_samples.data(), num_frames);
+        envelope_index += num_frames;
+    }
+    return true;
 }
@@ -10,22 +10,36 @@
 #define SCOPE_MSG_THREAD_H
 
 #include <atomic>
+#include <vector>
 #include <QThread>
 #include "common.h"
 #include "scope_data_source.h"
+#include "ipc_recorder.h"
+#include "ipc_queue_health.h"
+
+class ScopeSampleRing;
+class ScopeEnvelope;
 
 // Scope Message Thread class
 class ScopeMsgThread : public QThread
 {
 	Q_OBJECT
 public:
-    ScopeMsgThread(ScopeDataSource &data_source, QObject *parent);
+    ScopeMsgThread(ScopeDataSource &data_source, IpcRecorder& recorder, IpcQueueHealth& health, QObject *parent);
     ~ScopeMsgThread();
     void run();
 
 private:
     ScopeDataSource& _scope_data_source;
+    IpcRecorder& _recorder;
+    IpcQueueHealth& _health;
     std::atomic<bool> _exit_msgs_thread;
+    int _exit_event_fd;
+    std::vector<float> _envelope_samples;
+
+    void _process_msg_queue();
+    void _process_ring(ScopeSampleRing& ring);
+    bool _update_envelope(ScopeSampleRing& ring, ScopeEnvelope& envelope, uint64_t& envelope_index, bool& envelope_valid, uint64_t write_index);
 };
 
 #endif
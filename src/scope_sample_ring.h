@@ -0,0 +1,302 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  scope_sample_ring.h
+ * @brief Scope Sample Ring class definitions and implementation.
+ *
+ * Ring of the continuous audio-rate stereo (interleaved L/R) sample stream in
+ * a shared memory segment. The consumer (Nina GUI) creates the segment, and
+ * the producer (audio engine) attaches to it and writes blocks of samples,
+ * publishing a running write index. The producer never waits - the ring is
+ * simply overwritten - and the consumer reads any recent window of samples
+ * without a syscall, checking it was not overwritten while it was copied.
+ * Note: The ring is shared with the sample producer, and is therefore
+ * implemented in this header.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef SCOPE_SAMPLE_RING_H
+#define SCOPE_SAMPLE_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "common.h"
+
+// Constants
+constexpr uint32_t SCOPE_SAMPLE_RING_MAGIC   = 0x504F4353;    // "SCOP"
+constexpr uint32_t SCOPE_SAMPLE_RING_VERSION = 1;
+constexpr uint SCOPE_SAMPLE_RING_CHANNELS    = 2;
+
+// Scope Sample Ring shared memory header
+// The write index is the total number of stereo frames written
+struct ScopeSampleRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_frames;
+    std::atomic<uint32_t> sample_rate;
+    alignas(64) std::atomic<uint64_t> write_index;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The ring write index must be lock-free");
+
+// Scope Sample Ring class
+class ScopeSampleRing
+{
+public:
+    //----------------------------------------------------------------------------
+    // ScopeSampleRing
+    //----------------------------------------------------------------------------
+    ScopeSampleRing()
+    {
+        // Initialise class variables
+        _header = nullptr;
+        _data = nullptr;
+        _map_size = 0;
+    }
+
+    //----------------------------------------------------------------------------
+    // ~ScopeSampleRing
+    //----------------------------------------------------------------------------
+    ~ScopeSampleRing()
+    {
+        // Make sure the ring is closed
+        close();
+    }
+
+    //----------------------------------------------------------------------------
+    // create
+    // Called by the consumer to create (or re-use) the ring, the number of
+    // stereo frames must be a power of 2
+    //----------------------------------------------------------------------------
+    bool create(const char *name, uint32_t num_frames)
+    {
+        // Check the number of frames is a power of 2
+        if ((num_frames == 0) || (num_frames & (num_frames - 1)))
+            return false;
+
+        // Open the shared memory segment (create if it doesn't exist) and map it
+        int fd = ::shm_open(name, (O_CREAT|O_RDWR), (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH));
+        if (fd == -1)
+            return false;
+        _map_size = sizeof(ScopeSampleRingHeader) + _data_size(num_frames);
+        if ((::ftruncate(fd, _map_size) == -1) || !_map(fd)) {
+            ::close(fd);
+            return false;
+        }
+        ::close(fd);
+
+        // If the ring is not valid (new, or a different layout) then initialise
+        // it, otherwise keep the stream (the producer may be attached)
+        if ((_header->magic != SCOPE_SAMPLE_RING_MAGIC) || (_header->version != SCOPE_SAMPLE_RING_VERSION) ||
+            (_header->num_frames != num_frames)) {
+            _header->magic = 0;
+            _header->version = SCOPE_SAMPLE_RING_VERSION;
+            _header->num_frames = num_frames;
+            _header->sample_rate = 0;
+            _header->write_index = 0;
+            std::memset(_data, 0, _data_size(num_frames));
+            std::atomic_thread_fence(std::memory_order_release);
+            _header->magic = SCOPE_SAMPLE_RING_MAGIC;
+        }
+        return true;
+    }
+
+    //----------------------------------------------------------------------------
+    // open
+    // Called by the producer to attach to an existing ring
+    //----------------------------------------------------------------------------
+    bool open(const char *name, uint32_t sample_rate)
+    {
+        struct stat st;
+
+        // Open the shared memory segment, it must already exist
+        int fd = ::shm_open(name, O_RDWR, 0);
+        if (fd == -1)
+            return false;
+        if ((::fstat(fd, &st) == -1) || (st.st_size <= (off_t)sizeof(ScopeSampleRingHeader))) {
+            ::close(fd);
+            return false;
+        }
+        _map_size = st.st_size;
+        if (!_map(fd)) {
+            ::close(fd);
+            return false;
+        }
+        ::close(fd);
+
+        // Check the ring is valid, and set the stream sample rate
+        if ((_header->magic != SCOPE_SAMPLE_RING_MAGIC) || (_header->version != SCOPE_SAMPLE_RING_VERSION) ||
+            ((sizeof(ScopeSampleRingHeader) + _data_size(_header->num_frames)) != _map_size)) {
+            close();
+            return false;
+        }
+        _header->sample_rate.store(sample_rate, std::memory_order_relaxed);
+        return true;
+    }
+
+    //----------------------------------------------------------------------------
+    // close
+    //----------------------------------------------------------------------------
+    void close()
+    {
+        // Unmap the ring if mapped
+        if (_header) {
+            ::munmap(_header, _map_size);
+            _header = nullptr;
+            _data = nullptr;
+        }
+    }
+
+    //----------------------------------------------------------------------------
+    // is_open
+    //----------------------------------------------------------------------------
+    bool is_open() const
+    {
+        return _header != nullptr;
+    }
+
+    //----------------------------------------------------------------------------
+    // write
+    // Producer only - writes a block of interleaved stereo frames. Blocks are
+    // published in chunks of at most the guard size, so the consumer can
+    // detect a window being overwritten
+    //----------------------------------------------------------------------------
+    void write(const float *samples, uint num_frames)
+    {
+        uint32_t ring_frames = _header->num_frames;
+        uint64_t write_index = _header->write_index.load(std::memory_order_relaxed);
+        while (num_frames > 0) {
+            uint chunk = std::min(num_frames, _guard_frames());
+            _copy_in(write_index, samples, chunk, ring_frames);
+            write_index += chunk;
+            _header->write_index.store(write_index, std::memory_order_release);
+            samples += (chunk * SCOPE_SAMPLE_RING_CHANNELS);
+            num_frames -= chunk;
+        }
+    }
+
+    //----------------------------------------------------------------------------
+    // write_index
+    // Returns the total number of stereo frames written
+    //----------------------------------------------------------------------------
+    uint64_t write_index() const
+    {
+        return _header->write_index.load(std::memory_order_acquire);
+    }
+
+    //----------------------------------------------------------------------------
+    // read
+    // Consumer only - reads the window of stereo frames starting at the
+    // specified index. Returns false if the window has not been written yet, or
+    // has been (or may have been) overwritten
+    //----------------------------------------------------------------------------
+    bool read(uint64_t start_index, uint num_frames, float *samples) const
+    {
+        // Check the window is available
+        uint32_t ring_frames = _header->num_frames;
+        uint64_t write_index = _header->write_index.load(std::memory_order_acquire);
+        if (((start_index + num_frames) > write_index) || !_readable(start_index, write_index))
+            return false;
+
+        // Copy the window, and check the producer did not overwrite it while
+        // it was copied
+        _copy_out(start_index, samples, num_frames, ring_frames);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return _readable(start_index, _header->write_index.load(std::memory_order_relaxed));
+    }
+
+    //----------------------------------------------------------------------------
+    // max_window
+    // Returns the maximum window of stereo frames that can be read
+    //----------------------------------------------------------------------------
+    uint max_window() const
+    {
+        return _header->num_frames - _guard_frames();
+    }
+
+    //----------------------------------------------------------------------------
+    // sample_rate
+    // Returns the stream sample rate set by the producer (0 if not attached)
+    //----------------------------------------------------------------------------
+    uint32_t sample_rate() const
+    {
+        return _header->sample_rate.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Private variables
+    ScopeSampleRingHeader *_header;
+    float *_data;
+    size_t _map_size;
+
+    //----------------------------------------------------------------------------
+    // _map
+    //----------------------------------------------------------------------------
+    bool _map(int fd)
+    {
+        void *map = ::mmap(nullptr, _map_size, (PROT_READ|PROT_WRITE), MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+            return false;
+        _header = static_cast<ScopeSampleRingHeader *>(map);
+        _data = reinterpret_cast<float *>(static_cast<uint8_t *>(map) + sizeof(ScopeSampleRingHeader));
+        return true;
+    }
+
+    //----------------------------------------------------------------------------
+    // _readable
+    // The quarter of the ring after the write index is the guard - frames in
+    // it may be being written before they are published
+    //----------------------------------------------------------------------------
+    bool _readable(uint64_t start_index, uint64_t write_index) const
+    {
+        return (write_index - start_index) <= max_window();
+    }
+
+    //----------------------------------------------------------------------------
+    // _guard_frames
+    //----------------------------------------------------------------------------
+    uint _guard_frames() const
+    {
+        return _header->num_frames / 4;
+    }
+
+    //----------------------------------------------------------------------------
+    // _copy_in
+    //----------------------------------------------------------------------------
+    void _copy_in(uint64_t index, const float *samples, uint num_frames, uint32_t ring_frames)
+    {
+        uint32_t offset = index & (ring_frames - 1);
+        uint first = std::min(num_frames, (ring_frames - offset));
+        std::memcpy(_data + (offset * SCOPE_SAMPLE_RING_CHANNELS), samples, (first * SCOPE_SAMPLE_RING_CHANNELS * sizeof(float)));
+        if (first < num_frames)
+            std::memcpy(_data, samples + (first * SCOPE_SAMPLE_RING_CHANNELS), ((num_frames - first) * SCOPE_SAMPLE_RING_CHANNELS * sizeof(float)));
+    }
+
+    //----------------------------------------------------------------------------
+    // _copy_out
+    //----------------------------------------------------------------------------
+    void _copy_out(uint64_t index, float *samples, uint num_frames, uint32_t ring_frames) const
+    {
+        uint32_t offset = index & (ring_frames - 1);
+        uint first = std::min(num_frames, (ring_frames - offset));
+        std::memcpy(samples, _data + (offset * SCOPE_SAMPLE_RING_CHANNELS), (first * SCOPE_SAMPLE_RING_CHANNELS * sizeof(float)));
+        if (first < num_frames)
+            std::memcpy(samples + (first * SCOPE_SAMPLE_RING_CHANNELS), _data, ((num_frames - first) * SCOPE_SAMPLE_RING_CHANNELS * sizeof(float)));
+    }
+
+    //----------------------------------------------------------------------------
+    // _data_size
+    //----------------------------------------------------------------------------
+    static size_t _data_size(uint32_t num_frames)
+    {
+        return (size_t)num_frames * SCOPE_SAMPLE_RING_CHANNELS * sizeof(float);
+    }
+};
+
+#endif  // SCOPE_SAMPLE_RING_H
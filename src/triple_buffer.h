@@ -0,0 +1,102 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  triple_buffer.h
+ * @brief Triple Buffer class definitions and implementation.
+ *-----------------------------------------------------------------------------
+ */
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Triple Buffer class
+// Lock-free single producer/single consumer triple buffer. The producer
+// writes the back buffer and publishes it, swapping it with the middle
+// buffer. The consumer swaps the middle buffer into the front buffer if a
+// newer one has been published. Neither side ever blocks, and the consumer
+// always reads the newest complete buffer - intermediate buffers are
+// overwritten if the consumer falls behind
+template <typename T>
+class TripleBuffer
+{
+public:
+    //----------------------------------------------------------------------------
+    // TripleBuffer
+    //----------------------------------------------------------------------------
+    TripleBuffer() :
+        _back(0),
+        _middle(1),
+        _front(2)
+    {}
+
+    //----------------------------------------------------------------------------
+    // write_buffer
+    // Producer only - returns the back buffer to write
+    //----------------------------------------------------------------------------
+    T& write_buffer()
+    {
+        return _buffers[_back];
+    }
+
+    //----------------------------------------------------------------------------
+    // publish
+    // Producer only - publishes the back buffer, and takes the middle buffer
+    // as the new back buffer
+    //----------------------------------------------------------------------------
+    void publish()
+    {
+        uint8_t middle = _middle.exchange((_back | FRESH_FLAG), std::memory_order_acq_rel);
+        _back = middle & INDEX_MASK;
+    }
+
+    //----------------------------------------------------------------------------
+    // update
+    // Consumer only - takes the newest published buffer (if any) as the front
+    // buffer, returns true if there was one
+    //----------------------------------------------------------------------------
+    bool update()
+    {
+        if ((_middle.load(std::memory_order_relaxed) & FRESH_FLAG) == 0)
+            return false;
+        uint8_t middle = _middle.exchange(_front, std::memory_order_acq_rel);
+        _front = middle & INDEX_MASK;
+        return true;
+    }
+
+    //----------------------------------------------------------------------------
+    // read_buffer
+    // Consumer only - returns the front buffer to read
+    //----------------------------------------------------------------------------
+    T& read_buffer()
+    {
+        return _buffers[_front];
+    }
+
+    //----------------------------------------------------------------------------
+    // buffers
+    // Returns all three buffers, for initialisation before the producer and
+    // consumer are started
+    //----------------------------------------------------------------------------
+    std::array<T, 3>& buffers()
+    {
+        return _buffers;
+    }
+
+private:
+    // The middle index is published with a flag indicating if it is newer
+    // than the front buffer
+    static constexpr uint8_t INDEX_MASK = 0x03;
+    static constexpr uint8_t FRESH_FLAG = 0x04;
+
+    // Private data
+    std::array<T, 3> _buffers;
+    uint8_t _back;
+    std::atomic<uint8_t> _middle;
+    uint8_t _front;
+};
+
+#endif  // TRIPLE_BUFFER_H
@@ -0,0 +1,251 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  main.cpp
+ * @brief Nina IPC replay tool.
+ *
+ * Replays an IPC log recorded by the Nina GUI (NINA_GUI_RECORD_FILE) into the
+ * GUI and samples message queues, so that a recorded session can be used as a
+ * workload without the Nina UI app or hardware.
+ * Traced messages are given a new send time and sequence number as they are
+ * sent (continuing across loops), so that the GUI measures the replayed
+ * latency and sees no dropped messages. The ack flag is cleared, as the tool
+ * does not read the GUI events.
+ *-----------------------------------------------------------------------------
+ */
+#include <mqueue.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+#include "common.h"
+#include "ipc_recorder.h"
+
+// Local functions
+bool _replay(IpcRecordReader& reader, mqd_t gui_desc, mqd_t samples_desc, double speed);
+void _retrace(IpcQueue queue, uint8_t *msg, uint len);
+mqd_t _open_queue(const char *name, uint size, uint msg_size, bool non_blocking);
+uint64_t _now();
+void _print_usage();
+void _sigint_handler([[maybe_unused]] int sig);
+
+// Local variables
+volatile sig_atomic_t _exit_replay = false;
+uint32_t _gui_trace_seq[NUM_GUI_MSG_LANES] = {};
+uint32_t _samples_trace_seq = 0;
+
+//----------------------------------------------------------------------------
+// main
+//----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    double speed = 1.0;
+    int loops = 1;
+    int opt;
+
+    // Parse the options
+    while ((opt = ::getopt(argc, argv, "s:fl:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 's':
+                // Replay at N x speed
+                speed = std::atof(optarg);
+                if (speed <= 0.0) {
+                    _print_usage();
+                    return 1;
+                }
+                break;
+
+            case 'f':
+                // Replay flat-out (no timing)
+                speed = 0.0;
+                break;
+
+            case 'l':
+                // Number of times to replay the log (0 = forever)
+                loops = std::atoi(optarg);
+                break;
+
+            default:
+                _print_usage();
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+    if (optind != (argc - 1)) {
+        _print_usage();
+        return 1;
+    }
+
+    // Open the log
+    IpcRecordReader reader;
+    if (!reader.open(argv[optind])) {
+        MSG("ERROR: Could not open the IPC log: " << argv[optind]);
+        return 1;
+    }
+
+    // Open the queues - the samples queue only holds one message, so when replaying
+    // in real time it is sent non-blocking (as the Nina UI app does) and samples the
+    // GUI has not read are dropped
+    mqd_t gui_desc = _open_queue(GUI_MSG_QUEUE_NAME, GUI_MSG_QUEUE_SIZE, GUI_MSG_MAX_SIZE, false);
+    mqd_t samples_desc = _open_queue(SCOPE_SAMPLES_MSG_QUEUE_NAME, SCOPE_SAMPLES_MSG_QUEUE_SIZE,
+                                     SCOPE_SAMPLES_MSG_MAX_LEN, (speed > 0.0));
+    if ((gui_desc == (mqd_t)-1) || (samples_desc == (mqd_t)-1)) {
+        MSG("ERROR: Could not open the message queues: " << errno);
+        return 1;
+    }
+
+    // Setup the exit signal handler (e.g. ctrl-c, kill)
+    signal(SIGINT, _sigint_handler);
+    signal(SIGTERM, _sigint_handler);
+
+    // Replay the log
+    for (int i=0; ((loops == 0) || (i < loops)) && !_exit_replay; i++) {
+        reader.rewind();
+        if (!_replay(reader, gui_desc, samples_desc, speed))
+            break;
+    }
+    ::mq_close(gui_desc);
+    ::mq_close(samples_desc);
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+// _replay
+//----------------------------------------------------------------------------
+bool _replay(IpcRecordReader& reader, mqd_t gui_desc, mqd_t samples_desc, double speed)
+{
+    IpcRecordHeader header;
+    uint8_t msg[IPC_RECORD_MAX_MSG_SIZE];
+    uint num_gui_msgs = 0;
+    uint num_samples_msgs = 0;
+    uint num_dropped = 0;
+    uint max_late_us = 0;
+
+    // Replay each record in the log
+    uint64_t start_time = _now();
+    while (!_exit_replay && reader.read(header, msg))
+    {
+        // If timing the replay, wait until the record is due
+        if (speed > 0.0) {
+            uint64_t due_time = start_time + (uint64_t)(header.timestamp / speed);
+            uint64_t now = _now();
+            if (now < due_time) {
+                timespec ts;
+                ts.tv_sec = due_time / 1000000000ULL;
+                ts.tv_nsec = due_time % 1000000000ULL;
+                ::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+            }
+            else if (((now - due_time) / 1000) > max_late_us) {
+                max_late_us = (now - due_time) / 1000;
+            }
+        }
+
+        // Send the message to its queue, with a new trace if traced
+        _retrace(header.queue, msg, header.len);
+        if ((header.queue == IpcQueue::GUI_MSG_QUEUE) || (header.queue == IpcQueue::GUI_MSG_URGENT_QUEUE)) {
+            uint prio = (header.queue == IpcQueue::GUI_MSG_URGENT_QUEUE) ? GuiMsgLane::LANE_URGENT : GuiMsgLane::LANE_NORMAL;
+            if (::mq_send(gui_desc, (char *)msg, header.len, prio) == 0)
+                num_gui_msgs++;
+            else
+                num_dropped++;
+        }
+        else if (header.queue == IpcQueue::SCOPE_SAMPLES_MSG_QUEUE) {
+            if (::mq_send(samples_desc, (char *)msg, header.len, 0) == 0)
+                num_samples_msgs++;
+            else
+                num_dropped++;
+        }
+    }
+
+    // Show the replay stats
+    uint64_t elapsed_ms = (_now() - start_time) / 1000000;
+    MSG("Replayed " << num_gui_msgs << " GUI messages, " << num_samples_msgs << " samples messages in " << elapsed_ms << " ms");
+    MSG("Dropped: " << num_dropped << ", max late: " << max_late_us << " us");
+    return !_exit_replay;
+}
+
+//----------------------------------------------------------------------------
+// _retrace
+//----------------------------------------------------------------------------
+void _retrace(IpcQueue queue, uint8_t *msg, uint len)
+{
+    // Find the trace - GUI messages are only traced if framed with the trace
+    // flag, and scope samples if it follows the samples
+    uint trace_offset;
+    uint32_t *trace_seq;
+    if ((queue == IpcQueue::GUI_MSG_QUEUE) || (queue == IpcQueue::GUI_MSG_URGENT_QUEUE)) {
+        GuiMsgFrameHeader header;
+        if (len < (sizeof(header) + sizeof(GuiMsgTrace)))
+            return;
+        std::memcpy(&header, msg, sizeof(header));
+        if ((header.magic != GUI_MSG_FRAME_MAGIC) || !(header.flags & GUI_MSG_FRAME_FLAG_TRACE))
+            return;
+        trace_offset = sizeof(header);
+        trace_seq = &_gui_trace_seq[(queue == IpcQueue::GUI_MSG_URGENT_QUEUE) ? GuiMsgLane::LANE_URGENT : GuiMsgLane::LANE_NORMAL];
+    }
+    else if ((queue == IpcQueue::SCOPE_SAMPLES_MSG_QUEUE) && (len == SCOPE_SAMPLES_MSG_MAX_LEN)) {
+        trace_offset = SCOPE_SAMPLES_MSG_LEN;
+        trace_seq = &_samples_trace_seq;
+    }
+    else {
+        return;
+    }
+
+    // Rewrite the trace as if the message was sent now
+    GuiMsgTrace trace;
+    std::memcpy(&trace, (msg + trace_offset), sizeof(trace));
+    trace.seq = (*trace_seq)++;
+    trace.flags &= ~GUI_MSG_TRACE_FLAG_ACK;
+    trace.send_time = _now();
+    std::memcpy((msg + trace_offset), &trace, sizeof(trace));
+}
+
+//----------------------------------------------------------------------------
+// _open_queue
+//----------------------------------------------------------------------------
+mqd_t _open_queue(const char *name, uint size, uint msg_size, bool non_blocking)
+{
+    mq_attr attr;
+
+    // Open the message queue (create if it doesn't exist)
+    std::memset(&attr, 0, sizeof(attr));
+    attr.mq_maxmsg = size;
+    attr.mq_msgsize = msg_size;
+    return ::mq_open(name, (O_CREAT | O_WRONLY | (non_blocking ? O_NONBLOCK : 0)),
+                     (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH),
+                     &attr);
+}
+
+//----------------------------------------------------------------------------
+// _now
+//----------------------------------------------------------------------------
+uint64_t _now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+//----------------------------------------------------------------------------
+// _print_usage
+//----------------------------------------------------------------------------
+void _print_usage()
+{
+    MSG("Usage: nina_ipc_replay [-s speed | -f] [-l loops] <log file>");
+    MSG("  -s speed  Replay at N x the recorded speed (default 1.0)");
+    MSG("  -f        Replay flat-out, as fast as the GUI reads the messages");
+    MSG("  -l loops  Number of times to replay the log, 0 to loop forever (default 1)");
+}
+
+//----------------------------------------------------------------------------
+// _sigint_handler
+//----------------------------------------------------------------------------
+void _sigint_handler([[maybe_unused]] int sig)
+{
+    // Stop the replay
+    _exit_replay = true;
+}
@@ -0,0 +1,23 @@
+######################################################################
+# Nina IPC replay tool
+######################################################################
+
+TEMPLATE = app
+TARGET = nina_ipc_replay
+CONFIG += console
+CONFIG -= app_bundle qt
+
+# The common definitions are used without QT
+DEFINES += NINA_GUI_NO_QT
+
+# Paths
+INCLUDEPATH += ../../src
+
+# Input
+HEADERS += ../../src/common.h
+HEADERS += ../../src/ipc_recorder.h
+SOURCES += main.cpp
+LIBS += -lrt
+
+# Build for C++17
+CONFIG += c++14 c++17 warn_off
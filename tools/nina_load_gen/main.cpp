@@ -0,0 +1,559 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  main.cpp
+ * @brief Nina load generator tool.
+ *
+ * Stands in for the Nina UI app, sending scripted GUI message scenarios and
+ * a scope sample stream to the Nina GUI, so it can be stressed without the
+ * full synth stack. The GUI messages are sent with the GUI message sender, as
+ * the Nina UI app does.
+ *-----------------------------------------------------------------------------
+ */
+#include <mqueue.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.h"
+#include "gui_msg_sender.h"
+#include "scope_sample_ring.h"
+
+// Constants
+constexpr uint NUM_WT_FILES         = 64;
+constexpr uint SCREEN_STORM_STEPS   = 6;
+constexpr uint URGENT_INTERVAL      = 50;
+constexpr uint SCOPE_SAMPLE_RATE    = 48000;
+constexpr uint SCOPE_WAVE_FRAMES    = 512;
+
+// Scenario
+enum class Scenario
+{
+    ENCODER,
+    LIST_FLOOD,
+    SCREEN_STORM,
+    WT_BROWSE,
+    URGENT,
+    SCOPE
+};
+
+// Send stats
+struct SendStats
+{
+    uint64_t num_sent;
+    uint64_t num_queue_full;
+};
+
+// Local functions
+void _run_scenario(Scenario scenario, uint rate_hz, uint duration_s);
+void _run_scope_stream(uint rate_hz, uint duration_s);
+void _run_scope_ring_stream(ScopeSampleRing *ring, uint rate_hz, uint duration_s);
+void _make_msg(Scenario scenario, uint64_t step, GuiMsg& msg);
+void _make_trace(GuiMsgTrace& trace, uint32_t seq);
+void _process_events();
+void _set_str(char *dst, const std::string& src);
+void _wait_until(uint64_t time);
+uint64_t _now();
+void _print_usage();
+void _sigint_handler([[maybe_unused]] int sig);
+
+// Local variables
+volatile sig_atomic_t _exit_load_gen = false;
+GuiMsgSender _sender;
+bool _trace = false;
+uint _max_in_flight = 0;
+mqd_t _event_desc = (mqd_t)-1;
+
+//----------------------------------------------------------------------------
+// main
+//----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    Scenario scenario = Scenario::ENCODER;
+    uint rate_hz = 100;
+    uint scope_rate_hz = 0;
+    uint duration_s = 10;
+    uint timebase_frames = 0;
+    bool use_ring = false;
+    int opt;
+
+    // Parse the options
+    while ((opt = ::getopt(argc, argv, "S:r:p:d:RtT:f:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'S':
+            {
+                // Scenario to run
+                std::string name = optarg;
+                if (name == "encoder")
+                    scenario = Scenario::ENCODER;
+                else if (name == "list-flood")
+                    scenario = Scenario::LIST_FLOOD;
+                else if (name == "screen-storm")
+                    scenario = Scenario::SCREEN_STORM;
+                else if (name == "wt-browse")
+                    scenario = Scenario::WT_BROWSE;
+                else if (name == "urgent")
+                    scenario = Scenario::URGENT;
+                else if (name == "scope")
+                    scenario = Scenario::SCOPE;
+                else {
+                    _print_usage();
+                    return 1;
+                }
+                break;
+            }
+
+            case 'r':
+                // Message rate (Hz), 0 = flat-out
+                rate_hz = std::atoi(optarg);
+                break;
+
+            case 'p':
+                // Scope sample stream rate (Hz), 0 = off
+                scope_rate_hz = std::atoi(optarg);
+                break;
+
+            case 'd':
+                // Duration (seconds)
+                duration_s = std::atoi(optarg);
+                break;
+
+            case 'R':
+                // Send the GUI messages via the shared memory ring
+                use_ring = true;
+                break;
+
+            case 't':
+                // Trace the messages to measure their latency
+                _trace = true;
+                break;
+
+            case 'T':
+                // Set the scope timebase (frames) before streaming
+                timebase_frames = std::atoi(optarg);
+                break;
+
+            case 'f':
+                // Flow control the value updates, with at most this many
+                // messages in flight (traced and acknowledged by the GUI)
+                _max_in_flight = std::atoi(optarg);
+                break;
+
+            default:
+                _print_usage();
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    // The scope scenario is just the sample stream
+    if (scenario == Scenario::SCOPE) {
+        scope_rate_hz = (rate_hz > 0) ? rate_hz : 60;
+    }
+
+    // Open the GUI message sender - this blocks while the transport is full
+    // (counting the queue-full events), so the Nina GUI must be running
+    if ((scenario != Scenario::SCOPE) || (timebase_frames > 0)) {
+        if (!_sender.open(true, (use_ring ? GUI_MSG_RING_NAME : nullptr))) {
+            MSG("ERROR: Could not open the GUI message queue: " << errno);
+            return 1;
+        }
+        if (use_ring && !_sender.using_ring()) {
+            MSG("ERROR: Could not open the GUI message ring, is the Nina GUI running with the ring transport?");
+            return 1;
+        }
+        _sender.set_trace(_trace);
+    }
+
+    // If flow controlled, open the GUI event queue to receive the applied
+    // acknowledgements
+    // Note: The Nina UI app must not be running, as it also reads this queue
+    if ((_max_in_flight > 0) && (scenario != Scenario::SCOPE)) {
+        mq_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.mq_maxmsg = GUI_EVENT_MSG_QUEUE_SIZE;
+        attr.mq_msgsize = sizeof(GuiEventMsg);
+        _event_desc = ::mq_open(GUI_EVENT_MSG_QUEUE_NAME, (O_CREAT | O_RDONLY | O_NONBLOCK),
+                                (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH),
+                                &attr);
+        if (_event_desc == (mqd_t)-1) {
+            MSG("ERROR: Could not open the GUI event queue: " << errno);
+            return 1;
+        }
+        _sender.set_flow_control(_max_in_flight);
+    }
+
+    // Setup the exit signal handler (e.g. ctrl-c, kill)
+    signal(SIGINT, _sigint_handler);
+    signal(SIGTERM, _sigint_handler);
+
+    // Set the scope timebase if specified
+    if (timebase_frames > 0) {
+        GuiMsg& msg = _sender.begin(GuiMsgType::SET_SCOPE_TIMEBASE);
+        msg.scope_timebase.num_frames = timebase_frames;
+        _sender.commit();
+    }
+
+    // Run the scope sample stream (if any) and the scenario
+    std::thread *scope_thread = nullptr;
+    if (scope_rate_hz > 0) {
+        // If using the ring, stream the samples at the audio rate via the
+        // scope sample ring if the Nina GUI provides one
+        static ScopeSampleRing scope_ring;
+        if (use_ring && scope_ring.open(SCOPE_SAMPLE_RING_NAME, SCOPE_SAMPLE_RATE)) {
+            scope_thread = new std::thread(_run_scope_ring_stream, &scope_ring, scope_rate_hz, duration_s);
+        }
+        else {
+            if (use_ring) {
+                MSG("WARNING: Could not open the scope sample ring, the samples are sent via the message queue");
+            }
+            scope_thread = new std::thread(_run_scope_stream, scope_rate_hz, duration_s);
+        }
+    }
+    if (scenario != Scenario::SCOPE) {
+        _run_scenario(scenario, rate_hz, duration_s);
+    }
+    if (scope_thread) {
+        scope_thread->join();
+        delete scope_thread;
+    }
+    _sender.close();
+    if (_event_desc != (mqd_t)-1) {
+        ::mq_close(_event_desc);
+    }
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+// _run_scenario
+//----------------------------------------------------------------------------
+void _run_scenario(Scenario scenario, uint rate_hz, uint duration_s)
+{
+    GuiMsg msg;
+    uint64_t step = 0;
+
+    // Send the scenario messages at the specified rate until the duration
+    // has elapsed
+    uint64_t start_time = _now();
+    uint64_t end_time = start_time + (duration_s * 1000000000ULL);
+    uint64_t period = (rate_hz > 0) ? (1000000000ULL / rate_hz) : 0;
+    // If flow controlled, the sender holds and coalesces value updates while
+    // too many messages are in flight, and is serviced each step so that held
+    // updates are sent once acknowledged (or the acknowledgements time out)
+    while (!_exit_load_gen && (_now() < end_time))
+    {
+        _process_events();
+        _sender.service();
+        _make_msg(scenario, step, msg);
+        _sender.send(msg);
+        step++;
+        if (period) {
+            _wait_until(start_time + (step * period));
+        }
+    }
+
+    // Show the achieved rate
+    auto& stats = _sender.stats();
+    double elapsed_s = (_now() - start_time) / 1000000000.0;
+    MSG("GUI messages: generated " << step << ", sent " << stats.num_sent << " in " << elapsed_s << " s (" <<
+        (uint)(stats.num_sent / elapsed_s) << " msgs/s), queue full events: " << stats.num_queue_full <<
+        ", coalesced: " << stats.num_coalesced << ", held: " << stats.num_held << ", dropped: " << stats.num_dropped);
+}
+
+//----------------------------------------------------------------------------
+// _run_scope_stream
+//----------------------------------------------------------------------------
+void _run_scope_stream(uint rate_hz, uint duration_s)
+{
+    float samples[SCOPE_SAMPLES_MSG_MAX_LEN / sizeof(float)];
+    SendStats stats = {};
+    uint64_t step = 0;
+    uint32_t trace_seq = 0;
+
+    // Open the samples queue - this is non-blocking, as the queue only holds
+    // one message a full queue means the GUI has not read the last samples
+    mq_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.mq_maxmsg = SCOPE_SAMPLES_MSG_QUEUE_SIZE;
+    attr.mq_msgsize = SCOPE_SAMPLES_MSG_MAX_LEN;
+    mqd_t desc = ::mq_open(SCOPE_SAMPLES_MSG_QUEUE_NAME, (O_CREAT | O_WRONLY | O_NONBLOCK),
+                           (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH),
+                           &attr);
+    if (desc == (mqd_t)-1) {
+        MSG("ERROR: Could not open the samples message queue: " << errno);
+        return;
+    }
+
+    // Send the samples at the specified rate until the duration has elapsed
+    uint64_t start_time = _now();
+    uint64_t end_time = start_time + (duration_s * 1000000000ULL);
+    uint64_t period = 1000000000ULL / rate_hz;
+    while (!_exit_load_gen && (_now() < end_time))
+    {
+        // Generate an L/R sine wave, with the phase moving each frame
+        for (uint i=0; i<SCOPE_NUM_SAMPLES; i++) {
+            float phase = (2 * M_PI * i / SCOPE_NUM_SAMPLES) + (step * 0.1f);
+            samples[(i * 2)] = 0.8f * std::sin(phase);
+            samples[(i * 2) + 1] = 0.8f * std::cos(phase);
+        }
+        uint len = SCOPE_SAMPLES_MSG_LEN;
+        if (_trace) {
+            GuiMsgTrace trace;
+            _make_trace(trace, trace_seq++);
+            std::memcpy((uint8_t *)samples + SCOPE_SAMPLES_MSG_LEN, &trace, sizeof(trace));
+            len = SCOPE_SAMPLES_MSG_MAX_LEN;
+        }
+        if (::mq_send(desc, (char *)samples, len, 0) == 0)
+            stats.num_sent++;
+        else if (errno == EAGAIN)
+            stats.num_queue_full++;
+        step++;
+        _wait_until(start_time + (step * period));
+    }
+
+    // Show the achieved rate
+    double elapsed_s = (_now() - start_time) / 1000000000.0;
+    MSG("Scope samples: sent " << stats.num_sent << " in " << elapsed_s << " s (" << (uint)(stats.num_sent / elapsed_s) <<
+        " msgs/s), queue full events: " << stats.num_queue_full);
+    ::mq_close(desc);
+}
+
+//----------------------------------------------------------------------------
+// _run_scope_ring_stream
+//----------------------------------------------------------------------------
+void _run_scope_ring_stream(ScopeSampleRing *ring, uint rate_hz, uint duration_s)
+{
+    // Each block holds the audio frames for one period at the block rate
+    uint block_frames = std::max(1U, (SCOPE_SAMPLE_RATE / rate_hz));
+    std::vector<float> block(block_frames * SCOPE_SAMPLE_RING_CHANNELS);
+    uint64_t num_frames = 0;
+    uint64_t step = 0;
+
+    // Write the continuous stream at the audio rate until the duration has
+    // elapsed
+    uint64_t start_time = _now();
+    uint64_t end_time = start_time + (duration_s * 1000000000ULL);
+    uint64_t period = 1000000000ULL / rate_hz;
+    while (!_exit_load_gen && (_now() < end_time))
+    {
+        // Generate an L/R sine wave, continuous across the blocks
+        for (uint i=0; i<block_frames; i++) {
+            float phase = 2 * M_PI * ((num_frames + i) % SCOPE_WAVE_FRAMES) / SCOPE_WAVE_FRAMES;
+            block[(i * 2)] = 0.8f * std::sin(phase);
+            block[(i * 2) + 1] = 0.8f * std::cos(phase);
+        }
+        ring->write(block.data(), block_frames);
+        num_frames += block_frames;
+        step++;
+        _wait_until(start_time + (step * period));
+    }
+
+    // Show the achieved rate
+    double elapsed_s = (_now() - start_time) / 1000000000.0;
+    MSG("Scope samples: wrote " << num_frames << " frames to the ring in " << elapsed_s << " s (" <<
+        (uint)(num_frames / elapsed_s) << " frames/s)");
+    ring->close();
+}
+
+//----------------------------------------------------------------------------
+// _make_msg
+//----------------------------------------------------------------------------
+void _make_msg(Scenario scenario, uint64_t step, GuiMsg& msg)
+{
+    std::memset((void *)&msg, 0, sizeof(msg));
+    switch (scenario)
+    {
+        case Scenario::URGENT:
+            // Spin the encoder, with a warning screen shown or hidden at intervals
+            // (sent in the urgent lane)
+            if ((step % URGENT_INTERVAL) == (URGENT_INTERVAL - 1)) {
+                msg.type = GuiMsgType::SHOW_WARNING_SCREEN;
+                msg.warning_screen.show = ((step / URGENT_INTERVAL) % 2) == 0;
+                _set_str(msg.warning_screen.line_1, "CALIBRATING");
+                _set_str(msg.warning_screen.line_2, "PLEASE WAIT");
+                break;
+            }
+            [[fallthrough]];
+
+        case Scenario::ENCODER:
+            // Show the param, then spin the encoder
+            if (step == 0) {
+                msg.type = GuiMsgType::PARAM_UPDATE;
+                _set_str(msg.param_update.name, "Cutoff");
+                _set_str(msg.param_update.value_string, "0");
+            }
+            else {
+                msg.type = GuiMsgType::PARAM_VALUE_UPDATE;
+                _set_str(msg.param_value_update.value_string, std::to_string(step % 1000));
+                msg.param_value_update.selected_item = -1;
+            }
+            break;
+
+        case Scenario::LIST_FLOOD:
+            // Send a full list, with the item names changing each time
+            msg.type = GuiMsgType::SHOW_LIST_ITEMS;
+            msg.list_items.num_items = LIST_MAX_ITEMS;
+            msg.list_items.selected_item = step % LIST_MAX_ITEMS;
+            msg.list_items.process_enabled_state = true;
+            for (uint i=0; i<LIST_MAX_ITEMS; i++) {
+                _set_str(msg.list_items.items[i], "PRESET " + std::to_string(step) + "-" + std::to_string(i));
+                msg.list_items.list_item_enabled[i] = ((i + step) % 5) != 0;
+            }
+            break;
+
+        case Scenario::SCREEN_STORM:
+            // Cycle through the screen changes the Nina UI app makes
+            switch (step % SCREEN_STORM_STEPS)
+            {
+                case 0:
+                    msg.type = GuiMsgType::SHOW_HOME_SCREEN;
+                    _set_str(msg.home_screen.patch_name, "PATCH " + std::to_string(step));
+                    msg.home_screen.scope_mode = GuiScopeMode::SCOPE_MODE_OSC;
+                    break;
+
+                case 1:
+                    msg.type = GuiMsgType::SET_SOFT_BUTTONS;
+                    _set_str(msg.soft_buttons.button1, "BACK");
+                    _set_str(msg.soft_buttons.button2, "SAVE");
+                    _set_str(msg.soft_buttons.button3, "EDIT");
+                    break;
+
+                case 2:
+                    msg.type = GuiMsgType::PARAM_UPDATE;
+                    _set_str(msg.param_update.name, "Resonance");
+                    _set_str(msg.param_update.value_string, std::to_string(step % 100));
+                    msg.param_update.num_items = 8;
+                    for (uint i=0; i<8; i++) {
+                        _set_str(msg.param_update.list_items[i], "PARAM " + std::to_string(i));
+                        msg.param_update.list_item_enabled[i] = true;
+                    }
+                    break;
+
+                case 3:
+                    msg.type = GuiMsgType::SOFT_BUTTONS_STATE;
+                    msg.soft_buttons_state.state_button1 = step & 1;
+                    break;
+
+                case 4:
+                    msg.type = GuiMsgType::EDIT_NAME;
+                    _set_str(msg.edit_name.name, "NEW PATCH");
+                    break;
+
+                default:
+                    msg.type = GuiMsgType::SHOW_CONFIRMATION_SCREEN;
+                    _set_str(msg.confirmation_screen.line_1, "PATCH");
+                    _set_str(msg.confirmation_screen.line_2, "SAVED");
+                    break;
+            }
+            break;
+
+        case Scenario::WT_BROWSE:
+        default:
+            // Show the wavetable list, then browse through it
+            if (step == 0) {
+                msg.type = GuiMsgType::ENUM_PARAM_UPDATE;
+                _set_str(msg.enum_param_update.name, "Wavetable");
+                msg.enum_param_update.num_items = NUM_WT_FILES;
+                msg.enum_param_update.wt_list = true;
+                for (uint i=0; i<NUM_WT_FILES; i++) {
+                    _set_str(msg.enum_param_update.list_items[i], "WT_" + std::to_string(i));
+                }
+            }
+            else {
+                msg.type = GuiMsgType::ENUM_PARAM_UPDATE_VALUE;
+                msg.list_select_item.selected_item = step % NUM_WT_FILES;
+                msg.list_select_item.wt_list = true;
+            }
+            break;
+    }
+}
+
+//----------------------------------------------------------------------------
+// _make_trace
+//----------------------------------------------------------------------------
+void _make_trace(GuiMsgTrace& trace, uint32_t seq)
+{
+    // The GUI measures the latency from the send time
+    trace.seq = seq;
+    trace.flags = 0;
+    trace.send_time = _now();
+}
+
+//----------------------------------------------------------------------------
+// _process_events
+//----------------------------------------------------------------------------
+void _process_events()
+{
+    GuiEventMsg event;
+
+    // Pass any applied acknowledgements from the GUI to the sender
+    if (_event_desc == (mqd_t)-1)
+        return;
+    while (::mq_receive(_event_desc, (char *)&event, sizeof(event), nullptr) == sizeof(event)) {
+        if (event.type == GuiEventType::GUI_MSGS_APPLIED)
+            _sender.applied(event.gui_msgs_applied.lane, event.gui_msgs_applied.seq);
+    }
+}
+
+//----------------------------------------------------------------------------
+// _set_str
+//----------------------------------------------------------------------------
+void _set_str(char *dst, const std::string& src)
+{
+    std::strncpy(dst, src.c_str(), (STD_STR_LEN - 1));
+    dst[STD_STR_LEN - 1] = '\0';
+}
+
+//----------------------------------------------------------------------------
+// _wait_until
+//----------------------------------------------------------------------------
+void _wait_until(uint64_t time)
+{
+    timespec ts;
+    ts.tv_sec = time / 1000000000ULL;
+    ts.tv_nsec = time % 1000000000ULL;
+    ::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+}
+
+//----------------------------------------------------------------------------
+// _now
+//----------------------------------------------------------------------------
+uint64_t _now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+//----------------------------------------------------------------------------
+// _print_usage
+//----------------------------------------------------------------------------
+void _print_usage()
+{
+    MSG("Usage: nina_load_gen [-S scenario] [-r rate] [-p scope rate] [-d duration] [-R] [-t] [-T frames] [-f in flight]");
+    MSG("  -S scenario    encoder, list-flood, screen-storm, wt-browse, urgent or scope (default encoder)");
+    MSG("  -r rate        Scenario message rate in Hz, 0 for flat-out (default 100)");
+    MSG("  -p scope rate  Also send a scope sample stream at this rate in Hz (default off)");
+    MSG("  -d duration    Duration in seconds (default 10)");
+    MSG("  -R             Send via the shared memory rings (the scope samples as a 48 kHz stream)");
+    MSG("  -t             Trace the messages, so the GUI measures their latency");
+    MSG("  -T frames      Set the scope timebase in frames (a min/max envelope above " << SCOPE_NUM_SAMPLES << ", needs -R)");
+    MSG("  -f in flight   Flow control the value updates, with at most this many messages in flight");
+}
+
+//----------------------------------------------------------------------------
+// _sigint_handler
+//----------------------------------------------------------------------------
+void _sigint_handler([[maybe_unused]] int sig)
+{
+    // Stop the load generator
+    _exit_load_gen = true;
+}
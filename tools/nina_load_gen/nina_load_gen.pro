@@ -0,0 +1,26 @@
+######################################################################
+# Nina load generator tool
+######################################################################
+
+TEMPLATE = app
+TARGET = nina_load_gen
+CONFIG += console
+CONFIG -= app_bundle qt
+
+# The common definitions are used without QT
+DEFINES += NINA_GUI_NO_QT
+
+# Paths
+INCLUDEPATH += ../../src
+
+# Input
+HEADERS += ../../src/common.h
+HEADERS += ../../src/gui_msg_codec.h
+HEADERS += ../../src/gui_msg_ring.h
+HEADERS += ../../src/gui_msg_sender.h
+HEADERS += ../../src/scope_sample_ring.h
+SOURCES += main.cpp
+LIBS += -lrt -lpthread
+
+# Build for C++17
+CONFIG += c++14 c++17 warn_off
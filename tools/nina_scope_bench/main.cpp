@@ -0,0 +1,470 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  main.cpp
+ * @brief Nina scope kernel benchmark tool.
+ *
+ * Measures the cost of converting a frame of scope samples to vertices in the
+ * OSC and XY scope modes, with the legacy per-sample path (double precision
+ * points appended to a vector, then copied to the vertices), and with scalar
+ * and SIMD vertex kernels - the CPU equivalent of the scope vertex shader
+ * mapping, kept here as its reference. The copy mode is the actual CPU cost,
+ * as the scope maps the raw samples in its vertex shader (ScopeKernel copy
+ * and peak only). The SIMD kernel outputs are also checked against the scalar
+ * vertex kernel.
+ * The min/max envelope decimation of the longest timebase to the scope width
+ * is also measured, with the scalar and SIMD min/max kernels, and with the
+ * scope envelope (streamed in blocks, as from the scope sample ring).
+ *-----------------------------------------------------------------------------
+ */
+#include <getopt.h>
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <vector>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "common.h"
+#include "scope_envelope.h"
+#include "scope_kernel.h"
+
+// Constants
+const double PI                       = std::acos(-1);
+const double ROTATE_SCOPE_XY_SIN      = std::sin((45 * PI) / 180.0);
+const double ROTATE_SCOPE_XY_COS      = std::cos((45 * PI) / 180.0);
+constexpr float SCOPE_IDLE_THRESHOLD  = 1.0f / 240;
+constexpr float ROTATE_SCOPE_XY_SIN_COS = 0.70710678f;  // 45 degrees, so the sin and cos are the same
+constexpr uint ENVELOPE_COLUMNS       = 800;
+constexpr uint ENVELOPE_BLOCK_FRAMES  = 768;
+
+// Benchmark kernel
+enum class BenchKernel
+{
+    LEGACY,
+    SCALAR,
+    SIMD,
+    COPY,
+    ENVELOPE
+};
+
+// Legacy point (as QPointF)
+struct LegacyPoint
+{
+    double x;
+    double y;
+};
+
+// Local functions
+uint64_t _run_bench(BenchKernel kernel, GuiScopeMode mode, const std::vector<float>& samples, uint num_iterations);
+float _legacy_kernel(const float *samples, GuiScopeMode mode, std::vector<LegacyPoint>& points, float *vertices);
+float _vertex_kernel(const float *samples, uint num_frames, GuiScopeMode mode, float *vertices);
+float _vertex_kernel_scalar(const float *samples, uint num_frames, GuiScopeMode mode, float *vertices);
+float _vertex_kernel_frames(const float *samples, uint first_frame, uint num_frames, GuiScopeMode mode, float *vertices);
+float _check_kernel(const std::vector<float>& samples, GuiScopeMode mode);
+uint64_t _run_envelope_bench(BenchKernel kernel, const std::vector<float>& samples, uint num_iterations);
+float _check_envelope(const std::vector<float>& samples);
+const char *_kernel_name(BenchKernel kernel);
+uint64_t _now();
+void _print_usage();
+
+//----------------------------------------------------------------------------
+// main
+//----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    uint num_iterations = 200000;
+    int opt;
+
+    // Parse the options
+    while ((opt = ::getopt(argc, argv, "n:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                // Number of frames to convert
+                num_iterations = std::atoi(optarg);
+                break;
+
+            default:
+                _print_usage();
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+    if (num_iterations == 0) {
+        _print_usage();
+        return 1;
+    }
+
+    // Generate a frame of L/R samples
+    std::vector<float> samples(SCOPE_NUM_SAMPLES * 2);
+    for (uint i=0; i<SCOPE_NUM_SAMPLES; i++) {
+        samples[(i * 2)] = 0.8f * std::sin(2 * PI * i / SCOPE_NUM_SAMPLES);
+        samples[(i * 2) + 1] = 0.5f * std::cos(6 * PI * i / SCOPE_NUM_SAMPLES);
+    }
+
+    // Run each kernel in each scope mode, and show the cost per frame
+    MSG("Scope kernel: " << num_iterations << " frames of " << SCOPE_NUM_SAMPLES << " samples, SIMD: " << ScopeKernel::simd_name());
+    for (GuiScopeMode mode : {GuiScopeMode::SCOPE_MODE_OSC, GuiScopeMode::SCOPE_MODE_XY}) {
+        uint64_t legacy_ns = 0;
+        for (BenchKernel kernel : {BenchKernel::LEGACY, BenchKernel::SCALAR, BenchKernel::SIMD, BenchKernel::COPY}) {
+            uint64_t ns = _run_bench(kernel, mode, samples, num_iterations);
+            if (kernel == BenchKernel::LEGACY)
+                legacy_ns = ns;
+            MSG(((mode == GuiScopeMode::SCOPE_MODE_OSC) ? "OSC " : "XY  ") << std::left << std::setw(8) << _kernel_name(kernel) << std::right <<
+                " ns/frame: " << std::setw(7) << std::fixed << std::setprecision(1) << ((double)ns / num_iterations) <<
+                "  speedup: " << std::setw(5) << std::setprecision(2) << ((double)legacy_ns / ns) << "x");
+        }
+        MSG("    SIMD max error vs scalar: " << std::scientific << _check_kernel(samples, mode) << std::defaultfloat);
+    }
+
+    // Generate the longest timebase of L/R samples, and run each envelope
+    // kernel - the cost is shown per decimated window, and per sample frame
+    std::vector<float> history(SCOPE_MAX_TIMEBASE_FRAMES * 2);
+    for (uint i=0; i<SCOPE_MAX_TIMEBASE_FRAMES; i++) {
+        history[(i * 2)] = 0.8f * std::sin(2 * PI * i / 480);
+        history[(i * 2) + 1] = 0.1f * std::sin(2 * PI * i / 37);
+    }
+    uint num_windows = std::max(1U, (num_iterations / 1000));
+    MSG("Scope envelope: " << num_windows << " windows of " << SCOPE_MAX_TIMEBASE_FRAMES << " frames to " << ENVELOPE_COLUMNS << " columns");
+    uint64_t scalar_ns = 0;
+    for (BenchKernel kernel : {BenchKernel::SCALAR, BenchKernel::SIMD, BenchKernel::ENVELOPE}) {
+        uint64_t ns = _run_envelope_bench(kernel, history, num_windows);
+        if (kernel == BenchKernel::SCALAR)
+            scalar_ns = ns;
+        MSG("ENV " << std::left << std::setw(8) << _kernel_name(kernel) << std::right <<
+            " us/window: " << std::setw(7) << std::fixed << std::setprecision(1) << ((double)ns / num_windows / 1000) <<
+            "  ns/frame: " << std::setw(5) << std::setprecision(2) << ((double)ns / num_windows / SCOPE_MAX_TIMEBASE_FRAMES) <<
+            "  speedup: " << std::setw(5) << std::setprecision(2) << ((double)scalar_ns / ns) << "x");
+    }
+    MSG("    Envelope max error vs scalar: " << std::scientific << _check_envelope(history) << std::defaultfloat);
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+// _run_bench
+//----------------------------------------------------------------------------
+uint64_t _run_bench(BenchKernel kernel, GuiScopeMode mode, const std::vector<float>& samples, uint num_iterations)
+{
+    std::vector<float> vertices(SCOPE_NUM_SAMPLES * 3);
+    std::vector<LegacyPoint> points;
+    volatile uint num_active = 0;
+
+    // Convert the frame the specified number of times - the vertices are
+    // written in the scope layout (x/y/z) for the legacy kernel, and x/y for the
+    // scope kernels
+    uint64_t start = _now();
+    for (uint i=0; i<num_iterations; i++) {
+        float peak;
+        switch (kernel)
+        {
+            case BenchKernel::LEGACY:
+                peak = _legacy_kernel(samples.data(), mode, points, vertices.data());
+                break;
+
+            case BenchKernel::SCALAR:
+                peak = _vertex_kernel_scalar(samples.data(), SCOPE_NUM_SAMPLES, mode, vertices.data());
+                break;
+
+            case BenchKernel::SIMD:
+                peak = _vertex_kernel(samples.data(), SCOPE_NUM_SAMPLES, mode, vertices.data());
+                break;
+
+            case BenchKernel::COPY:
+            default:
+                peak = ScopeKernel::copy_peak(samples.data(), SCOPE_NUM_SAMPLES, vertices.data());
+                break;
+        }
+        if (peak > SCOPE_IDLE_THRESHOLD)
+            num_active = num_active + 1;
+    }
+    return _now() - start;
+}
+
+//----------------------------------------------------------------------------
+// _legacy_kernel
+// As the previous ScopeDataSource::updateData and Scope::refresh_data
+//----------------------------------------------------------------------------
+float _legacy_kernel(const float *samples, GuiScopeMode mode, std::vector<LegacyPoint>& points, float *vertices)
+{
+    bool scope_idle = true;
+
+    // Add the points to the data
+    points.clear();
+    for (uint i=0; i<SCOPE_NUM_SAMPLES; i++) {
+        LegacyPoint point;
+        auto l_sample = *samples++;
+        auto r_sample = *samples++;
+        if (scope_idle) {
+            if ((l_sample < -(SCOPE_IDLE_THRESHOLD)) || (l_sample > SCOPE_IDLE_THRESHOLD) ||
+                (r_sample < -(SCOPE_IDLE_THRESHOLD)) || (r_sample > SCOPE_IDLE_THRESHOLD)) {
+                scope_idle = false;
+            }
+        }
+        if (mode == GuiScopeMode::SCOPE_MODE_OSC) {
+            point.x = ((double(i) / double(SCOPE_NUM_SAMPLES)) * 2) - 1.0;
+            point.y = l_sample + r_sample;
+        }
+        else {
+            point.x = (l_sample * ROTATE_SCOPE_XY_COS) - (r_sample * ROTATE_SCOPE_XY_SIN);
+            point.y = (l_sample * ROTATE_SCOPE_XY_SIN) + (r_sample * ROTATE_SCOPE_XY_COS);
+        }
+        points.push_back(point);
+    }
+
+    // Copy the points to the vertices
+    for (uint i=0; i<SCOPE_NUM_SAMPLES; i++) {
+        vertices[(i*3)] = points[i].x;
+        vertices[(i*3)+1] = points[i].y;
+    }
+    return scope_idle ? 0.0f : 1.0f;
+}
+
+//----------------------------------------------------------------------------
+// _vertex_kernel
+// The CPU equivalent of the scope vertex shader mapping (the reference for it)
+//----------------------------------------------------------------------------
+float _vertex_kernel(const float *samples, uint num_frames, GuiScopeMode mode, float *vertices)
+{
+#if defined(__ARM_NEON) || defined(__SSE2__)
+    uint num_vector_frames = num_frames & ~3U;
+    float step = 2.0f / num_frames;
+    float peak;
+#if defined(__ARM_NEON)
+    // Process 4 frames at a time - the loads and stores de-interleave and
+    // interleave the L/R samples and x/y vertices
+    float32x4_t peak_v = vdupq_n_f32(0.0f);
+    float32x4_t sc_v = vdupq_n_f32(ROTATE_SCOPE_XY_SIN_COS);
+    const float index_init[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+    float32x4_t x_v = vaddq_f32(vmulq_n_f32(vld1q_f32(index_init), step), vdupq_n_f32(-1.0f));
+    float32x4_t x_step_v = vdupq_n_f32(4 * step);
+    for (uint i=0; i<num_vector_frames; i+=4) {
+        float32x4x2_t lr = vld2q_f32(samples + (i * 2));
+        float32x4x2_t xy;
+        peak_v = vmaxq_f32(peak_v, vmaxq_f32(vabsq_f32(lr.val[0]), vabsq_f32(lr.val[1])));
+        if (mode == GuiScopeMode::SCOPE_MODE_OSC) {
+            xy.val[0] = x_v;
+            xy.val[1] = vaddq_f32(lr.val[0], lr.val[1]);
+            x_v = vaddq_f32(x_v, x_step_v);
+        }
+        else {
+            xy.val[0] = vmulq_f32(vsubq_f32(lr.val[0], lr.val[1]), sc_v);
+            xy.val[1] = vmulq_f32(vaddq_f32(lr.val[0], lr.val[1]), sc_v);
+        }
+        vst2q_f32(vertices + (i * 2), xy);
+    }
+    float32x2_t peak_h = vpmax_f32(vget_low_f32(peak_v), vget_high_f32(peak_v));
+    peak = vget_lane_f32(vpmax_f32(peak_h, peak_h), 0);
+#else
+    // Process 4 frames at a time - the L/R samples are de-interleaved with
+    // shuffles, and the x/y vertices interleaved with unpacks
+    __m128 abs_mask_v = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 peak_v = _mm_setzero_ps();
+    __m128 sc_v = _mm_set1_ps(ROTATE_SCOPE_XY_SIN_COS);
+    __m128 x_v = _mm_add_ps(_mm_mul_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), _mm_set1_ps(step)), _mm_set1_ps(-1.0f));
+    __m128 x_step_v = _mm_set1_ps(4 * step);
+    for (uint i=0; i<num_vector_frames; i+=4) {
+        __m128 a = _mm_loadu_ps(samples + (i * 2));
+        __m128 b = _mm_loadu_ps(samples + (i * 2) + 4);
+        __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 x, y;
+        peak_v = _mm_max_ps(peak_v, _mm_max_ps(_mm_and_ps(l, abs_mask_v), _mm_and_ps(r, abs_mask_v)));
+        if (mode == GuiScopeMode::SCOPE_MODE_OSC) {
+            x = x_v;
+            y = _mm_add_ps(l, r);
+            x_v = _mm_add_ps(x_v, x_step_v);
+        }
+        else {
+            x = _mm_mul_ps(_mm_sub_ps(l, r), sc_v);
+            y = _mm_mul_ps(_mm_add_ps(l, r), sc_v);
+        }
+        _mm_storeu_ps(vertices + (i * 2), _mm_unpacklo_ps(x, y));
+        _mm_storeu_ps(vertices + (i * 2) + 4, _mm_unpackhi_ps(x, y));
+    }
+    peak_v = _mm_max_ps(peak_v, _mm_shuffle_ps(peak_v, peak_v, _MM_SHUFFLE(1, 0, 3, 2)));
+    peak_v = _mm_max_ps(peak_v, _mm_shuffle_ps(peak_v, peak_v, _MM_SHUFFLE(2, 3, 0, 1)));
+    peak = _mm_cvtss_f32(peak_v);
+#endif
+
+    // Process any remaining frames
+    return std::max(peak, _vertex_kernel_frames(samples, num_vector_frames, num_frames, mode, vertices));
+#else
+    return _vertex_kernel_scalar(samples, num_frames, mode, vertices);
+#endif
+}
+
+//----------------------------------------------------------------------------
+// _vertex_kernel_scalar
+//----------------------------------------------------------------------------
+float _vertex_kernel_scalar(const float *samples, uint num_frames, GuiScopeMode mode, float *vertices)
+{
+    return _vertex_kernel_frames(samples, 0, num_frames, mode, vertices);
+}
+
+
+//----------------------------------------------------------------------------
+// _vertex_kernel_frames
+// Processes the frames from the first frame to the end of the frame
+//----------------------------------------------------------------------------
+float _vertex_kernel_frames(const float *samples, uint first_frame, uint num_frames, GuiScopeMode mode, float *vertices)
+{
+    float step = 2.0f / num_frames;
+    float peak = 0.0f;
+
+    // Process each frame
+    samples += (first_frame * 2);
+    vertices += (first_frame * 2);
+    for (uint i=first_frame; i<num_frames; i++) {
+        // Get the L/R samples, and track the peak
+        float l_sample = *samples++;
+        float r_sample = *samples++;
+        peak = std::max(peak, std::max(std::fabs(l_sample), std::fabs(r_sample)));
+
+        // Check the scope mode
+        if (mode == GuiScopeMode::SCOPE_MODE_OSC) {
+            // Oscillator - L+R against x
+            *vertices++ = (i * step) - 1.0f;
+            *vertices++ = l_sample + r_sample;
+        }
+        else {
+            // X/Y - rotated
+            *vertices++ = (l_sample - r_sample) * ROTATE_SCOPE_XY_SIN_COS;
+            *vertices++ = (l_sample + r_sample) * ROTATE_SCOPE_XY_SIN_COS;
+        }
+    }
+    return peak;
+}
+
+//----------------------------------------------------------------------------
+// _check_kernel
+//----------------------------------------------------------------------------
+float _check_kernel(const std::vector<float>& samples, GuiScopeMode mode)
+{
+    std::vector<float> scalar_vertices(SCOPE_NUM_SAMPLES * 2);
+    std::vector<float> simd_vertices(SCOPE_NUM_SAMPLES * 2);
+
+    // Get the max difference between the kernel outputs (including the peak)
+    float scalar_peak = _vertex_kernel_scalar(samples.data(), SCOPE_NUM_SAMPLES, mode, scalar_vertices.data());
+    float simd_peak = _vertex_kernel(samples.data(), SCOPE_NUM_SAMPLES, mode, simd_vertices.data());
+    float error = std::fabs(scalar_peak - simd_peak);
+    for (uint i=0; i<scalar_vertices.size(); i++)
+        error = std::fmax(error, std::fabs(scalar_vertices[i] - simd_vertices[i]));
+
+    // Check the copy
+    simd_peak = ScopeKernel::copy_peak(samples.data(), SCOPE_NUM_SAMPLES, simd_vertices.data());
+    error = std::fmax(error, std::fabs(scalar_peak - simd_peak));
+    for (uint i=0; i<samples.size(); i++)
+        error = std::fmax(error, std::fabs(samples[i] - simd_vertices[i]));
+    return error;
+}
+
+//----------------------------------------------------------------------------
+// _run_envelope_bench
+//----------------------------------------------------------------------------
+uint64_t _run_envelope_bench(BenchKernel kernel, const std::vector<float>& samples, uint num_iterations)
+{
+    uint num_frames = samples.size() / 2;
+    uint bin_frames = num_frames / ENVELOPE_COLUMNS;
+    std::vector<float> envelope(ENVELOPE_COLUMNS * 2);
+    ScopeEnvelope scope_envelope;
+    scope_envelope.configure(num_frames, ENVELOPE_COLUMNS);
+    volatile float peak = 0.0f;
+
+    // Decimate the window the specified number of times - either each column
+    // in one call, or streamed into the scope envelope in blocks
+    uint64_t start = _now();
+    for (uint i=0; i<num_iterations; i++) {
+        if (kernel == BenchKernel::ENVELOPE) {
+            for (uint j=0; j<num_frames; j+=ENVELOPE_BLOCK_FRAMES)
+                scope_envelope.process((samples.data() + (j * 2)), std::min(ENVELOPE_BLOCK_FRAMES, (num_frames - j)));
+            peak = scope_envelope.read(envelope.data());
+        }
+        else {
+            for (uint c=0; c<ENVELOPE_COLUMNS; c++) {
+                float min = 1.0e30f;
+                float max = -1.0e30f;
+                const float *column = samples.data() + (c * bin_frames * 2);
+                (kernel == BenchKernel::SIMD) ?
+                    ScopeKernel::min_max(column, bin_frames, min, max) :
+                    ScopeKernel::min_max_scalar(column, bin_frames, min, max);
+                envelope[(c * 2)] = min;
+                envelope[(c * 2) + 1] = max;
+            }
+            peak = std::max(std::fabs(envelope[0]), std::fabs(envelope[1]));
+        }
+    }
+    (void)peak;
+    return _now() - start;
+}
+
+//----------------------------------------------------------------------------
+// _check_envelope
+//----------------------------------------------------------------------------
+float _check_envelope(const std::vector<float>& samples)
+{
+    uint num_frames = samples.size() / 2;
+    uint bin_frames = num_frames / ENVELOPE_COLUMNS;
+    std::vector<float> envelope(ENVELOPE_COLUMNS * 2);
+
+    // Stream the envelope window of samples into the scope envelope, in odd
+    // sized blocks so the bins are split across blocks and the SIMD remainder
+    // is used
+    ScopeEnvelope scope_envelope;
+    scope_envelope.configure(num_frames, ENVELOPE_COLUMNS);
+    uint window_frames = scope_envelope.window_frames();
+    for (uint j=0; j<window_frames; j+=1027)
+        scope_envelope.process((samples.data() + (j * 2)), std::min(1027U, (window_frames - j)));
+    scope_envelope.read(envelope.data());
+
+    // Get the max difference from the scalar min/max of each column
+    float error = 0.0f;
+    for (uint c=0; c<ENVELOPE_COLUMNS; c++) {
+        float min = 1.0e30f;
+        float max = -1.0e30f;
+        ScopeKernel::min_max_scalar((samples.data() + (c * bin_frames * 2)), bin_frames, min, max);
+        error = std::fmax(error, std::fabs(envelope[(c * 2)] - min));
+        error = std::fmax(error, std::fabs(envelope[(c * 2) + 1] - max));
+    }
+    return error;
+}
+
+//----------------------------------------------------------------------------
+// _kernel_name
+//----------------------------------------------------------------------------
+const char *_kernel_name(BenchKernel kernel)
+{
+    switch (kernel)
+    {
+        case BenchKernel::LEGACY:   return "legacy";
+        case BenchKernel::SCALAR:   return "scalar";
+        case BenchKernel::SIMD:     return "simd";
+        case BenchKernel::COPY:     return "copy";
+        case BenchKernel::ENVELOPE: return "envelope";
+        default:                    return "unknown";
+    }
+}
+
+//----------------------------------------------------------------------------
+// _now
+//----------------------------------------------------------------------------
+uint64_t _now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+//----------------------------------------------------------------------------
+// _print_usage
+//----------------------------------------------------------------------------
+void _print_usage()
+{
+    MSG("Usage: nina_scope_bench [-n frames]");
+    MSG("  -n frames    Number of frames to convert per kernel and mode (default 200000),");
+    MSG("               and 1/1000 as many envelope windows");
+}
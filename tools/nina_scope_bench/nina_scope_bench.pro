@@ -0,0 +1,25 @@
+######################################################################
+# Nina scope kernel benchmark tool
+######################################################################
+
+TEMPLATE = app
+TARGET = nina_scope_bench
+CONFIG += console
+CONFIG -= app_bundle qt
+
+# The common definitions are used without QT
+DEFINES += NINA_GUI_NO_QT
+
+# Paths
+INCLUDEPATH += ../../src
+
+# Input
+HEADERS += ../../src/common.h
+HEADERS += ../../src/scope_kernel.h
+HEADERS += ../../src/scope_envelope.h
+SOURCES += ../../src/scope_kernel.cpp
+SOURCES += ../../src/scope_envelope.cpp
+SOURCES += main.cpp
+
+# Build for C++17
+CONFIG += c++14 c++17 warn_off
@@ -0,0 +1,317 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2023 Melbourne Instruments, Australia
+ *-----------------------------------------------------------------------------
+ * @file  main.cpp
+ * @brief Nina GUI message sender benchmark tool.
+ *
+ * Measures the producer cost of sending an encoder spin (bursts of param
+ * value updates) with the legacy full GuiMsg queue send, and with the
+ * GuiMsgSender over the queue and ring, unbatched and batched. The messages
+ * are received by a drain thread on private queue/ring names, so the Nina GUI
+ * is not needed (and is not disturbed).
+ *-----------------------------------------------------------------------------
+ */
+#include <mqueue.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <iomanip>
+#include <cerrno>
+#include <string>
+#include <thread>
+#include "common.h"
+#include "gui_msg_codec.h"
+#include "gui_msg_ring.h"
+#include "gui_msg_sender.h"
+
+// Constants
+constexpr char BENCH_QUEUE_NAME[]       = "/nina_sender_bench_queue";
+constexpr char BENCH_RING_NAME[]        = "/nina_sender_bench_ring";
+constexpr uint BENCH_RING_SIZE          = (256 * 1024);
+constexpr uint BARRIER_INTERVAL_TICKS   = 64;
+
+// Benchmark mode
+enum class BenchMode
+{
+    LEGACY,
+    QUEUE,
+    QUEUE_BATCHED,
+    RING,
+    RING_BATCHED
+};
+
+// Benchmark result
+struct BenchResult
+{
+    uint64_t cpu_ns;
+    uint64_t wall_ns;
+    uint64_t num_updates;
+    uint64_t num_sent;
+    uint64_t num_received;
+};
+
+// Local functions
+BenchResult _run_bench(BenchMode mode, uint num_ticks, uint updates_per_tick);
+void _send_legacy(mqd_t desc, const GuiMsg& msg);
+void _drain_queue(mqd_t desc, std::atomic<bool> *stop, uint64_t *num_received);
+void _drain_ring(GuiMsgRing *ring, std::atomic<bool> *stop, uint64_t *num_received);
+const char *_mode_name(BenchMode mode);
+uint64_t _now(clockid_t clock);
+void _print_usage();
+
+//----------------------------------------------------------------------------
+// main
+//----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    uint num_ticks = 20000;
+    uint updates_per_tick = 8;
+    int opt;
+
+    // Parse the options
+    while ((opt = ::getopt(argc, argv, "n:u:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                // Number of UI ticks
+                num_ticks = std::atoi(optarg);
+                break;
+
+            case 'u':
+                // Encoder updates per UI tick
+                updates_per_tick = std::atoi(optarg);
+                break;
+
+            default:
+                _print_usage();
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+    if ((num_ticks == 0) || (updates_per_tick == 0)) {
+        _print_usage();
+        return 1;
+    }
+
+    // Run each benchmark mode, and show the cost per update (producer CPU time)
+    MSG("Encoder spin: " << num_ticks << " ticks x " << updates_per_tick << " updates");
+    for (BenchMode mode : {BenchMode::LEGACY, BenchMode::QUEUE, BenchMode::QUEUE_BATCHED,
+                           BenchMode::RING, BenchMode::RING_BATCHED}) {
+        BenchResult result = _run_bench(mode, num_ticks, updates_per_tick);
+        MSG(std::left << std::setw(16) << _mode_name(mode) << std::right <<
+            " cpu/update: " << std::setw(6) << (result.cpu_ns / result.num_updates) << " ns" <<
+            "  wall/update: " << std::setw(6) << (result.wall_ns / result.num_updates) << " ns" <<
+            "  sent: " << std::setw(8) << result.num_sent << "  received: " << std::setw(8) << result.num_received);
+    }
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+// _run_bench
+//----------------------------------------------------------------------------
+BenchResult _run_bench(BenchMode mode, uint num_ticks, uint updates_per_tick)
+{
+    BenchResult result = {};
+    std::atomic<bool> stop{false};
+    GuiMsgSender sender;
+    GuiMsgRing ring;
+    mqd_t drain_desc = (mqd_t)-1;
+    mqd_t legacy_desc = (mqd_t)-1;
+    std::thread *drain_thread;
+    bool use_ring = (mode == BenchMode::RING) || (mode == BenchMode::RING_BATCHED);
+    bool batched = (mode == BenchMode::QUEUE_BATCHED) || (mode == BenchMode::RING_BATCHED);
+
+    // Create the receive side (as the Nina GUI does) and start draining it
+    if (use_ring) {
+        ::shm_unlink(BENCH_RING_NAME);
+        if (!ring.create(BENCH_RING_NAME, BENCH_RING_SIZE)) {
+            MSG("ERROR: Could not create the bench ring: " << errno);
+            std::exit(1);
+        }
+        drain_thread = new std::thread(_drain_ring, &ring, &stop, &result.num_received);
+    }
+    else {
+        mq_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.mq_maxmsg = GUI_MSG_QUEUE_SIZE;
+        attr.mq_msgsize = GUI_MSG_MAX_SIZE;
+        ::mq_unlink(BENCH_QUEUE_NAME);
+        drain_desc = ::mq_open(BENCH_QUEUE_NAME, (O_CREAT | O_RDONLY), (S_IRUSR | S_IWUSR), &attr);
+        if (drain_desc == (mqd_t)-1) {
+            MSG("ERROR: Could not create the bench queue: " << errno);
+            std::exit(1);
+        }
+        drain_thread = new std::thread(_drain_queue, drain_desc, &stop, &result.num_received);
+    }
+
+    // Open the send side
+    if (mode == BenchMode::LEGACY) {
+        legacy_desc = ::mq_open(BENCH_QUEUE_NAME, O_WRONLY);
+    }
+    else if (!sender.open(true, (use_ring ? BENCH_RING_NAME : nullptr), BENCH_QUEUE_NAME)) {
+        MSG("ERROR: Could not open the sender: " << errno);
+        std::exit(1);
+    }
+
+    // Spin the encoder - each UI tick sends a burst of value updates, with a
+    // barrier (soft buttons state) every so often
+    uint64_t start_cpu = _now(CLOCK_THREAD_CPUTIME_ID);
+    uint64_t start_wall = _now(CLOCK_MONOTONIC);
+    uint value = 0;
+    for (uint tick=0; tick<num_ticks; tick++) {
+        if (batched)
+            sender.begin_batch();
+        for (uint i=0; i<updates_per_tick; i++) {
+            std::string value_str = std::to_string(value++ % 1000);
+            if (mode == BenchMode::LEGACY) {
+                // The legacy path builds and sends a full GuiMsg
+                GuiMsg msg;
+                std::memset((void *)&msg, 0, sizeof(msg));
+                msg.type = GuiMsgType::PARAM_VALUE_UPDATE;
+                GuiMsgSender::set_str(msg.param_value_update.value_string, value_str.c_str());
+                msg.param_value_update.selected_item = -1;
+                _send_legacy(legacy_desc, msg);
+                result.num_sent++;
+            }
+            else {
+                GuiMsg& msg = sender.begin(GuiMsgType::PARAM_VALUE_UPDATE);
+                GuiMsgSender::set_str(msg.param_value_update.value_string, value_str.c_str());
+                msg.param_value_update.selected_item = -1;
+                sender.commit();
+            }
+            result.num_updates++;
+        }
+        if ((tick % BARRIER_INTERVAL_TICKS) == (BARRIER_INTERVAL_TICKS - 1)) {
+            if (mode == BenchMode::LEGACY) {
+                GuiMsg msg;
+                std::memset((void *)&msg, 0, sizeof(msg));
+                msg.type = GuiMsgType::SOFT_BUTTONS_STATE;
+                _send_legacy(legacy_desc, msg);
+                result.num_sent++;
+            }
+            else {
+                GuiMsg& msg = sender.begin(GuiMsgType::SOFT_BUTTONS_STATE);
+                std::memset(&msg.soft_buttons_state, 0, sizeof(msg.soft_buttons_state));
+                sender.commit();
+            }
+        }
+        if (batched)
+            sender.flush();
+    }
+    result.cpu_ns = _now(CLOCK_THREAD_CPUTIME_ID) - start_cpu;
+    result.wall_ns = _now(CLOCK_MONOTONIC) - start_wall;
+    if (mode != BenchMode::LEGACY)
+        result.num_sent = sender.stats().num_sent;
+
+    // Stop draining, and clean up
+    sender.close();
+    if (legacy_desc != (mqd_t)-1)
+        ::mq_close(legacy_desc);
+    stop = true;
+    if (use_ring)
+        ring.wake();
+    drain_thread->join();
+    delete drain_thread;
+    if (use_ring) {
+        ring.close();
+        ::shm_unlink(BENCH_RING_NAME);
+    }
+    else {
+        ::mq_close(drain_desc);
+        ::mq_unlink(BENCH_QUEUE_NAME);
+    }
+    return result;
+}
+
+//----------------------------------------------------------------------------
+// _send_legacy
+//----------------------------------------------------------------------------
+void _send_legacy(mqd_t desc, const GuiMsg& msg)
+{
+    if (::mq_send(desc, (char *)&msg, sizeof(msg), 0) == -1)
+        MSG("ERROR: Could not send message: " << errno);
+}
+
+//----------------------------------------------------------------------------
+// _drain_queue
+//----------------------------------------------------------------------------
+void _drain_queue(mqd_t desc, std::atomic<bool> *stop, uint64_t *num_received)
+{
+    std::vector<uint8_t> buf(GUI_MSG_MAX_SIZE);
+
+    // Receive until stopped and the queue is empty
+    while (true) {
+        timespec timeout;
+        clock_gettime(CLOCK_REALTIME, &timeout);
+        timeout.tv_nsec += 10000000;
+        if (timeout.tv_nsec >= 1000000000) {
+            timeout.tv_sec++;
+            timeout.tv_nsec -= 1000000000;
+        }
+        if (::mq_timedreceive(desc, (char *)buf.data(), buf.size(), nullptr, &timeout) > 0)
+            (*num_received)++;
+        else if (*stop)
+            break;
+    }
+}
+
+//----------------------------------------------------------------------------
+// _drain_ring
+//----------------------------------------------------------------------------
+void _drain_ring(GuiMsgRing *ring, std::atomic<bool> *stop, uint64_t *num_received)
+{
+    const uint8_t *frame;
+    uint32_t len;
+
+    // Receive until stopped and the ring is empty
+    while (true) {
+        if (ring->front(frame, len)) {
+            ring->pop();
+            (*num_received)++;
+        }
+        else if (*stop) {
+            break;
+        }
+        else {
+            ring->wait(10, stop);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// _mode_name
+//----------------------------------------------------------------------------
+const char *_mode_name(BenchMode mode)
+{
+    switch (mode)
+    {
+        case BenchMode::LEGACY:         return "legacy";
+        case BenchMode::QUEUE:          return "queue";
+        case BenchMode::QUEUE_BATCHED:  return "queue batched";
+        case BenchMode::RING:           return "ring";
+        case BenchMode::RING_BATCHED:   return "ring batched";
+        default:                        return "unknown";
+    }
+}
+
+//----------------------------------------------------------------------------
+// _now
+//----------------------------------------------------------------------------
+uint64_t _now(clockid_t clock)
+{
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+//----------------------------------------------------------------------------
+// _print_usage
+//----------------------------------------------------------------------------
+void _print_usage()
+{
+    MSG("Usage: nina_sender_bench [-n ticks] [-u updates]");
+    MSG("  -n ticks     Number of UI ticks (default 20000)");
+    MSG("  -u updates   Encoder value updates per UI tick (default 8)");
+}
@@ -0,0 +1,25 @@
+######################################################################
+# Nina GUI message sender benchmark tool
+######################################################################
+
+TEMPLATE = app
+TARGET = nina_sender_bench
+CONFIG += console
+CONFIG -= app_bundle qt
+
+# The common definitions are used without QT
+DEFINES += NINA_GUI_NO_QT
+
+# Paths
+INCLUDEPATH += ../../src
+
+# Input
+HEADERS += ../../src/common.h
+HEADERS += ../../src/gui_msg_codec.h
+HEADERS += ../../src/gui_msg_ring.h
+HEADERS += ../../src/gui_msg_sender.h
+SOURCES += main.cpp
+LIBS += -lrt -lpthread
+
+# Build for C++17
+CONFIG += c++14 c++17 warn_off